@@ -341,6 +341,45 @@ public:
 
             _shared_file_size = fc::parse_size(_options->at("shared-file-size").as<std::string>());
             ilog("shared_file_size is ${n} bytes", ("n", _shared_file_size));
+
+            {
+                chainbase::segment_options segment_options;
+                segment_options.huge_pages = _options->count("shared-file-huge-pages") > 0;
+
+                const auto prefault = _options->at("shared-file-prefault").as<std::string>();
+                if (prefault == "advise")
+                    segment_options.prefault = chainbase::segment_options::prefault_advise;
+                else if (prefault == "touch")
+                    segment_options.prefault = chainbase::segment_options::prefault_touch;
+                else
+                    FC_ASSERT(prefault == "none", "Invalid shared-file-prefault value '${v}'", ("v", prefault));
+
+                if (_options->count("shared-file-numa"))
+                {
+                    const auto numa = _options->at("shared-file-numa").as<std::string>();
+                    if (numa == "interleave")
+                    {
+                        segment_options.numa = chainbase::segment_options::numa_interleave;
+                    }
+                    else
+                    {
+                        segment_options.numa = chainbase::segment_options::numa_bind;
+                        segment_options.numa_node = boost::lexical_cast<uint32_t>(numa);
+                    }
+                }
+
+                if (_options->count("shared-file-max-size"))
+                {
+                    segment_options.max_size
+                        = fc::parse_size(_options->at("shared-file-max-size").as<std::string>());
+                    FC_ASSERT(!segment_options.max_size || segment_options.max_size >= _shared_file_size,
+                              "shared-file-max-size must not be less than shared-file-size");
+                }
+
+                _chain_db->set_segment_options(segment_options);
+                _chain_db->set_shared_file_grow_step(
+                    fc::parse_size(_options->at("shared-file-grow-step").as<std::string>()));
+            }
             register_builtin_apis();
 
             if (_options->count("check-locks"))
@@ -348,6 +387,11 @@ public:
                 _chain_db->set_require_locking(true);
             }
 
+            if (_options->count("writer-priority"))
+            {
+                _chain_db->set_writer_priority(true);
+            }
+
             if (_options->count("shared-file-dir"))
             {
                 _shared_dir = fc::path(_options->at("shared-file-dir").as<boost::filesystem::path>());
@@ -372,6 +416,13 @@ public:
                 }
 
                 _chain_db->set_flush_interval(_options->at("flush").as<uint32_t>());
+                _chain_db->set_full_invariants_check_interval(
+                    _options->at("full-invariants-check-interval").as<uint32_t>());
+                _chain_db->set_signature_recovery_threads(_options->at("signature-recovery-threads").as<uint32_t>());
+                _chain_db->set_signature_cache_size(_options->at("signature-cache-size").as<uint32_t>());
+                _chain_db->set_block_log_segment_size(_options->at("block-log-segment-size").as<uint32_t>());
+                _chain_db->set_block_log_keep_blocks(_options->at("block-log-keep-blocks").as<uint32_t>());
+                _chain_db->set_block_log_write_queue_size(_options->at("block-log-write-queue-size").as<uint32_t>());
 
                 flat_map<uint32_t, block_id_type> loaded_checkpoints;
                 if (_options->count("checkpoint"))
@@ -386,13 +437,22 @@ public:
                 }
                 _chain_db->add_checkpoints(loaded_checkpoints);
 
-                if (_options->count("replay-blockchain") && !_options->count("resync-blockchain"))
+                uint32_t skip_flags = _chain_db->get_reindex_skip_flags();
+                if (!_options->at("replay-skip-witness-schedule-check").as<bool>())
+                    skip_flags &= ~database::skip_witness_schedule_check;
+
+                if (_options->count("import-snapshot") && !_options->count("resync-blockchain"))
                 {
-                    ilog("Replaying blockchain on user request.");
+                    ilog("Importing snapshot on user request.");
+
+                    auto snapshot_file = _options->at("import-snapshot").as<boost::filesystem::path>();
 
-                    uint32_t skip_flags = _chain_db->get_reindex_skip_flags();
-                    if (!_options->at("replay-skip-witness-schedule-check").as<bool>())
-                        skip_flags &= ~database::skip_witness_schedule_check;
+                    _chain_db->import_snapshot(block_log_dir, _shared_dir, _shared_file_size, skip_flags,
+                                               genesis_state, snapshot_file);
+                }
+                else if (_options->count("replay-blockchain") && !_options->count("resync-blockchain"))
+                {
+                    ilog("Replaying blockchain on user request.");
 
                     _chain_db->reindex(block_log_dir, _shared_dir, _shared_file_size, skip_flags, genesis_state);
                 }
@@ -402,6 +462,27 @@ public:
                                     genesis_state);
                 }
 
+                if (_options->count("export-snapshot"))
+                {
+                    _chain_db->export_snapshot(_options->at("export-snapshot").as<boost::filesystem::path>());
+                }
+
+                if (_options->count("compact-shared-file"))
+                {
+                    _chain_db->compact_shared_file(block_log_dir, _shared_dir, _shared_file_size, skip_flags,
+                                                   genesis_state);
+                }
+
+                if (_options->count("background-flush"))
+                {
+                    chainbase::flush_options flush_options;
+                    flush_options.max_bytes_per_second
+                        = fc::parse_size(_options->at("background-flush-rate").as<std::string>());
+
+                    ilog("Shared memory file is flushed in background");
+                    _chain_db->start_background_flush(flush_options);
+                }
+
                 if (_options->count("force-validate"))
                 {
                     ilog("All transaction signatures will be validated");
@@ -557,6 +638,7 @@ public:
                               bool sync_mode,
                               std::vector<fc::uint160_t>& contained_transaction_message_ids) override
     {
+        chainbase::lock_tag_scope lock_tag("p2p:handle_block");
         try
         {
             if (_running)
@@ -593,14 +675,7 @@ public:
                     // you can help the network code out by throwing a block_older_than_undo_history exception.
                     // when the net code sees that, it will stop trying to push blocks from that chain, but
                     // leave that peer connected so that they can get sync blocks from us
-                    uint32_t skip_flags = (_is_block_producer | _force_validate)
-                        ? database::skip_nothing
-                        : database::skip_transaction_signatures;
-                    if (sync_mode)
-                    {
-                        skip_flags |= database::skip_validate_invariants;
-                    }
-                    bool result = _chain_db->push_block(blk_msg.block, skip_flags);
+                    bool result = _chain_db->push_block(blk_msg.block, block_skip_flags(sync_mode));
 
                     if (!sync_mode)
                     {
@@ -634,8 +709,30 @@ public:
         FC_CAPTURE_AND_RETHROW((blk_msg)(sync_mode))
     }
 
+    /**
+     * @brief starts the checks of a sync block which don't need the chain state, handle_block of the block
+     * waits for them instead of doing them under the write lock.
+     */
+    virtual void prevalidate_block(const graphene::net::block_message& blk_msg) override
+    {
+        if (_running)
+            _chain_db->prevalidate_block(blk_msg.block, block_skip_flags(true));
+    }
+
+    uint32_t block_skip_flags(bool sync_mode) const
+    {
+        uint32_t skip_flags
+            = (_is_block_producer | _force_validate) ? database::skip_nothing : database::skip_transaction_signatures;
+        if (sync_mode)
+        {
+            skip_flags |= database::skip_validate_invariants;
+        }
+        return skip_flags;
+    }
+
     virtual void handle_transaction(const graphene::net::trx_message& transaction_message) override
     {
+        chainbase::lock_tag_scope lock_tag("p2p:handle_transaction");
         try
         {
             if (_running)
@@ -831,8 +928,9 @@ public:
     {
         try
         {
-            std::vector<item_hash_t> synopsis;
-            _chain_db->with_read_lock([&]() {
+            // read section can be retried, so the synopsis is built from scratch by every attempt
+            return _chain_db->with_read_lock([&]() {
+                std::vector<item_hash_t> synopsis;
                 synopsis.reserve(30);
                 uint32_t high_block_num;
                 uint32_t non_fork_high_block_num;
@@ -926,7 +1024,7 @@ public:
                     non_fork_high_block_num = high_block_num;
                     if (high_block_num == 0)
                     {
-                        return; // we have no blocks
+                        return synopsis; // we have no blocks
                     }
                 }
 
@@ -962,10 +1060,8 @@ public:
                 } while (low_block_num <= high_block_num);
 
                 // idump((synopsis));
-                return;
+                return synopsis;
             });
-
-            return synopsis;
         }
         FC_CAPTURE_AND_RETHROW()
     }
@@ -1174,6 +1270,11 @@ void application::set_program_options(boost::program_options::options_descriptio
     ("data-dir,d", bpo::value<boost::filesystem::path>()->default_value("witness_node_data_dir"), "Directory containing databases, configuration file, etc.")
     ("shared-file-dir", bpo::value<boost::filesystem::path>(), "Location of the shared memory file. Defaults to data_dir/blockchain")
     ("shared-file-size", bpo::value<std::string>()->default_value("54G"), "Size of the shared memory file. Default: 54G")
+    ("shared-file-huge-pages", "Back the shared memory file with transparent huge pages")
+    ("shared-file-prefault", bpo::value<std::string>()->default_value("none"), "Prefault the used part of the shared memory file on startup: none, advise or touch")
+    ("shared-file-numa", bpo::value<std::string>(), "Place the shared memory file on NUMA nodes: interleave or a node number")
+    ("shared-file-max-size", bpo::value<std::string>(), "Size up to which the shared memory file is grown without restart when it runs out of free memory. Growth is disabled by default")
+    ("shared-file-grow-step", bpo::value<std::string>()->default_value("2G"), "Size by which the shared memory file is grown. Default: 2G")
     ("rpc-endpoint", bpo::value<std::string>()->implicit_value("127.0.0.1:8090"), "Endpoint for websocket RPC to listen on")
     ("rpc-tls-endpoint", bpo::value<std::string>()->implicit_value("127.0.0.1:8089"), "Endpoint for TLS websocket RPC to listen on")
     ("read-forward-rpc", bpo::value<std::string>(), "Endpoint to forward write API calls to for a read node")
@@ -1183,14 +1284,26 @@ void application::set_program_options(boost::program_options::options_descriptio
     ("public-api", bpo::value< std::vector<std::string> >()->composing()->default_value(default_apis, str_default_apis), "Set an API to be publicly available, may be specified multiple times")
     ("enable-plugin", bpo::value< std::vector<std::string> >()->composing()->default_value(default_plugins, str_default_plugins), "Plugin(s) to enable, may be specified multiple times")
     ("max-block-age", bpo::value< int32_t >()->default_value(200), "Maximum age of head block when broadcasting tx via API")
-    ("flush", bpo::value< uint32_t >()->default_value(100000), "Flush shared memory file to disk this many blocks")
+    ("flush", bpo::value< uint32_t >()->default_value(100000), "Flush shared memory file to disk when this many more blocks become irreversible")
+    ("signature-recovery-threads", bpo::value< uint32_t >()->default_value(0), "Number of threads recovering signatures of incoming blocks before the block is applied. Default: 0 - signatures are recovered on apply")
+    ("signature-cache-size", bpo::value< uint32_t >()->default_value(100000), "Number of transaction signatures which recovered keys are cached for, they are reused by block application. 0 - disabled")
+    ("block-log-segment-size", bpo::value< uint32_t >()->default_value(0), "Number of blocks in a block log segment file, it's applied to a new block log. Default: 0 - block log is kept in one file")
+    ("block-log-keep-blocks", bpo::value< uint32_t >()->default_value(0), "Number of last irreversible blocks kept in the segmented block log, older segments are removed. Default: 0 - all blocks are kept")
+    ("block-log-write-queue-size", bpo::value< uint32_t >()->default_value(0), "Number of irreversible blocks which wait to be written to the block log by a background thread. Default: 0 - blocks are written by the thread applying them")
+    ("full-invariants-check-interval", bpo::value< uint32_t >()->default_value(0), "Verify supply invariants by the scan of all balances this many blocks, other blocks are checked by the tracked totals. Default: 0 - only on startup")
+    ("background-flush", "Flush shared memory file in background thread, block processing waits only for pages changed meanwhile")
+    ("background-flush-rate", bpo::value<std::string>()->default_value("0"), "Maximum bytes per second written by background flush, e.g. 64M. Default: 0 - unlimited")
     ("genesis-json,g", bpo::value<boost::filesystem::path>(), "File to read genesis state from")
     ("replay-blockchain", "Rebuild object graph by replaying all blocks")
     ("replay-skip-witness-schedule-check", bpo::value<bool>()->default_value(true), "Skip witness schedule check wile block replaying")
     ("resync-blockchain", "Delete all blocks and re-sync with network from scratch")
+    ("import-snapshot", bpo::value<boost::filesystem::path>(), "Load state from the snapshot file and replay only blocks which follow it")
+    ("export-snapshot", bpo::value<boost::filesystem::path>(), "Save state at the last irreversible block to the snapshot file on startup")
+    ("compact-shared-file", "Rebuild the shared memory file densely on startup, its free space is released")
     ("force-validate", "Force validation of all transactions")
     ("read-only", "Node will not connect to p2p network and can only read from the chain state")
     ("check-locks", "Check correctness of chainbase locking")
+    ("writer-priority", "Interrupt and retry API reads when blocks or transactions are applied, so reads never delay them")
     ("disable-get-block", "Disable get_block API call");
 
     // clang-format on
@@ -2,186 +2,1257 @@
 #include <fstream>
 #include <fc/io/raw.hpp>
 
-#define LOG_READ (std::ios::in | std::ios::binary)
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 
 namespace scorum {
 namespace chain {
 
 namespace detail {
-class block_log_impl
+
+/**
+ * Read only view of a file which grows by appends. Address space is reserved beyond the end of the file,
+ * so the appended data becomes readable without remapping, the file is remapped only when the reservation
+ * is exceeded. Readers take the mapping together with its readable size without locks.
+ */
+class mapped_file
 {
 public:
+    struct region
+    {
+        static const uint64_t reserve_step = 1ull << 30;
+
+        region(int fd, uint64_t size)
+            : capacity((size / reserve_step + 1) * reserve_step)
+        {
+            void* addr = ::mmap(nullptr, capacity, PROT_READ, MAP_SHARED, fd, 0);
+            FC_ASSERT(addr != MAP_FAILED, "Can't map block log file, errno ${e}", ("e", errno));
+            data = static_cast<const char*>(addr);
+        }
+
+        ~region()
+        {
+            ::munmap(const_cast<char*>(data), capacity);
+        }
+
+        const char* data;
+        uint64_t capacity;
+    };
+
+    struct view
+    {
+        std::shared_ptr<const region> mapping;
+        uint64_t size = 0;
+
+        uint64_t read_pos(uint64_t offset) const
+        {
+            FC_ASSERT(offset + sizeof(uint64_t) <= size, "Read beyond the end of block log",
+                      ("offset", offset)("size", size));
+            uint64_t pos;
+            std::memcpy(&pos, mapping->data + offset, sizeof(pos));
+            return pos;
+        }
+    };
+
+    ~mapped_file()
+    {
+        close();
+    }
+
+    /// Maps the file, it may replace another file which readers keep reading until they take the new view
+    void open(const fc::path& file)
+    {
+        const int fd = ::open(file.generic_string().c_str(), O_RDONLY);
+        FC_ASSERT(fd != -1, "Can't open ${file}, errno ${e}", ("file", file.generic_string())("e", errno));
+
+        const uint64_t size = fc::file_size(file);
+        std::shared_ptr<const region> mapping;
+        try
+        {
+            mapping = std::make_shared<region>(fd, size);
+        }
+        catch (...)
+        {
+            ::close(fd);
+            throw;
+        }
+
+        publish(mapping, size);
+
+        // the mapping keeps the previous file alive
+        close_fd();
+        _fd = fd;
+    }
+
+    void close()
+    {
+        publish(nullptr, 0);
+        close_fd();
+    }
+
+    /// Makes the first size bytes readable, the writer calls it when the data is flushed
+    void set_size(uint64_t size)
+    {
+        auto mapping = std::atomic_load(&_view)->mapping;
+        if (!mapping || mapping->capacity < size)
+            mapping = std::make_shared<region>(_fd, size);
+
+        publish(mapping, size);
+    }
+
+    uint64_t size() const
+    {
+        return std::atomic_load(&_view)->size;
+    }
+
+    /// Writes the flushed data of the file to the disk
+    void sync()
+    {
+        FC_ASSERT(::fdatasync(_fd) == 0, "Can't sync block log file, errno ${e}", ("e", errno));
+    }
+
+    view get_view() const
+    {
+        return *std::atomic_load(&_view);
+    }
+
+private:
+    // mapping and size are replaced together, so a reader never sees a size beyond its mapping
+    void publish(std::shared_ptr<const region> mapping, uint64_t size)
+    {
+        auto result = std::make_shared<view>();
+        result->mapping = std::move(mapping);
+        result->size = size;
+        std::atomic_store(&_view, std::shared_ptr<const view>(result));
+    }
+
+    void close_fd()
+    {
+        if (_fd != -1)
+        {
+            ::close(_fd);
+            _fd = -1;
+        }
+    }
+
+    int _fd = -1;
+    std::shared_ptr<const view> _view = std::make_shared<view>();
+};
+
+/*
+ * Compressed log keeps the same stream of blocks and positions as the raw log, positions in the index and
+ * the ones returned by read_block are offsets in that stream. The stream is cut into chunks of
+ * blocks_per_chunk blocks, sealed chunks are compressed and appended to the main file, blocks of the
+ * chunk which isn't full yet are kept raw in the tail file.
+ *
+ * +--------+------------------------+-----------------+------------------------+-----------------+-----+
+ * | Header | Chunk header (begin,   | Chunk 1 (zlib)  | Chunk header           | Chunk 2 (zlib)  | ... |
+ * |        | raw size, zlib size)   |                 |                        |                 |     |
+ * +--------+------------------------+-----------------+------------------------+-----------------+-----+
+ *
+ * +------------------------------+---------+----------------+-----+
+ * | Stream position of the tail  | Block N | Pos of Block N | ... |
+ * +------------------------------+---------+----------------+-----+
+ */
+const uint64_t compressed_log_magic = 0x315a4b4c42524353; // "SCRBLKZ1"
+
+struct compressed_log_header
+{
+    uint64_t magic = compressed_log_magic;
+    uint32_t blocks_per_chunk = 0;
+    uint32_t reserved = 0;
+};
+
+struct chunk_header
+{
+    uint64_t begin = 0;
+    uint32_t raw_size = 0;
+    uint32_t compressed_size = 0;
+};
+
+struct chunk
+{
+    uint64_t begin;
+    uint64_t end;
+    uint64_t file_pos; ///< position of the compressed data in the main file
+    uint32_t compressed_size;
+};
+
+using chunk_list = std::vector<chunk>;
+
+// bytes of the block stream starting at a position, they are kept alive by the holder
+struct stream_span
+{
+    std::shared_ptr<const void> holder;
+    const char* data = nullptr;
+    uint64_t size = 0;
+};
+
+/// One file of the log with its index and tail, it's the whole log or a segment of it
+class block_log_file
+{
+public:
+    static const size_t decompressed_chunks_cache_size = 8;
+
+    block_log_file(const fc::path& file, uint32_t first_block_num)
+        : first_block_num(first_block_num)
+        , block_file(file)
+        , index_file(block_log::block_log_index_path(file))
+        , tail_file(block_log::block_log_tail_path(file))
+    {
+        block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+        index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+        tail_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+    }
+
+    const uint32_t first_block_num;
+
     optional<signed_block> head;
     block_id_type head_id;
+    std::atomic<uint32_t> head_num{ 0 };
+
     std::fstream block_stream;
     std::fstream index_stream;
-    fc::path block_file;
-    fc::path index_file;
-    bool block_write;
-    bool index_write;
+    std::fstream tail_stream;
+    const fc::path block_file;
+    const fc::path index_file;
+    const fc::path tail_file;
+
+    uint32_t blocks_per_chunk = 0; ///< 0 for the raw format
 
-    inline void check_block_read()
+    /// Files are not changed, problems which open repairs are kept in problems instead
+    bool read_only = false;
+    std::vector<std::string> problems;
+
+    // bytes written to the files, some of them may be not flushed yet
+    std::atomic<uint64_t> block_size{ 0 };
+    std::atomic<uint64_t> index_size{ 0 };
+    std::atomic<uint64_t> tail_size{ 0 };
+
+    mapped_file block_map;
+    mapped_file index_map;
+    mapped_file tail_map;
+
+    std::shared_ptr<const chunk_list> chunks = std::make_shared<chunk_list>();
+    uint64_t tail_begin = 0;
+    uint32_t tail_blocks = 0;
+
+    std::mutex cache_mutex;
+    std::list<std::pair<size_t, std::shared_ptr<const std::vector<char>>>> decompressed_chunks;
+
+    // appends and flushes, reads don't take it unless they need data which isn't flushed
+    std::mutex write_mutex;
+
+    bool compressed() const
     {
-        try
+        return blocks_per_chunk != 0;
+    }
+
+    /// Size of the block stream
+    uint64_t stream_size() const
+    {
+        return compressed() ? tail_begin + tail_size - sizeof(uint64_t) : block_size.load();
+    }
+
+    /// Flushes the streams and makes the written data readable, caller holds write_mutex
+    void publish()
+    {
+        block_stream.flush();
+        if (tail_stream.is_open())
+            tail_stream.flush();
+        index_stream.flush();
+
+        // index is published last, so it never points to a block which isn't readable
+        block_map.set_size(block_size);
+        if (tail_stream.is_open())
+            tail_map.set_size(tail_size);
+        index_map.set_size(index_size);
+    }
+
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        if (block_stream.is_open())
+            publish();
+    }
+
+    mapped_file::view read_view(mapped_file& file, uint64_t end)
+    {
+        if (file.size() < end)
+            flush();
+        return file.get_view();
+    }
+
+    void open_index_write()
+    {
+        if (read_only)
+        {
+            index_size = 0;
+            if (!fc::exists(index_file))
+                return;
+            index_size = fc::file_size(index_file);
+            index_map.open(index_file);
+            return;
+        }
+
+        index_stream.open(index_file.generic_string().c_str(), LOG_WRITE);
+        index_size = fc::file_size(index_file);
+        index_map.open(index_file);
+    }
+
+    stream_span locate(uint64_t pos, size_t chunk_hint)
+    {
+        if (!compressed())
         {
-            if (block_write)
+            auto view = read_view(block_map, pos + 1);
+            FC_ASSERT(pos < view.size, "Position is beyond the end of block log", ("pos", pos)("size", view.size));
+            return { view.mapping, view.mapping->data + pos, view.size - pos };
+        }
+
+        // a chunk may be sealed while the tail is read, then the position is looked up again
+        for (int attempt = 0; attempt < 3; ++attempt)
+        {
+            auto sealed = std::atomic_load(&chunks);
+            if (!sealed->empty() && pos < sealed->back().end)
+                return locate_in_chunk(*sealed, pos, chunk_hint);
+
+            auto view = tail_map.get_view();
+            if (view.size >= sizeof(uint64_t))
             {
-                block_stream.close();
-                block_stream.open(block_file.generic_string().c_str(), LOG_READ);
-                block_write = false;
+                const uint64_t begin = view.read_pos(0);
+                if (pos < begin)
+                    continue;
+
+                const uint64_t offset = pos - begin + sizeof(uint64_t);
+                if (offset < view.size)
+                    return { view.mapping, view.mapping->data + offset, view.size - offset };
             }
+
+            std::lock_guard<std::mutex> lock(write_mutex);
+            FC_ASSERT(pos < stream_size() && block_stream.is_open(), "Position is beyond the end of block log",
+                      ("pos", pos)("size", stream_size()));
+            publish();
+        }
+
+        FC_THROW("Can't read block log at ${pos}", ("pos", pos));
+    }
+
+    stream_span locate_in_chunk(const chunk_list& sealed, uint64_t pos, size_t chunk_hint)
+    {
+        size_t index = chunk_hint;
+        if (index >= sealed.size() || pos < sealed[index].begin || pos >= sealed[index].end)
+        {
+            auto itr = std::upper_bound(sealed.begin(), sealed.end(), pos,
+                                        [](uint64_t p, const chunk& c) { return p < c.begin; });
+            FC_ASSERT(itr != sealed.begin());
+            index = std::distance(sealed.begin(), itr) - 1;
         }
-        FC_LOG_AND_RETHROW()
+
+        const chunk& c = sealed[index];
+        auto data = decompressed_chunk(index, c);
+        const uint64_t offset = pos - c.begin;
+        return { data, data->data() + offset, data->size() - offset };
     }
 
-    inline void check_block_write()
+    std::shared_ptr<const std::vector<char>> decompressed_chunk(size_t index, const chunk& c)
     {
-        try
         {
-            if (!block_write)
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            auto itr = std::find_if(decompressed_chunks.begin(), decompressed_chunks.end(),
+                                    [&](const auto& entry) { return entry.first == index; });
+            if (itr != decompressed_chunks.end())
             {
-                block_stream.close();
-                block_stream.open(block_file.generic_string().c_str(), LOG_WRITE);
-                block_write = true;
+                decompressed_chunks.splice(decompressed_chunks.begin(), decompressed_chunks, itr);
+                return itr->second;
             }
         }
-        FC_LOG_AND_RETHROW()
+
+        auto view = read_view(block_map, c.file_pos + c.compressed_size);
+        FC_ASSERT(c.file_pos + c.compressed_size <= view.size, "Chunk is beyond the end of block log");
+
+        auto data = std::make_shared<std::vector<char>>(c.end - c.begin);
+        uLongf size = data->size();
+        const int rc = ::uncompress(reinterpret_cast<Bytef*>(data->data()), &size,
+                                    reinterpret_cast<const Bytef*>(view.mapping->data + c.file_pos),
+                                    c.compressed_size);
+        FC_ASSERT(rc == Z_OK && size == data->size(), "Can't decompress block log chunk ${n}", ("n", index)("rc", rc));
+
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        decompressed_chunks.emplace_front(index, data);
+        if (decompressed_chunks.size() > decompressed_chunks_cache_size)
+            decompressed_chunks.pop_back();
+
+        return data;
     }
 
-    inline void check_index_read()
+    uint64_t read_stream_pos(uint64_t pos)
     {
-        try
+        auto span = locate(pos, std::numeric_limits<size_t>::max());
+        FC_ASSERT(span.size >= sizeof(uint64_t), "Read beyond the end of block log", ("pos", pos));
+        uint64_t result;
+        std::memcpy(&result, span.data, sizeof(result));
+        return result;
+    }
+
+    void write_compressed_header()
+    {
+        compressed_log_header header;
+        header.blocks_per_chunk = blocks_per_chunk;
+        block_stream.write((const char*)&header, sizeof(header));
+        block_size += sizeof(header);
+    }
+
+    /// Reads chunk headers, a chunk which wasn't written completely is cut off, its blocks are in the tail
+    void load_chunks()
+    {
+        auto view = block_map.get_view();
+        auto result = std::make_shared<chunk_list>();
+
+        uint64_t file_pos = sizeof(compressed_log_header);
+        uint64_t stream_pos = 0;
+        while (file_pos + sizeof(chunk_header) <= view.size)
+        {
+            chunk_header header;
+            std::memcpy(&header, view.mapping->data + file_pos, sizeof(header));
+
+            const uint64_t data_pos = file_pos + sizeof(header);
+            if (data_pos + header.compressed_size > view.size)
+                break;
+
+            FC_ASSERT(header.begin == stream_pos, "Block log chunk ${n} is out of order", ("n", result->size()));
+            result->push_back({ header.begin, header.begin + header.raw_size, data_pos, header.compressed_size });
+
+            stream_pos += header.raw_size;
+            file_pos = data_pos + header.compressed_size;
+        }
+
+        if (file_pos < view.size && read_only)
+        {
+            problems.push_back("Block log has an incomplete chunk at " + std::to_string(file_pos));
+        }
+        else if (file_pos < view.size)
+        {
+            wlog("Block log has an incomplete chunk, it's removed");
+            block_stream.close();
+            block_map.close();
+            boost::filesystem::resize_file(block_file, file_pos);
+            block_stream.open(block_file.generic_string().c_str(), LOG_WRITE);
+            block_map.open(block_file);
+        }
+
+        block_size = file_pos;
+        std::atomic_store(&chunks, std::shared_ptr<const chunk_list>(result));
+    }
+
+    /// Tail starting at the stream position, the previous tail is replaced by rename so its readers are intact
+    void reset_tail(uint64_t begin)
+    {
+        const fc::path tmp_file = tail_file.generic_string() + ".tmp";
+        {
+            std::ofstream tmp(tmp_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+            tmp.write((const char*)&begin, sizeof(begin));
+        }
+        fc::rename(tmp_file, tail_file);
+
+        if (tail_stream.is_open())
+            tail_stream.close();
+        tail_stream.open(tail_file.generic_string().c_str(), LOG_WRITE);
+        tail_map.open(tail_file);
+        tail_map.sync();
+
+        tail_begin = begin;
+        tail_size = sizeof(begin);
+        tail_blocks = 0;
+    }
+
+    void open_tail()
+    {
+        const auto& sealed = *std::atomic_load(&chunks);
+        const uint64_t sealed_end = sealed.empty() ? 0 : sealed.back().end;
+
+        if (!fc::exists(tail_file) || fc::file_size(tail_file) < sizeof(uint64_t))
+        {
+            if (read_only)
+                return empty_tail(sealed_end, "Block log tail is missing");
+            reset_tail(sealed_end);
+            return;
+        }
+
+        if (!read_only)
+            tail_stream.open(tail_file.generic_string().c_str(), LOG_WRITE);
+        tail_map.open(tail_file);
+        tail_size = fc::file_size(tail_file);
+        tail_begin = tail_map.get_view().read_pos(0);
+
+        if (tail_begin < sealed_end && read_only)
+        {
+            tail_map.close();
+            return empty_tail(sealed_end, "Block log tail is sealed already");
+        }
+
+        if (tail_begin < sealed_end)
         {
-            if (index_write)
+            // the node stopped after the chunk was written but before the tail was reset
+            ilog("Block log tail is sealed already, reset it");
+            reset_tail(sealed_end);
+            return;
+        }
+
+        FC_ASSERT(tail_begin == sealed_end, "Block log tail doesn't follow the last chunk",
+                  ("tail", tail_begin)("chunks_end", sealed_end));
+    }
+
+    /// Tail of the read only log which has no blocks, the files are left as they are
+    void empty_tail(uint64_t begin, const std::string& problem)
+    {
+        problems.push_back(problem);
+        tail_begin = begin;
+        tail_size = sizeof(begin);
+    }
+
+    /// Compresses the tail into a chunk, caller holds write_mutex
+    void seal_tail()
+    {
+        publish();
+
+        auto view = tail_map.get_view();
+        const char* raw = view.mapping->data + sizeof(uint64_t);
+        const uint64_t raw_size = view.size - sizeof(uint64_t);
+        FC_ASSERT(raw_size <= std::numeric_limits<uint32_t>::max(),
+                  "Block log chunk is too big, reduce blocks per chunk");
+
+        std::vector<char> compressed(::compressBound(raw_size));
+        uLongf compressed_size = compressed.size();
+        const int rc = ::compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size,
+                                   reinterpret_cast<const Bytef*>(raw), raw_size, Z_DEFAULT_COMPRESSION);
+        FC_ASSERT(rc == Z_OK, "Can't compress block log chunk", ("rc", rc));
+
+        chunk_header header;
+        header.begin = tail_begin;
+        header.raw_size = raw_size;
+        header.compressed_size = compressed_size;
+
+        const uint64_t data_pos = block_size + sizeof(header);
+        block_stream.write((const char*)&header, sizeof(header));
+        block_stream.write(compressed.data(), compressed_size);
+        block_size = data_pos + compressed_size;
+        block_stream.flush();
+        block_map.set_size(block_size);
+        // the chunk is on the disk before the tail is dropped, open_tail recovers from the old tail then
+        block_map.sync();
+
+        auto sealed = std::make_shared<chunk_list>(*std::atomic_load(&chunks));
+        sealed->push_back({ tail_begin, tail_begin + raw_size, data_pos, header.compressed_size });
+        std::atomic_store(&chunks, std::shared_ptr<const chunk_list>(sealed));
+
+        reset_tail(tail_begin + raw_size);
+    }
+
+    void open(uint32_t new_blocks_per_chunk, bool open_read_only)
+    {
+        read_only = open_read_only;
+        if (read_only)
+        {
+            FC_ASSERT(fc::exists(block_file), "There is no block log ${f}", ("f", block_file.generic_string()));
+            block_size = fc::file_size(block_file);
+            block_map.open(block_file);
+            new_blocks_per_chunk = 0;
+        }
+        else
+        {
+            block_stream.open(block_file.generic_string().c_str(), LOG_WRITE);
+            block_size = fc::file_size(block_file);
+            block_map.open(block_file);
+        }
+
+        // format of an existing log is taken from its header, raw log starts with zero id of the genesis previous
+        blocks_per_chunk = 0;
+        if (block_size >= sizeof(compressed_log_header))
+        {
+            compressed_log_header header;
+            std::memcpy(&header, block_map.get_view().mapping->data, sizeof(header));
+            if (header.magic == compressed_log_magic)
+                blocks_per_chunk = header.blocks_per_chunk;
+        }
+        else if (!block_size && new_blocks_per_chunk)
+        {
+            fc::remove_all(tail_file);
+            blocks_per_chunk = new_blocks_per_chunk;
+            write_compressed_header();
+            block_stream.flush();
+            block_map.set_size(block_size);
+        }
+
+        if (compressed())
+        {
+            load_chunks();
+            open_tail();
+        }
+
+        open_index_write();
+
+        /* On startup of the block log, there are several states the log file and the index file can be
+         * in relation to eachother.
+         *
+         *                          Block Log
+         *                     Exists       Is New
+         *                 +------------+------------+
+         *          Exists |    Check   |   Delete   |
+         *   Index         |    Head    |    Index   |
+         *    File         +------------+------------+
+         *          Is New |   Replay   |     Do     |
+         *                 |    Log     |   Nothing  |
+         *                 +------------+------------+
+         *
+         * Checking the heads of the files has several conditions as well.
+         *  - If they are the same, do nothing.
+         *  - If the index file head is not in the log file, delete the index and replay.
+         *  - If the index file head is in the log, but not up to date, replay from index head.
+         */
+        uint64_t log_size = stream_size();
+        uint64_t log_index_size = index_size;
+
+        if (log_size)
+        {
+            ilog("Log is nonempty");
+            head = read_head();
+            head_id = head->id();
+            head_num = head->block_num();
+
+            if (compressed())
+                tail_blocks = head_num - (first_block_num - 1) - chunks->size() * blocks_per_chunk;
+
+            if (log_index_size)
             {
-                index_stream.close();
-                index_stream.open(index_file.generic_string().c_str(), LOG_READ);
-                index_write = false;
+                ilog("Index is nonempty");
+                uint64_t block_pos = read_stream_pos(log_size - sizeof(uint64_t));
+                uint64_t index_pos = index_map.get_view().read_pos(log_index_size - sizeof(uint64_t));
+
+                if (block_pos != index_pos && read_only)
+                {
+                    problems.push_back("Index head position " + std::to_string(index_pos)
+                                       + " doesn't match the log head position " + std::to_string(block_pos));
+                }
+                else if (block_pos < index_pos)
+                {
+                    ilog("block_pos < index_pos, close and reopen index_stream");
+                    construct_index();
+                }
+                else if (block_pos > index_pos)
+                {
+                    ilog("Index is incomplete");
+                    construct_index();
+                }
             }
+            else if (read_only)
+            {
+                problems.push_back("Index is empty");
+            }
+            else
+            {
+                ilog("Index is empty");
+                construct_index();
+            }
+        }
+        else if (log_index_size && read_only)
+        {
+            problems.push_back("Index of the empty log is nonempty");
+        }
+        else if (log_index_size)
+        {
+            ilog("Index is nonempty, remove and recreate it");
+            index_stream.close();
+            index_map.close();
+            fc::remove_all(index_file);
+            open_index_write();
         }
-        FC_LOG_AND_RETHROW()
     }
 
-    inline void check_index_write()
+    /// Makes the written data readable and writes it to the disk, blocks are synced before the index
+    void sync()
     {
-        try
+        flush();
+
+        block_map.sync();
+        if (tail_stream.is_open())
+            tail_map.sync();
+        index_map.sync();
+    }
+
+    uint64_t append(const signed_block& b, const std::vector<char>& data)
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+
+        uint64_t pos = stream_size();
+        const uint64_t expected_index_size = sizeof(uint64_t) * ((uint64_t)b.block_num() - first_block_num);
+        FC_ASSERT(b.block_num() >= first_block_num && index_size == expected_index_size,
+                  "Append to index file occuring at wrong position.",
+                  ("position", index_size.load())("expected", expected_index_size));
+        auto& stream = compressed() ? tail_stream : block_stream;
+        stream.write(data.data(), data.size());
+        stream.write((char*)&pos, sizeof(pos));
+        index_stream.write((char*)&pos, sizeof(pos));
+        (compressed() ? tail_size : block_size) += data.size() + sizeof(pos);
+        index_size += sizeof(pos);
+        head = b;
+        head_id = b.id();
+        head_num = b.block_num();
+
+        if (compressed() && ++tail_blocks == blocks_per_chunk)
+            seal_tail();
+
+        return pos;
+    }
+
+    std::pair<signed_block, uint64_t> read_block(uint64_t pos, size_t chunk_hint)
+    {
+        auto span = locate(pos, chunk_hint);
+        fc::datastream<const char*> ds(span.data, span.size);
+
+        std::pair<signed_block, uint64_t> result;
+        fc::raw::unpack(ds, result.first);
+        result.second = pos + (span.size - ds.remaining()) + sizeof(uint64_t);
+        return result;
+    }
+
+    optional<signed_block> read_block_by_num(uint32_t block_num)
+    {
+        optional<signed_block> b;
+        uint64_t pos = get_block_pos(block_num);
+        if (pos != block_log::npos)
+        {
+            // chunks have the same number of blocks, so the chunk is found without search
+            const size_t chunk_hint = compressed() ? (block_num - first_block_num) / blocks_per_chunk
+                                                   : std::numeric_limits<size_t>::max();
+            b = read_block(pos, chunk_hint).first;
+            FC_ASSERT(b->block_num() == block_num, "Wrong block was read from block log.",
+                      ("returned", b->block_num())("expected", block_num));
+        }
+        return b;
+    }
+
+    uint64_t get_block_pos(uint32_t block_num)
+    {
+        if (!(block_num <= head_num && block_num >= first_block_num))
+            return block_log::npos;
+
+        const uint64_t offset = sizeof(uint64_t) * (block_num - first_block_num);
+        return read_view(index_map, offset + sizeof(uint64_t)).read_pos(offset);
+    }
+
+    signed_block read_head()
+    {
+        const uint64_t size = stream_size();
+        FC_ASSERT(size >= sizeof(uint64_t), "Block log is empty");
+
+        return read_block(read_stream_pos(size - sizeof(uint64_t)), std::numeric_limits<size_t>::max()).first;
+    }
+
+    /**
+     * Index is taken from the positions which follow the blocks, the log is walked from the head back to
+     * the first block, so blocks are not unpacked. Positions are written to the index file from its end
+     * by batches. Head is read already.
+     */
+    void construct_index()
+    {
+        static const uint64_t batch_size = 1 << 16;
+
+        ilog("Reconstructing Block Log Index...");
+        index_stream.close();
+        index_map.close();
+        fc::remove_all(index_file);
+
+        const uint64_t count = head_num - first_block_num + 1;
         {
-            if (!index_write)
+            std::fstream index(index_file.generic_string().c_str(),
+                               std::ios::out | std::ios::binary | std::ios::trunc);
+            index.close();
+            boost::filesystem::resize_file(index_file, count * sizeof(uint64_t));
+
+            index.exceptions(std::fstream::failbit | std::fstream::badbit);
+            index.open(index_file.generic_string().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+
+            std::vector<uint64_t> batch;
+            uint64_t pos = read_stream_pos(stream_size() - sizeof(uint64_t));
+            for (uint64_t end = count; end > 0;)
             {
-                index_stream.close();
-                index_stream.open(index_file.generic_string().c_str(), LOG_WRITE);
-                index_write = true;
+                const uint64_t begin = end - std::min(end, batch_size);
+                batch.resize(end - begin);
+
+                for (uint64_t i = end; i > begin; --i)
+                {
+                    batch[i - 1 - begin] = pos;
+                    if (i == 1)
+                        break;
+
+                    FC_ASSERT(pos >= sizeof(uint64_t), "Block log doesn't have block ${n}",
+                              ("n", first_block_num + i - 2));
+                    const uint64_t prev_pos = read_stream_pos(pos - sizeof(uint64_t));
+                    FC_ASSERT(prev_pos < pos, "Block log has wrong position of block ${n}",
+                              ("n", first_block_num + i - 2)("pos", prev_pos));
+                    pos = prev_pos;
+                }
+
+                index.seekp(begin * sizeof(uint64_t));
+                index.write((const char*)batch.data(), batch.size() * sizeof(uint64_t));
+                end = begin;
             }
+
+            FC_ASSERT(pos == 0, "Block log has more blocks than its head number",
+                      ("head_num", head_num.load())("first_pos", pos));
         }
-        FC_LOG_AND_RETHROW()
+
+        open_index_write();
+
+        FC_ASSERT(read_block(0, 0).first.block_num() == first_block_num, "Block log doesn't start with block ${n}",
+                  ("n", first_block_num));
     }
 };
-}
 
-block_log::block_log()
-    : my(new detail::block_log_impl())
+using segment_list = std::vector<std::shared_ptr<block_log_file>>;
+
+/*
+ * Segmented log keeps blocks of each blocks_per_segment range in its own file with its own index and tail:
+ *
+ *   block_log.0000000001-0001000000, block_log.0001000001-0002000000, ...
+ *
+ * Segments which are not the head one are complete, so they may be removed or moved to an archive. A position
+ * in the segmented log has the segment number in the high bits and the position in the segment file
+ * in the low ones.
+ */
+const uint32_t segment_pos_bits = 40;
+const uint64_t segment_pos_mask = (1ull << segment_pos_bits) - 1;
+const size_t segment_name_size = 21;
+
+struct segment_file
 {
-    my->block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
-    my->index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+    uint32_t first_block_num;
+    uint32_t last_block_num;
+    fc::path path;
+};
+
+/// Segment files of the log ordered by block numbers, their index and tail files are skipped
+std::vector<segment_file> find_segment_files(const fc::path& file)
+{
+    std::vector<segment_file> result;
+
+    const fc::path dir = file.parent_path().empty() ? fc::path(".") : file.parent_path();
+    if (!fc::exists(dir))
+        return result;
+
+    const std::string prefix = file.filename().generic_string() + ".";
+    for (boost::filesystem::directory_iterator itr(dir), end; itr != end; ++itr)
+    {
+        const std::string name = itr->path().filename().generic_string();
+        if (name.size() != prefix.size() + segment_name_size || name.compare(0, prefix.size(), prefix))
+            continue;
+
+        const std::string range = name.substr(prefix.size());
+        if (range[10] != '-'
+            || !std::all_of(range.begin(), range.begin() + 10, [](char c) { return c >= '0' && c <= '9'; })
+            || !std::all_of(range.begin() + 11, range.end(), [](char c) { return c >= '0' && c <= '9'; }))
+            continue;
+
+        result.push_back({ (uint32_t)std::stoul(range.substr(0, 10)), (uint32_t)std::stoul(range.substr(11)),
+                           itr->path() });
+    }
+
+    std::sort(result.begin(), result.end(),
+              [](const segment_file& l, const segment_file& r) { return l.first_block_num < r.first_block_num; });
+    return result;
 }
 
-block_log::~block_log()
+void remove_file_set(const fc::path& file)
 {
-    flush();
+    fc::remove_all(file);
+    fc::remove_all(block_log::block_log_index_path(file));
+    fc::remove_all(block_log::block_log_tail_path(file));
 }
 
-void block_log::open(const fc::path& file)
-{
-    if (my->block_stream.is_open())
-        my->block_stream.close();
-    if (my->index_stream.is_open())
-        my->index_stream.close();
-
-    my->block_file = file;
-    my->index_file = block_log_index_path(file);
-
-    my->block_stream.open(my->block_file.generic_string().c_str(), LOG_WRITE);
-    my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
-    my->block_write = true;
-    my->index_write = true;
-
-    /* On startup of the block log, there are several states the log file and the index file can be
-     * in relation to eachother.
-     *
-     *                          Block Log
-     *                     Exists       Is New
-     *                 +------------+------------+
-     *          Exists |    Check   |   Delete   |
-     *   Index         |    Head    |    Index   |
-     *    File         +------------+------------+
-     *          Is New |   Replay   |     Do     |
-     *                 |    Log     |   Nothing  |
-     *                 +------------+------------+
-     *
-     * Checking the heads of the files has several conditions as well.
-     *  - If they are the same, do nothing.
-     *  - If the index file head is not in the log file, delete the index and replay.
-     *  - If the index file head is in the log, but not up to date, replay from index head.
-     */
-    auto log_size = fc::file_size(my->block_file);
-    auto index_size = fc::file_size(my->index_file);
+class block_log_impl
+{
+public:
+    fc::path file;
+    bool opened = false;
+    bool read_only = false;
+    /// Problems of the layout found by the read only open, problems of the files are kept by the files
+    std::vector<std::string> problems;
+
+    uint32_t new_blocks_per_chunk = 0;
+    uint32_t blocks_per_segment = 0; ///< 0 for the log in one file
+
+    // the writer replaces the list under append_mutex, readers take it without locks
+    std::shared_ptr<const segment_list> segments = std::make_shared<segment_list>();
+
+    // appends to the files and changes of the segment list, they are made by the background writer if it's started
+    std::mutex append_mutex;
 
-    if (log_size)
+    /// Last block passed to append or append_async
+    optional<signed_block> head;
+
+    struct queued_block
     {
-        ilog("Log is nonempty");
-        my->head = read_head();
-        my->head_id = my->head->id();
+        signed_block block;
+        std::vector<char> data;
+    };
 
-        if (index_size)
+    // blocks of append_async ordered by number, a block is removed from the queue when it's written,
+    // so it's read either from the queue or from the files
+    std::deque<std::shared_ptr<const queued_block>> queue;
+    size_t max_queue_size = 0;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv; ///< the writer waits for blocks
+    std::condition_variable written_cv; ///< appending threads wait for free space and flush waits for empty queue
+    bool stop_writer = false;
+    std::exception_ptr writer_error;
+    std::thread writer;
+
+    ~block_log_impl()
+    {
+        join_writer();
+    }
+
+    bool segmented() const
+    {
+        return blocks_per_segment != 0;
+    }
+
+    uint32_t segment_number(uint32_t block_num) const
+    {
+        return segmented() ? (block_num - 1) / blocks_per_segment : 0;
+    }
+
+    uint32_t last_block_num(uint32_t segment) const
+    {
+        return segmented() ? (segment + 1) * blocks_per_segment : std::numeric_limits<uint32_t>::max();
+    }
+
+    fc::path segment_path(uint32_t segment) const
+    {
+        char range[segment_name_size + 1];
+        std::snprintf(range, sizeof(range), "%010u-%010u", segment * blocks_per_segment + 1,
+                      last_block_num(segment));
+        return fc::path(file.generic_string() + "." + range);
+    }
+
+    uint64_t encode_pos(uint32_t segment, uint64_t pos) const
+    {
+        if (!segmented())
+            return pos;
+
+        FC_ASSERT(pos <= segment_pos_mask && segment < (1u << (64 - segment_pos_bits)),
+                  "Block log segment is too big, reduce blocks per segment", ("segment", segment)("pos", pos));
+        return ((uint64_t)segment << segment_pos_bits) | pos;
+    }
+
+    std::shared_ptr<block_log_file> find_segment(uint32_t segment) const
+    {
+        auto list = std::atomic_load(&segments);
+        if (list->empty())
+            return {};
+
+        // segments are contiguous
+        const uint32_t front = segment_number(list->front()->first_block_num);
+        if (segment < front || segment - front >= list->size())
+            return {};
+        return (*list)[segment - front];
+    }
+
+    std::shared_ptr<block_log_file> open_segment(const fc::path& path, uint32_t first_block_num, uint32_t chunk)
+    {
+        auto result = std::make_shared<block_log_file>(path, first_block_num);
+        result->open(chunk, read_only);
+        return result;
+    }
+
+    /// New head segment, previous one is complete, so it's written to the disk
+    void add_segment(uint32_t segment)
+    {
+        auto list = std::make_shared<segment_list>(*segments);
+        FC_ASSERT(list->empty() || segment_number(list->back()->first_block_num) + 1 == segment,
+                  "Block log segment ${n} doesn't follow the head one", ("n", segment));
+
+        uint32_t chunk = new_blocks_per_chunk;
+        if (!list->empty())
         {
-            my->check_block_read();
-            my->check_index_read();
+            list->back()->sync();
+            chunk = list->back()->blocks_per_chunk;
+        }
 
-            ilog("Index is nonempty");
-            uint64_t block_pos;
-            my->block_stream.seekg(-sizeof(uint64_t), std::ios::end);
-            my->block_stream.read((char*)&block_pos, sizeof(block_pos));
+        list->push_back(open_segment(segment_path(segment), segment * blocks_per_segment + 1, chunk));
+        std::atomic_store(&segments, std::shared_ptr<const segment_list>(list));
+    }
 
-            uint64_t index_pos;
-            my->index_stream.seekg(-sizeof(uint64_t), std::ios::end);
-            my->index_stream.read((char*)&index_pos, sizeof(index_pos));
+    /// Appends to the head segment, a new one is started with its first block. Caller holds append_mutex
+    uint64_t append(const signed_block& b, const std::vector<char>& data)
+    {
+        const uint32_t segment = segment_number(b.block_num());
+        if (segments->empty() || segment > segment_number(segments->back()->first_block_num))
+            add_segment(segment);
+
+        return encode_pos(segment, segments->back()->append(b, data));
+    }
+
+    optional<signed_block> find_queued(uint32_t block_num)
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (queue.empty() || block_num < queue.front()->block.block_num())
+            return {};
+
+        const size_t index = block_num - queue.front()->block.block_num();
+        if (index >= queue.size())
+            return {};
+        return queue[index]->block;
+    }
 
-            if (block_pos < index_pos)
+    /// Waits until queued blocks are written, an error of the writer is thrown here
+    void wait_written()
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        written_cv.wait(lock, [this]() { return queue.empty() || writer_error; });
+
+        if (writer_error)
+            std::rethrow_exception(writer_error);
+    }
+
+    void run_writer()
+    {
+        for (;;)
+        {
+            std::vector<std::shared_ptr<const queued_block>> group;
             {
-                ilog("block_pos < index_pos, close and reopen index_stream");
-                construct_index();
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_cv.wait(lock, [this]() { return stop_writer || !queue.empty(); });
+
+                if (queue.empty())
+                    return;
+
+                group.assign(queue.begin(), queue.end());
             }
-            else if (block_pos > index_pos)
+
+            // blocks queued while the group is written make the next group, so one sync is made for many blocks
+            size_t written = 0;
+            try
             {
-                ilog("Index is incomplete");
-                construct_index();
+                std::lock_guard<std::mutex> lock(append_mutex);
+                for (const auto& queued : group)
+                {
+                    append(queued->block, queued->data);
+                    ++written;
+                }
+                segments->back()->sync();
             }
+            catch (...)
+            {
+                // the block which isn't written and the following ones stay in the queue, so there is no gap
+                // in the log, the writer stops and the error is thrown to the appending thread
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    queue.erase(queue.begin(), queue.begin() + written);
+                    writer_error = std::current_exception();
+                }
+                written_cv.notify_all();
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                queue.erase(queue.begin(), queue.begin() + group.size());
+            }
+            written_cv.notify_all();
         }
-        else
+    }
+
+    /// Writes queued blocks and stops the writer, it doesn't throw
+    void join_writer()
+    {
+        if (!writer.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stop_writer = true;
+        }
+        queue_cv.notify_one();
+        writer.join();
+    }
+
+    /// Writes queued blocks and stops the writer, an error of the writer is thrown here
+    void stop()
+    {
+        join_writer();
+
+        if (writer_error)
+            std::rethrow_exception(writer_error);
+    }
+
+    void open_segments(const std::vector<segment_file>& files)
+    {
+        blocks_per_segment = files.front().last_block_num - files.front().first_block_num + 1;
+
+        auto list = std::make_shared<segment_list>();
+        for (const auto& f : files)
+        {
+            const uint32_t segment = segment_number(f.first_block_num);
+            FC_ASSERT(f.first_block_num == segment * blocks_per_segment + 1
+                          && f.last_block_num == last_block_num(segment),
+                      "Block log segment ${f} has wrong size", ("f", f.path.generic_string()));
+            FC_ASSERT(list->empty() || segment_number(list->back()->first_block_num) + 1 == segment,
+                      "Block log segment before ${f} is missing", ("f", f.path.generic_string()));
+            FC_ASSERT(list->empty() || list->back()->head_num == last_block_num(segment - 1),
+                      "Block log segment before ${f} is incomplete", ("f", f.path.generic_string()));
+
+            list->push_back(open_segment(f.path, f.first_block_num, new_blocks_per_chunk));
+        }
+
+        // head segment is created with its first block, it's empty if the node stopped in between
+        if (!list->back()->head_num && read_only)
+        {
+            problems.push_back("Block log segment " + list->back()->block_file.generic_string() + " is empty");
+            list->pop_back();
+        }
+        else if (!list->back()->head_num)
         {
-            ilog("Index is empty");
-            construct_index();
+            ilog("Block log segment ${f} is empty, remove it", ("f", list->back()->block_file.generic_string()));
+            const fc::path path = list->back()->block_file;
+            list->pop_back();
+            remove_file_set(path);
         }
+
+        segments = list;
+    }
+};
+}
+
+block_log::block_log()
+    : my(new detail::block_log_impl())
+{
+}
+
+block_log::~block_log()
+{
+    try
+    {
+        flush();
+    }
+    catch (...)
+    {
+        wlog("Block log isn't flushed");
+    }
+}
+
+void block_log::open(const fc::path& file, uint32_t blocks_per_chunk, uint32_t blocks_per_segment)
+{
+    close();
+
+    my->file = file;
+    my->new_blocks_per_chunk = blocks_per_chunk;
+
+    // layout of an existing log is taken from its files
+    const auto segment_files = detail::find_segment_files(file);
+    if (fc::exists(file))
+    {
+        FC_ASSERT(segment_files.empty(), "Block log ${f} exists in one file and in segments",
+                  ("f", file.generic_string()));
+        my->segments = std::make_shared<detail::segment_list>(1, my->open_segment(file, 1, blocks_per_chunk));
+    }
+    else if (!segment_files.empty())
+    {
+        my->open_segments(segment_files);
+    }
+    else if (blocks_per_segment)
+    {
+        my->blocks_per_segment = blocks_per_segment;
+    }
+    else
+    {
+        my->segments = std::make_shared<detail::segment_list>(1, my->open_segment(file, 1, blocks_per_chunk));
+    }
+
+    if (!my->segments->empty())
+        my->head = my->segments->back()->head;
+
+    my->opened = true;
+}
+
+void block_log::open_read_only(const fc::path& file)
+{
+    close();
+
+    my->file = file;
+    my->read_only = true;
+
+    const auto segment_files = detail::find_segment_files(file);
+    if (fc::exists(file))
+    {
+        FC_ASSERT(segment_files.empty(), "Block log ${f} exists in one file and in segments",
+                  ("f", file.generic_string()));
+        my->segments = std::make_shared<detail::segment_list>(1, my->open_segment(file, 1, 0));
+    }
+    else
+    {
+        FC_ASSERT(!segment_files.empty(), "There is no block log ${f}", ("f", file.generic_string()));
+        my->open_segments(segment_files);
     }
-    else if (index_size)
+
+    if (!my->segments->empty())
+        my->head = my->segments->back()->head;
+
+    my->opened = true;
+}
+
+std::vector<std::string> block_log::problems() const
+{
+    std::vector<std::string> result = my->problems;
+    for (const auto& file : *std::atomic_load(&my->segments))
     {
-        ilog("Index is nonempty, remove and recreate it");
-        my->index_stream.close();
-        fc::remove_all(my->index_file);
-        my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
-        my->index_write = true;
+        for (const auto& problem : file->problems)
+            result.push_back(file->block_file.generic_string() + ": " + problem);
     }
+    return result;
 }
 
 void block_log::close()
 {
-    my.reset(new detail::block_log_impl());
+    // the log is closed even if queued blocks can't be written, then the error is thrown
+    std::unique_ptr<detail::block_log_impl> closed(new detail::block_log_impl());
+    std::swap(my, closed);
+    closed->stop();
 }
 
 bool block_log::is_open() const
 {
-    return my->block_stream.is_open();
+    return my->opened;
+}
+
+uint32_t block_log::blocks_per_chunk() const
+{
+    auto list = std::atomic_load(&my->segments);
+    return list->empty() ? my->new_blocks_per_chunk : list->back()->blocks_per_chunk;
+}
+
+uint32_t block_log::blocks_per_segment() const
+{
+    return my->blocks_per_segment;
 }
 
 fc::path block_log::block_log_index_path(const fc::path& file)
@@ -189,47 +1260,102 @@ fc::path block_log::block_log_index_path(const fc::path& file)
     return fc::path(file.generic_string() + ".index");
 }
 
+fc::path block_log::block_log_tail_path(const fc::path& file)
+{
+    return fc::path(file.generic_string() + ".tail");
+}
+
+void block_log::wipe(const fc::path& file)
+{
+    detail::remove_file_set(file);
+    for (const auto& segment : detail::find_segment_files(file))
+        detail::remove_file_set(segment.path);
+}
+
 uint64_t block_log::append(const signed_block& b)
 {
     try
     {
-        my->check_block_write();
-        my->check_index_write();
+        FC_ASSERT(!my->read_only, "Block log is opened read only");
 
-        uint64_t pos = my->block_stream.tellp();
-        FC_ASSERT((uint64_t)my->index_stream.tellp()
-                      == (std::fstream::streampos)sizeof(uint64_t) * ((uint64_t)b.block_num() - 1),
-                  "Append to index file occuring at wrong position.",
-                  ("position", (uint64_t)my->index_stream.tellp())("expected",
-                                                                   ((uint64_t)b.block_num() - 1) * sizeof(uint64_t)));
-        auto data = fc::raw::pack(b);
-        my->block_stream.write(data.data(), data.size());
-        my->block_stream.write((char*)&pos, sizeof(pos));
-        my->index_stream.write((char*)&pos, sizeof(pos));
-        my->head = b;
-        my->head_id = b.id();
+        // blocks are appended in order
+        my->wait_written();
 
+        std::lock_guard<std::mutex> lock(my->append_mutex);
+        const uint64_t pos = my->append(b, fc::raw::pack(b));
+        my->head = b;
         return pos;
     }
     FC_LOG_AND_RETHROW()
 }
 
+void block_log::start_writer(size_t max_queue_size)
+{
+    FC_ASSERT(max_queue_size > 0 && !my->writer.joinable() && !my->read_only, "Block log writer can't be started");
+
+    my->max_queue_size = max_queue_size;
+    auto impl = my.get();
+    my->writer = std::thread([impl]() { impl->run_writer(); });
+}
+
+void block_log::append_async(const signed_block& b)
+{
+    try
+    {
+        if (!my->writer.joinable())
+        {
+            append(b);
+            return;
+        }
+
+        FC_ASSERT(!my->head || b.block_num() == my->head->block_num() + 1, "Block log append is out of order",
+                  ("block_num", b.block_num())("head_num", my->head->block_num()));
+
+        auto queued = std::make_shared<detail::block_log_impl::queued_block>();
+        queued->block = b;
+        queued->data = fc::raw::pack(b);
+        {
+            std::unique_lock<std::mutex> lock(my->queue_mutex);
+            my->written_cv.wait(lock, [&]() { return my->queue.size() < my->max_queue_size || my->writer_error; });
+
+            if (my->writer_error)
+                std::rethrow_exception(my->writer_error);
+
+            my->queue.push_back(queued);
+        }
+        my->queue_cv.notify_one();
+
+        my->head = b;
+    }
+    FC_LOG_AND_RETHROW()
+}
+
 void block_log::flush()
 {
-    my->block_stream.flush();
-    my->index_stream.flush();
+    my->wait_written();
+
+    auto list = std::atomic_load(&my->segments);
+    if (!list->empty())
+        list->back()->flush();
 }
 
 std::pair<signed_block, uint64_t> block_log::read_block(uint64_t pos) const
 {
     try
     {
-        my->check_block_read();
+        const uint32_t segment = my->segmented() ? pos >> detail::segment_pos_bits : 0;
+        auto file = my->find_segment(segment);
+        FC_ASSERT(file, "Block log segment ${n} is not available", ("n", segment));
+
+        auto result = file->read_block(my->segmented() ? pos & detail::segment_pos_mask : pos,
+                                       std::numeric_limits<size_t>::max());
+
+        // the last block of a segment is followed by the first one of the next segment
+        if (result.first.block_num() == my->last_block_num(segment))
+            result.second = my->encode_pos(segment + 1, 0);
+        else
+            result.second = my->encode_pos(segment, result.second);
 
-        my->block_stream.seekg(pos);
-        std::pair<signed_block, uint64_t> result;
-        fc::raw::unpack(my->block_stream, result.first);
-        result.second = uint64_t(my->block_stream.tellg()) + 8;
         return result;
     }
     FC_LOG_AND_RETHROW()
@@ -239,15 +1365,13 @@ optional<signed_block> block_log::read_block_by_num(uint32_t block_num) const
 {
     try
     {
-        optional<signed_block> b;
-        uint64_t pos = get_block_pos(block_num);
-        if (pos != npos)
-        {
-            b = read_block(pos).first;
-            FC_ASSERT(b->block_num() == block_num, "Wrong block was read from block log.",
-                      ("returned", b->block_num())("expected", block_num));
-        }
-        return b;
+        // queue is checked first, a block is removed from it after it's written to the files
+        auto queued = my->find_queued(block_num);
+        if (queued)
+            return queued;
+
+        auto file = my->find_segment(my->segment_number(block_num));
+        return file ? file->read_block_by_num(block_num) : optional<signed_block>();
     }
     FC_LOG_AND_RETHROW()
 }
@@ -256,14 +1380,13 @@ uint64_t block_log::get_block_pos(uint32_t block_num) const
 {
     try
     {
-        my->check_index_read();
-
-        if (!(my->head.valid() && block_num <= protocol::block_header::num_from_id(my->head_id) && block_num > 0))
+        const uint32_t segment = my->segment_number(block_num);
+        auto file = my->find_segment(segment);
+        if (!file)
             return npos;
-        my->index_stream.seekg(sizeof(uint64_t) * (block_num - 1));
-        uint64_t pos;
-        my->index_stream.read((char*)&pos, sizeof(pos));
-        return pos;
+
+        const uint64_t pos = file->get_block_pos(block_num);
+        return pos == npos ? npos : my->encode_pos(segment, pos);
     }
     FC_LOG_AND_RETHROW()
 }
@@ -272,12 +1395,10 @@ signed_block block_log::read_head() const
 {
     try
     {
-        my->check_block_read();
+        auto list = std::atomic_load(&my->segments);
+        FC_ASSERT(!list->empty(), "Block log is empty");
 
-        uint64_t pos;
-        my->block_stream.seekg(-sizeof(pos), std::ios::end);
-        my->block_stream.read((char*)&pos, sizeof(pos));
-        return read_block(pos).first;
+        return list->back()->read_head();
     }
     FC_LOG_AND_RETHROW()
 }
@@ -287,32 +1408,63 @@ const optional<signed_block>& block_log::head() const
     return my->head;
 }
 
-void block_log::construct_index()
+uint32_t block_log::written_block_num() const
+{
+    {
+        std::lock_guard<std::mutex> lock(my->queue_mutex);
+        if (!my->queue.empty())
+            return my->queue.front()->block.block_num() - 1;
+    }
+    return my->head ? my->head->block_num() : 0;
+}
+
+uint32_t block_log::first_block_num() const
+{
+    auto list = std::atomic_load(&my->segments);
+    return list->empty() || !list->front()->head_num ? 0 : list->front()->first_block_num;
+}
+
+uint32_t block_log::remove_segments(uint32_t block_num)
 {
     try
     {
-        ilog("Reconstructing Block Log Index...");
-        my->index_stream.close();
-        fc::remove_all(my->index_file);
-        my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
-        my->index_write = true;
+        FC_ASSERT(!my->read_only, "Block log is opened read only");
+
+        // the head segment is kept
+        auto segments_before = [&](const detail::segment_list& list) {
+            if (list.size() < 2)
+                return list.begin();
+            return std::find_if(list.begin(), list.end() - 1, [&](const auto& file) {
+                return my->last_block_num(my->segment_number(file->first_block_num)) >= block_num;
+            });
+        };
+
+        // the check doesn't wait for the writer
+        auto current_list = std::atomic_load(&my->segments);
+        if (segments_before(*current_list) == current_list->begin())
+            return 0;
 
-        uint64_t pos = 0;
-        uint64_t end_pos;
-        my->check_block_read();
+        std::lock_guard<std::mutex> lock(my->append_mutex);
 
-        my->block_stream.seekg(-sizeof(uint64_t), std::ios::end);
-        my->block_stream.read((char*)&end_pos, sizeof(end_pos));
-        signed_block tmp;
+        const auto& current = *my->segments;
+        auto end = segments_before(current);
 
-        my->block_stream.seekg(pos);
+        std::vector<fc::path> removed;
+        for (auto itr = current.begin(); itr != end; ++itr)
+            removed.push_back((*itr)->block_file);
 
-        while (pos < end_pos)
+        auto list = std::make_shared<detail::segment_list>(end, current.end());
+
+        std::atomic_store(&my->segments, std::shared_ptr<const detail::segment_list>(list));
+
+        // readers which took the segment keep its mappings, they stay valid after the files are removed
+        for (const auto& path : removed)
         {
-            fc::raw::unpack(my->block_stream, tmp);
-            my->block_stream.read((char*)&pos, sizeof(pos));
-            my->index_stream.write((char*)&pos, sizeof(pos));
+            ilog("Remove block log segment ${f}", ("f", path.generic_string()));
+            detail::remove_file_set(path);
         }
+
+        return removed.size();
     }
     FC_LOG_AND_RETHROW()
 }
@@ -4,6 +4,10 @@
 #include <functional>
 #include <openssl/md5.h>
 
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
 #include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/core/ignore_unused.hpp>
 
@@ -73,6 +77,8 @@
 #include <scorum/chain/database/block_tasks/process_bets_resolving.hpp>
 #include <scorum/chain/database/block_tasks/process_bets_auto_resolving.hpp>
 #include <scorum/chain/database/process_user_activity.hpp>
+#include <scorum/chain/database/signature_recovery.hpp>
+#include <scorum/chain/database/supply_tracker.hpp>
 
 #include <scorum/chain/evaluators/evaluator_registry.hpp>
 #include <scorum/chain/evaluators/proposal_create_evaluator.hpp>
@@ -101,6 +107,24 @@
 #include <scorum/chain/betting/betting_matcher.hpp>
 #include <scorum/chain/betting/betting_resolver.hpp>
 
+namespace scorum {
+namespace chain {
+namespace detail {
+/**
+ * Identifies the state stored in the snapshot
+ */
+struct snapshot_header
+{
+    chain_id_type chain_id;
+    uint32_t head_block_num = 0;
+    block_id_type head_block_id;
+};
+}
+}
+}
+
+FC_REFLECT(scorum::chain::detail::snapshot_header, (chain_id)(head_block_num)(head_block_id))
+
 namespace scorum {
 namespace chain {
 
@@ -165,6 +189,9 @@ database::database(uint32_t options)
     , db_accessor_factory(static_cast<dba::db_index&>(*this))
     , _my(new database_impl(*this))
     , _options(options)
+    , _recovered_keys_cache(new recovered_keys_cache(recovered_keys_cache::default_max_size))
+    , _signature_recovery(new signature_recovery_pool(0))
+    , _prevalidated_blocks(new prevalidated_blocks())
 {
 }
 
@@ -198,9 +225,21 @@ void database::open(const fc::path& data_dir,
                     uint64_t shared_file_size,
                     uint32_t chainbase_flags,
                     const genesis_state_type& genesis_state)
+{
+    open(data_dir, shared_mem_dir, shared_file_size, chainbase_flags, genesis_state,
+         [&]() { init_genesis(genesis_state); });
+}
+
+void database::open(const fc::path& data_dir,
+                    const fc::path& shared_mem_dir,
+                    uint64_t shared_file_size,
+                    uint32_t chainbase_flags,
+                    const genesis_state_type& genesis_state,
+                    const std::function<void()>& init_state)
 {
     try
     {
+        set_schema_version(shared_memory_schema_version);
         chainbase::database::open(shared_mem_dir, chainbase_flags, shared_file_size);
 
         // must be initialized before evaluators creation
@@ -209,31 +248,36 @@ void database::open(const fc::path& data_dir,
         initialize_indexes();
         initialize_evaluators();
 
+        _supply_tracker.reset(new supply_tracker(*this));
+
         set_initial_timestamp(genesis_state);
 
         if (chainbase_flags & chainbase::database::read_write)
         {
             if (!find<dynamic_global_property_object>())
-                with_write_lock([&]() { init_genesis(genesis_state); });
+                with_write_lock([&]() { init_state(); });
 
             if (!fc::exists(data_dir))
             {
                 fc::create_directories(data_dir);
             }
 
-            _block_log.open(block_log_path(data_dir));
+            _block_log.open(block_log_path(data_dir), 0, _block_log_segment_size);
+            if (_block_log_write_queue_size)
+                _block_log.start_writer(_block_log_write_queue_size);
 
             auto log_head = _block_log.head();
 
             // Rewind all undo state. This should return us to the state at the last irreversible block.
             with_write_lock([&]() {
-                for_each_index([&](chainbase::abstract_generic_index_i& item) { item.undo_all(); });
+                undo_all();
 
-                for_each_index([&](chainbase::abstract_generic_index_i& item) {
-                    FC_ASSERT(item.revision() == head_block_num(),
-                              "Chainbase revision does not match head block num. Reindex blockchain.",
-                              ("rev", item.revision())("head_block", head_block_num()));
-                });
+                FC_ASSERT(revision() == head_block_num(),
+                          "Chainbase revision does not match head block num. Reindex blockchain.",
+                          ("rev", revision())("head_block", head_block_num()));
+
+                // state could be restored from a snapshot bypassing the tracker
+                _supply_tracker->reset();
 
                 validate_invariants();
             });
@@ -290,14 +334,256 @@ void database::reindex(const fc::path& data_dir,
 
         auto start = fc::time_point::now();
         SCORUM_ASSERT(_block_log.head(), block_log_exception, "No blocks in block log. Cannot reindex an empty chain.");
+        SCORUM_ASSERT(_block_log.first_block_num() == 1, block_log_exception,
+                      "Old blocks are removed from block log. Cannot reindex the chain.",
+                      ("first_block_num", _block_log.first_block_num()));
 
-        auto last_block_num = _block_log.head()->block_num();
-        uint log_interval_sz = std::max(last_block_num / 100u, 1000u);
+        replay_blocks(1, skip_flags);
 
-        ilog("Replaying ${n} blocks...", ("n", last_block_num));
+        auto end = fc::time_point::now();
+        ilog("Done reindexing, elapsed time: ${t} sec", ("t", double((end - start).count()) / 1000000.0));
+    }
+    FC_CAPTURE_AND_RETHROW((data_dir)(shared_mem_dir)(shared_file_size)(skip_flags)(genesis_state))
+}
+
+void database::import_snapshot(const fc::path& data_dir,
+                               const fc::path& shared_mem_dir,
+                               uint64_t shared_file_size,
+                               uint32_t skip_flags,
+                               const genesis_state_type& genesis_state,
+                               const fc::path& snapshot_file)
+{
+    try
+    {
+        ilog("Importing state snapshot ${f}", ("f", snapshot_file));
+
+        auto start = fc::time_point::now();
+
+        const uint32_t snapshot_block_num
+            = load_snapshot(data_dir, shared_mem_dir, shared_file_size, genesis_state, snapshot_file);
+
+        replay_snapshot_tail(snapshot_block_num, skip_flags);
+
+        auto end = fc::time_point::now();
+        ilog("Done importing snapshot, elapsed time: ${t} sec", ("t", double((end - start).count()) / 1000000.0));
+    }
+    FC_CAPTURE_AND_RETHROW((data_dir)(shared_mem_dir)(shared_file_size)(skip_flags)(snapshot_file))
+}
+
+uint32_t database::load_snapshot(const fc::path& data_dir,
+                                 const fc::path& shared_mem_dir,
+                                 uint64_t shared_file_size,
+                                 const genesis_state_type& genesis_state,
+                                 const fc::path& snapshot_file)
+{
+    auto start = fc::time_point::now();
+
+    wipe(data_dir, shared_mem_dir, false);
+
+    detail::snapshot_header header;
+    open(data_dir, shared_mem_dir, shared_file_size, chainbase::database::read_write, genesis_state, [&]() {
+        auto user_data = read_snapshot(snapshot_file);
+        header = fc::raw::unpack<detail::snapshot_header>(user_data);
+
+        FC_ASSERT(header.chain_id == genesis_state.initial_chain_id, "Snapshot is made for another chain.",
+                  ("snapshot_chain_id", header.chain_id)("chain_id", genesis_state.initial_chain_id));
+        FC_ASSERT(header.head_block_num == head_block_num() && header.head_block_id == head_block_id(),
+                  "Snapshot header does not match its state.");
+
+        set_revision(head_block_num());
+    });
+    _fork_db.reset(); // override effect of _fork_db.start_block() call in open()
+
+    ilog("Snapshot is loaded at block ${n}, elapsed time: ${t} sec",
+         ("n", header.head_block_num)("t", double((fc::time_point::now() - start).count()) / 1000000.0));
+
+    return header.head_block_num;
+}
+
+void database::replay_snapshot_tail(uint32_t snapshot_block_num, uint32_t skip_flags)
+{
+    SCORUM_ASSERT(_block_log.head(), block_log_exception, "No blocks in block log. Cannot replay snapshot tail.");
+    SCORUM_ASSERT(_block_log.first_block_num() <= snapshot_block_num + 1, block_log_exception,
+                  "Blocks following the snapshot are removed from block log. Cannot replay snapshot tail.",
+                  ("first_block_num", _block_log.first_block_num())("snapshot_block_num", snapshot_block_num));
+
+    replay_blocks(snapshot_block_num + 1, skip_flags);
+}
+
+void database::export_snapshot(const fc::path& snapshot_file)
+{
+    try
+    {
+        ilog("Exporting state snapshot at block ${n}", ("n", head_block_num()));
+
+        auto start = fc::time_point::now();
+
+        with_read_lock([&]() {
+            FC_ASSERT(revision() == head_block_num(), "State has reversible blocks, snapshot can't be made.");
+
+            detail::snapshot_header header;
+            header.chain_id = get_chain_id();
+            header.head_block_num = head_block_num();
+            header.head_block_id = head_block_id();
+
+            write_snapshot(snapshot_file, fc::raw::pack(header));
+        });
+
+        auto end = fc::time_point::now();
+        ilog("Done exporting snapshot, elapsed time: ${t} sec", ("t", double((end - start).count()) / 1000000.0));
+    }
+    FC_CAPTURE_AND_RETHROW((snapshot_file))
+}
+
+namespace {
+// points the database to the prepared block data and its block while the block is pushed or applied
+template <typename T> struct pointer_scope
+{
+    pointer_scope(const T*& current, const T* value)
+        : _current(current)
+        , _prev(current)
+    {
+        _current = value;
+    }
+
+    ~pointer_scope()
+    {
+        _current = _prev;
+    }
+
+    const T*& _current;
+    const T* _prev;
+};
+
+// transactions are not serialized again if their sizes are known
+size_t prepared_block_size(const signed_block& block, const prepared_block& prepared)
+{
+    size_t size = fc::raw::pack_size(static_cast<const signed_block_header&>(block))
+        + fc::raw::pack_size(fc::unsigned_int(block.transactions.size()));
+
+    for (const auto& digests : prepared.digests)
+    {
+        if (!digests)
+            return fc::raw::pack_size(block);
+        size += digests->packed_size;
+    }
+
+    return size;
+}
+
+bool need_signee(uint32_t skip)
+{
+    return !(skip & database::skip_witness_signature);
+}
+
+bool need_transaction_keys(uint32_t skip)
+{
+    return !(skip & (database::skip_transaction_signatures | database::skip_authority_check));
+}
+
+// disk space taken by the file, untouched pages of the sparse shared memory file are not counted
+uint64_t allocated_file_size(const fc::path& file)
+{
+#ifdef __linux__
+    struct stat st;
+    if (::stat(file.generic_string().c_str(), &st) == 0)
+        return uint64_t(st.st_blocks) * 512;
+#endif
+    return fc::file_size(file);
+}
+}
+
+void database::compact_shared_file(const fc::path& data_dir,
+                                   const fc::path& shared_mem_dir,
+                                   uint64_t shared_file_size,
+                                   uint32_t skip_flags,
+                                   const genesis_state_type& genesis_state)
+{
+    try
+    {
+        ilog("Compacting shared memory file");
+
+        // new file is built aside, the original one is replaced only when the new one is verified
+        const fc::path shared_file = chainbase::database::shared_memory_path(shared_mem_dir);
+        const fc::path compaction_dir = shared_mem_dir / "compaction";
+        const fc::path snapshot_file = compaction_dir / "state.snapshot";
+
+        fc::remove_all(compaction_dir);
+        fc::create_directories(compaction_dir);
+
+        std::map<uint16_t, uint64_t> counts;
+        uint64_t used_before = 0;
+        with_read_lock([&]() {
+            for (const auto& index : get_index_statistic())
+                counts[index.type_id] = index.count;
+            used_before = get_size() - get_free_memory();
+        });
+        const uint64_t disk_before = allocated_file_size(shared_file);
+
+        export_snapshot(snapshot_file);
+
+        uint64_t used_after = 0;
+        try
+        {
+            // counts are compared before the block log tail is replayed, the log can be ahead of the state
+            load_snapshot(data_dir, compaction_dir, shared_file_size, genesis_state, snapshot_file);
+
+            with_read_lock([&]() {
+                for (const auto& index : get_index_statistic())
+                {
+                    FC_ASSERT(counts[index.type_id] == index.count, "Index ${i} has ${n} objects instead of ${e}.",
+                              ("i", index.name)("n", index.count)("e", counts[index.type_id]));
+                }
+                used_after = get_size() - get_free_memory();
+
+                validate_invariants();
+            });
+
+            close();
+        }
+        catch (...)
+        {
+            close();
+            elog("Compaction failed, shared memory file ${f} is not changed, state snapshot is kept in ${s}",
+                 ("f", shared_file)("s", snapshot_file));
+            throw;
+        }
+
+        fc::rename(chainbase::database::shared_memory_path(compaction_dir), shared_file);
+        fc::remove_all(compaction_dir);
+
+        open(data_dir, shared_mem_dir, shared_file_size, chainbase::database::read_write, genesis_state);
+
+        // blocks which were queued for the block log when the state was saved
+        if (_block_log.head() && _block_log.head()->block_num() > head_block_num())
+        {
+            _fork_db.reset(); // override effect of _fork_db.start_block() call in open()
+            replay_snapshot_tail(head_block_num(), skip_flags);
+        }
+
+        const uint64_t disk_after = allocated_file_size(shared_file);
+
+        ilog("Done compacting: used memory ${ub}M -> ${ua}M, disk usage ${db}M -> ${da}M",
+             ("ub", used_before / (1024 * 1024))("ua", used_after / (1024 * 1024))("db", disk_before / (1024 * 1024))(
+                 "da", disk_after / (1024 * 1024)));
+    }
+    FC_CAPTURE_AND_RETHROW((data_dir)(shared_mem_dir)(shared_file_size))
+}
+
+/**
+ * Applies blocks from the block log starting with from_block_num up to the block log head
+ */
+void database::replay_blocks(uint32_t from_block_num, uint32_t skip_flags)
+{
+    auto last_block_num = _block_log.head()->block_num();
+    uint log_interval_sz = std::max(last_block_num / 100u, 1000u);
+
+    if (from_block_num <= last_block_num)
+    {
+        ilog("Replaying ${n} blocks...", ("n", last_block_num - from_block_num + 1));
 
         with_write_lock([&]() {
-            auto itr = _block_log.read_block(0);
+            auto itr = _block_log.read_block(_block_log.get_block_pos(from_block_num));
             while (itr.first.block_num() <= last_block_num)
             {
                 auto cur_block_num = itr.first.block_num();
@@ -314,18 +600,14 @@ void database::reindex(const fc::path& data_dir,
                     break;
             }
 
-            for_each_index([&](chainbase::abstract_generic_index_i& item) { item.set_revision(head_block_num()); });
+            set_revision(head_block_num());
         });
+    }
 
-        if (_block_log.head()->block_num())
-        {
-            _fork_db.start_block(*_block_log.head());
-        }
-
-        auto end = fc::time_point::now();
-        ilog("Done reindexing, elapsed time: ${t} sec", ("t", double((end - start).count()) / 1000000.0));
+    if (_block_log.head()->block_num())
+    {
+        _fork_db.start_block(*_block_log.head());
     }
-    FC_CAPTURE_AND_RETHROW((data_dir)(shared_mem_dir)(shared_file_size)(skip_flags)(genesis_state))
 }
 
 void database::wipe(const fc::path& data_dir, const fc::path& shared_mem_dir, bool include_blocks)
@@ -334,9 +616,7 @@ void database::wipe(const fc::path& data_dir, const fc::path& shared_mem_dir, bo
     chainbase::database::wipe(shared_mem_dir);
     if (include_blocks)
     {
-        fc::path block_log_file = block_log_path(data_dir);
-        fc::remove_all(block_log_file);
-        fc::remove_all(block_log::block_log_index_path(block_log_file));
+        block_log::wipe(block_log_path(data_dir));
     }
 }
 
@@ -357,6 +637,8 @@ void database::close()
         {
         }
 
+        _supply_tracker.reset();
+
         chainbase::database::close();
 
         _block_log.close();
@@ -571,9 +853,25 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
 
     debug_log(ctx, "push_block skip=${s}", ("s", skip));
 
+    // digests and signature keys are computed before the write lock is taken, apply only checks them,
+    // without worker threads they are computed on apply
+    fc::optional<prepared_block> prepared;
+    if (_signature_recovery->threads_count())
+        prepared = _prevalidated_blocks->take(new_block);
+    if (!prepared && _signature_recovery->threads_count())
+    {
+        chain_id_type chain_id;
+        with_read_lock([&]() { chain_id = get_chain_id(); });
+        prepared = _signature_recovery->prepare(new_block, chain_id, *_recovered_keys_cache, need_signee(skip),
+                                                need_transaction_keys(skip));
+    }
+
     bool result;
     detail::with_skip_flags(*this, skip, [&]() {
         with_write_lock([&]() {
+            pointer_scope<prepared_block> prepared_scope(_prepared_block, prepared ? &(*prepared) : nullptr);
+            pointer_scope<signed_block> pushed_scope(_pushed_block, &new_block);
+
             detail::without_pending_transactions(*this, std::move(_pending_tx), [&]() {
                 try
                 {
@@ -592,6 +890,22 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
     return result;
 }
 
+void database::prevalidate_block(const signed_block& new_block, uint32_t skip)
+{
+    // without worker threads the block would be prepared by the calling thread, push_block does it anyway
+    if (!_signature_recovery->threads_count())
+        return;
+
+    chain_id_type chain_id;
+    with_read_lock([&]() { chain_id = get_chain_id(); });
+
+    auto block = std::make_shared<const signed_block>(new_block);
+    _prevalidated_blocks->add(block, [&]() {
+        return _signature_recovery->prepare_async(block, chain_id, *_recovered_keys_cache, need_signee(skip),
+                                                  need_transaction_keys(skip));
+    });
+}
+
 void database::_maybe_warn_multiple_production(uint32_t height) const
 {
     auto blocks = _fork_db.fetch_block_by_number(height);
@@ -783,7 +1097,7 @@ void database::_push_transaction(const signed_transaction& trx)
     _pending_tx.push_back(trx);
 
     // The transaction applied successfully. Merge its changes into the pending block session.
-    for_each_index([&](chainbase::abstract_generic_index_i& item) { item.squash(); });
+    squash();
     temp_session->push();
 
     // notify anyone listening to pending transactions
@@ -884,7 +1198,7 @@ signed_block database::_generate_block(fc::time_point_sec when,
             {
                 auto temp_session = start_undo_session();
                 _apply_transaction(tx);
-                for_each_index([&](chainbase::abstract_generic_index_i& item) { item.squash(); });
+                squash();
                 temp_session->push();
 
                 total_block_size += fc::raw::pack_size(tx);
@@ -989,7 +1303,7 @@ void database::pop_block()
 
         _fork_db.pop_block();
 
-        for_each_index([&](chainbase::abstract_generic_index_i& item) { item.undo(); });
+        undo();
 
         _popped_tx.insert(_popped_tx.begin(), head_block->transactions.begin(), head_block->transactions.end());
 
@@ -1389,6 +1703,42 @@ void database::set_flush_interval(uint32_t flush_blocks)
     _next_flush_block = 0;
 }
 
+void database::set_full_invariants_check_interval(uint32_t blocks)
+{
+    _full_invariants_check_blocks = blocks;
+}
+
+void database::set_signature_recovery_threads(size_t threads)
+{
+    _prevalidated_blocks->clear();
+    _signature_recovery.reset(new signature_recovery_pool(threads));
+}
+
+void database::set_signature_cache_size(size_t size)
+{
+    _recovered_keys_cache->set_max_size(size);
+}
+
+void database::set_shared_file_grow_step(uint64_t grow_step)
+{
+    _shared_file_grow_step = grow_step;
+}
+
+void database::set_block_log_segment_size(uint32_t blocks)
+{
+    _block_log_segment_size = blocks;
+}
+
+void database::set_block_log_keep_blocks(uint32_t blocks)
+{
+    _block_log_keep_blocks = blocks;
+}
+
+void database::set_block_log_write_queue_size(uint32_t blocks)
+{
+    _block_log_write_queue_size = blocks;
+}
+
 //////////////////// private methods ////////////////////
 
 void database::apply_block(const signed_block& next_block, uint32_t skip)
@@ -1424,7 +1774,10 @@ void database::apply_block(const signed_block& next_block, uint32_t skip)
         {
             try
             {
-                validate_invariants();
+                if (_full_invariants_check_blocks != 0 && block_num % _full_invariants_check_blocks == 0)
+                    validate_invariants();
+                else
+                    validate_tracked_invariants();
             }
 #ifdef DEBUG
             FC_CAPTURE_AND_RETHROW(((std::string)ctx));
@@ -1435,33 +1788,6 @@ void database::apply_block(const signed_block& next_block, uint32_t skip)
 
         // fc::time_point end_time = fc::time_point::now();
         // fc::microseconds dt = end_time - begin_time;
-        if (_flush_blocks != 0)
-        {
-            if (_next_flush_block == 0)
-            {
-                uint32_t lep = block_num + 1 + _flush_blocks * 9 / 10;
-                uint32_t rep = block_num + 1 + _flush_blocks;
-
-                // use time_point::now() as RNG source to pick block randomly between lep and rep
-                uint32_t span = rep - lep;
-                uint32_t x = lep;
-                if (span > 0)
-                {
-                    uint64_t now = uint64_t(fc::time_point::now().time_since_epoch().count());
-                    x += now % span;
-                }
-                _next_flush_block = x;
-                // ilog( "Next flush scheduled at block ${b}", ("b", x) );
-            }
-
-            if (_next_flush_block == block_num)
-            {
-                _next_flush_block = 0;
-                // ilog( "Flushing database shared memory at block ${b}", ("b", block_num) );
-                chainbase::database::flush();
-            }
-        }
-
         show_free_memory(false);
 
         debug_log(ctx, "apply_block result");
@@ -1482,7 +1808,12 @@ void database::show_free_memory(bool force)
     {
         uint32_t free_mb = uint32_t(get_free_memory() / (1024 * 1024));
 
-        if (free_mb <= SCORUM_DB_FREE_MEMORY_THRESHOLD_MB && head_block_num() % 10 == 0)
+        if (free_mb <= SCORUM_DB_FREE_MEMORY_THRESHOLD_MB && _shared_file_grow_step
+            && grow_segment(_shared_file_grow_step))
+        {
+            ilog("Free memory was ${n}M. Shared file is grown to ${s} bytes", ("n", free_mb)("s", get_size()));
+        }
+        else if (free_mb <= SCORUM_DB_FREE_MEMORY_THRESHOLD_MB && head_block_num() % 10 == 0)
         {
             elog("Free memory is now ${n}M. Increase shared file size immediately!", ("n", free_mb));
         }
@@ -1504,9 +1835,23 @@ void database::_apply_block(const signed_block& next_block)
 
         uint32_t skip = get_node_properties().skip_flags;
 
+        // data is prepared for the pushed block only, blocks of a switched fork are prepared here,
+        // fork database keeps its own copy which may have other transactions under the same id.
+        // Without worker threads nothing is prepared, digests and keys are computed inline.
+        fc::optional<prepared_block> local_prepared;
+        const prepared_block* prepared = _pushed_block == &next_block ? _prepared_block : nullptr;
+        if (!prepared && _signature_recovery->threads_count())
+        {
+            local_prepared = _signature_recovery->prepare(next_block, get_chain_id(), *_recovered_keys_cache,
+                                                          need_signee(skip), need_transaction_keys(skip));
+            prepared = &(*local_prepared);
+        }
+        pointer_scope<prepared_block> prepared_scope(_current_prepared, prepared);
+
         if (!(skip & skip_merkle_check))
         {
-            auto merkle_root = next_block.calculate_merkle_root();
+            auto merkle_root = prepared && prepared->merkle_root ? *prepared->merkle_root
+                                                                 : next_block.calculate_merkle_root();
 
             try
             {
@@ -1536,7 +1881,7 @@ void database::_apply_block(const signed_block& next_block)
         _current_trx_in_block = 0;
 
         const auto& gprops = obtain_service<dbs_dynamic_global_property>().get();
-        auto block_size = fc::raw::pack_size(next_block);
+        auto block_size = prepared ? prepared_block_size(next_block, *prepared) : fc::raw::pack_size(next_block);
         FC_ASSERT(block_size <= gprops.median_chain_props.maximum_block_size, "Block Size is too Big",
                   ("next_block_num", next_block_num)("block_size",
                                                      block_size)("max", gprops.median_chain_props.maximum_block_size));
@@ -1689,7 +2034,9 @@ void database::_apply_transaction(const signed_transaction& trx)
 {
     try
     {
-        _current_trx_id = trx.id();
+        const auto* digests = current_trx_digests();
+
+        _current_trx_id = digests ? digests->id : trx.id();
         uint32_t skip = get_node_properties().skip_flags;
 
         if (!(skip & skip_validate)) /* issue #505 explains why this skip_flag is disabled */
@@ -1698,7 +2045,7 @@ void database::_apply_transaction(const signed_transaction& trx)
         }
 
         auto& trx_idx = get_index<transaction_index>();
-        auto trx_id = trx.id();
+        auto trx_id = _current_trx_id;
         // idump((trx_id)(skip&skip_transaction_dupe_check));
         FC_ASSERT((skip & skip_transaction_dupe_check)
                       || trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end(),
@@ -1718,7 +2065,19 @@ void database::_apply_transaction(const signed_transaction& trx)
 
             try
             {
-                trx.verify_authority(get_chain_id(), get_active, get_owner, get_posting, SCORUM_MAX_SIG_CHECK_DEPTH);
+                const auto* keys = _current_prepared && _current_trx_in_block < _current_prepared->keys.size()
+                    ? &_current_prepared->keys[_current_trx_in_block]
+                    : nullptr;
+
+                if (keys && keys->valid())
+                    protocol::verify_authority(trx.operations, **keys, get_active, get_owner, get_posting,
+                                               SCORUM_MAX_SIG_CHECK_DEPTH);
+                else
+                    protocol::verify_authority(
+                        trx.operations,
+                        _recovered_keys_cache->get_signature_keys(
+                            trx, digests ? digests->sig_digest : trx.sig_digest(get_chain_id())),
+                        get_active, get_owner, get_posting, SCORUM_MAX_SIG_CHECK_DEPTH);
             }
             catch (protocol::tx_missing_active_auth& e)
             {
@@ -1791,6 +2150,15 @@ void database::apply_operation(const operation& op)
     notify_post_apply_operation(note);
 }
 
+const signed_transaction_digests* database::current_trx_digests() const
+{
+    if (!_current_prepared || _current_trx_in_block >= _current_prepared->digests.size())
+        return nullptr;
+
+    const auto& digests = _current_prepared->digests[_current_trx_in_block];
+    return digests ? &(*digests) : nullptr;
+}
+
 const witness_object& database::validate_block_header(uint32_t skip, const signed_block& next_block) const
 {
     try
@@ -1805,7 +2173,10 @@ const witness_object& database::validate_block_header(uint32_t skip, const signe
 
         if (!(skip & skip_witness_signature))
         {
-            FC_ASSERT(next_block.validate_signee(witness.signing_key));
+            if (_current_prepared && _current_prepared->signee.valid())
+                FC_ASSERT(*_current_prepared->signee == witness.signing_key);
+            else
+                FC_ASSERT(next_block.validate_signee(witness.signing_key));
         }
 
         if (!(skip & skip_witness_schedule_check))
@@ -1977,8 +2348,7 @@ void database::update_last_irreversible_block()
             }
         }
 
-        for_each_index(
-            [&](chainbase::abstract_generic_index_i& item) { item.commit(dpo.last_irreversible_block_num); });
+        uint32_t committed_block_num = dpo.last_irreversible_block_num;
 
         if (!(get_node_properties().skip_flags & skip_block_log))
         {
@@ -1997,19 +2367,64 @@ void database::update_last_irreversible_block()
                 {
                     std::shared_ptr<fork_item> block = _fork_db.fetch_block_on_main_branch_by_number(log_head_num + 1);
                     FC_ASSERT(block, "Current fork in the fork database does not contain the last_irreversible_block");
-                    _block_log.append(block->data);
+                    _block_log.append_async(block->data);
                     log_head_num++;
                 }
 
-                _block_log.flush();
+                // the writer syncs blocks by itself, so the write lock isn't held for the disk
+                if (!_block_log_write_queue_size)
+                    _block_log.flush();
+
+                if (_block_log_keep_blocks && log_head_num > _block_log_keep_blocks)
+                    _block_log.remove_segments(log_head_num - _block_log_keep_blocks + 1);
             }
+
+            // undo states of queued blocks are kept until the blocks are written, so the state restored
+            // by undo_all on open is never ahead of the block log
+            committed_block_num = std::min(committed_block_num, _block_log.written_block_num());
         }
 
+        commit(committed_block_num);
+        on_irreversible_block(committed_block_num);
+
         _fork_db.set_max_size(dpo.head_block_number - dpo.last_irreversible_block_num + 1);
     }
     FC_CAPTURE_AND_RETHROW()
 }
 
+/**
+ * Shared memory file is flushed when the committed block passes the scheduled one, the undo states after it
+ * are in the file as well, so open restores the state of the committed block by undo_all.
+ */
+void database::on_irreversible_block(uint32_t block_num)
+{
+    if (_flush_blocks == 0 || block_num < _next_flush_block)
+        return;
+
+    if (_next_flush_block == 0)
+    {
+        uint32_t lep = block_num + 1 + _flush_blocks * 9 / 10;
+        uint32_t rep = block_num + 1 + _flush_blocks;
+
+        // use time_point::now() as RNG source to pick block randomly between lep and rep
+        uint32_t span = rep - lep;
+        uint32_t x = lep;
+        if (span > 0)
+        {
+            uint64_t now = uint64_t(fc::time_point::now().time_since_epoch().count());
+            x += now % span;
+        }
+        _next_flush_block = x;
+        // ilog( "Next flush scheduled at block ${b}", ("b", x) );
+        return;
+    }
+
+    _next_flush_block = 0;
+    // ilog( "Flushing database shared memory at block ${b}", ("b", block_num) );
+    // synchronous unless background flush is started
+    chainbase::database::request_flush();
+}
+
 void database::clear_expired_transactions()
 {
     // Look for expired transactions in the deduplication list, and remove them.
@@ -2020,6 +2435,8 @@ void database::clear_expired_transactions()
     {
         remove(*dedupe_index.begin());
     }
+
+    _recovered_keys_cache->remove_expired(head_block_time());
 }
 
 void database::clear_expired_delegations()
@@ -2156,138 +2573,134 @@ void database::validate_invariants() const
 {
     try
     {
-        asset total_supply = asset(0, SCORUM_SYMBOL);
-
-        const auto& account_svc = account_service();
-        const auto& gpo = obtain_service<dbs_dynamic_global_property>().get();
+        const auto totals = supply_tracker::calculate(*this);
 
-        const auto accounts_circulating = account_svc.accounts_circulating_capital();
+        check_supply_invariants(totals);
 
-        total_supply += accounts_circulating.scr;
-        // following two field do not represented in global properties
-        total_supply += accounts_circulating.pending_scr;
-        total_supply += asset(accounts_circulating.pending_sp.amount, SCORUM_SYMBOL);
-
-        /// verify no witness has too many votes
-        const auto& witness_idx = get_index<witness_index>().indices();
-        for (auto itr = witness_idx.begin(); itr != witness_idx.end(); ++itr)
-        {
-            FC_ASSERT(itr->votes <= gpo.total_scorumpower.amount, "${vs} > ${tvs}",
-                      ("vs", itr->votes)("tvs", gpo.total_scorumpower.amount));
-        }
-
-        const auto& escrow_idx = get_index<escrow_index>().indices().get<by_id>();
-        for (auto itr = escrow_idx.begin(); itr != escrow_idx.end(); ++itr)
-        {
-            total_supply += itr->scorum_balance;
-            total_supply += itr->pending_fee;
-        }
-
-        total_supply += obtain_service<dbs_content_reward_fund_scr>().get().activity_reward_balance;
-        total_supply
-            += asset(obtain_service<dbs_content_reward_fund_sp>().get().activity_reward_balance.amount, SCORUM_SYMBOL);
-
-        auto& fifa_2018_reward_service = obtain_service<dbs_content_fifa_world_cup_2018_bounty_reward_fund>();
-        if (fifa_2018_reward_service.is_exists())
+        if (_supply_tracker)
         {
-            total_supply += asset(fifa_2018_reward_service.get().activity_reward_balance.amount, SCORUM_SYMBOL);
+            const auto& tracked = _supply_tracker->totals();
+            // clang-format off
+            FC_ASSERT(tracked == totals, "Tracked supply does not match the database",
+                      ("tracked.accounts.scr", tracked.accounts.scr)
+                      ("accounts.scr", totals.accounts.scr)
+                      ("tracked.accounts.sp", tracked.accounts.sp)
+                      ("accounts.sp", totals.accounts.sp)
+                      ("tracked.accounts.vsf_votes", tracked.accounts.vsf_votes)
+                      ("accounts.vsf_votes", totals.accounts.vsf_votes)
+                      ("tracked.locked_scr", tracked.locked_scr)
+                      ("locked_scr", totals.locked_scr));
+            // clang-format on
         }
+    }
+    FC_CAPTURE_LOG_AND_RETHROW((head_block_num()));
+}
 
-        total_supply += asset(gpo.total_scorumpower.amount, SCORUM_SYMBOL);
-        total_supply += obtain_service<dbs_content_reward_scr>().get().balance;
-        total_supply += obtain_service<dbs_voters_reward_scr>().get().balance;
-        total_supply += obtain_service<dbs_voters_reward_sp>().get().balance.amount;
-
-        for (const post_budget_object& budget : obtain_service<dbs_post_budget>().get_budgets())
-        {
-            total_supply += budget.balance;
-            total_supply += budget.owner_pending_income;
-            total_supply += budget.budget_pending_outgo;
-        }
+void database::validate_tracked_invariants() const
+{
+    try
+    {
+        FC_ASSERT(_supply_tracker, "Supply is not tracked");
 
-        for (const banner_budget_object& budget : obtain_service<dbs_banner_budget>().get_budgets())
-        {
-            total_supply += budget.balance;
-            total_supply += budget.owner_pending_income;
-            total_supply += budget.budget_pending_outgo;
-        }
+        check_supply_invariants(_supply_tracker->totals());
+    }
+    FC_CAPTURE_LOG_AND_RETHROW((head_block_num()));
+}
 
-        if (obtain_service<dbs_fund_budget>().is_exists())
-        {
-            total_supply += obtain_service<dbs_fund_budget>().get().balance.amount;
-        }
+void database::check_supply_invariants(const supply_totals& totals) const
+{
+    asset total_supply = asset(0, SCORUM_SYMBOL);
 
-        if (obtain_service<dbs_registration_pool>().is_exists())
-        {
-            auto& pool = obtain_service<dbs_registration_pool>().get();
-            total_supply += pool.balance;
-            total_supply += asset(pool.delegated.amount, SCORUM_SYMBOL);
-        }
+    const auto& gpo = obtain_service<dbs_dynamic_global_property>().get();
 
-        total_supply += asset(obtain_service<dbs_dev_pool>().get().sp_balance.amount, SCORUM_SYMBOL);
-        total_supply += obtain_service<dbs_dev_pool>().get().scr_balance;
+    const auto& accounts_circulating = totals.accounts;
 
-        if (obtain_service<dbs_witness_reward_in_sp_migration>().is_exists())
-        {
-            total_supply += asset(obtain_service<dbs_witness_reward_in_sp_migration>().get().balance, SCORUM_SYMBOL);
-        }
+    total_supply += accounts_circulating.scr;
+    // following two field do not represented in global properties
+    total_supply += accounts_circulating.pending_scr;
+    total_supply += asset(accounts_circulating.pending_sp.amount, SCORUM_SYMBOL);
 
-        const auto& atomicswap_contract_idx = get_index<atomicswap_contract_index, by_id>();
-        for (auto itr = atomicswap_contract_idx.begin(); itr != atomicswap_contract_idx.end(); ++itr)
-        {
-            total_supply += itr->amount;
-        }
+    /// verify no witness has too many votes, witnesses are ordered by votes descending
+    const auto& witness_idx = get_index<witness_index, by_vote_name>();
+    if (!witness_idx.empty())
+    {
+        FC_ASSERT(witness_idx.begin()->votes <= gpo.total_scorumpower.amount, "${vs} > ${tvs}",
+                  ("vs", witness_idx.begin()->votes)("tvs", gpo.total_scorumpower.amount));
+    }
 
-        // clang-format off
-        const auto& matched_bets = get_index<matched_bet_index, by_id>();
-        for (auto itr = matched_bets.begin(); itr != matched_bets.end(); ++itr)
-        {
-            total_supply += itr->bet1_data.stake;
-            total_supply += itr->bet2_data.stake;
-        }
+    // escrows, advertising budgets, atomic swaps and bets
+    total_supply += totals.locked_scr;
 
-        const auto& pending_bets = get_index<pending_bet_index, by_id>();
-        for (auto itr = pending_bets.begin(); itr != pending_bets.end(); ++itr)
-        {
-            total_supply += itr->data.stake;
-        }
+    total_supply += obtain_service<dbs_content_reward_fund_scr>().get().activity_reward_balance;
+    total_supply
+        += asset(obtain_service<dbs_content_reward_fund_sp>().get().activity_reward_balance.amount, SCORUM_SYMBOL);
 
-        FC_ASSERT(total_supply <= asset::maximum(SCORUM_SYMBOL), "Assets SCR overflow");
-        FC_ASSERT(accounts_circulating.sp <= asset::maximum(SP_SYMBOL), "Assets SP overflow");
+    auto& fifa_2018_reward_service = obtain_service<dbs_content_fifa_world_cup_2018_bounty_reward_fund>();
+    if (fifa_2018_reward_service.is_exists())
+    {
+        total_supply += asset(fifa_2018_reward_service.get().activity_reward_balance.amount, SCORUM_SYMBOL);
+    }
 
-        FC_ASSERT(gpo.total_supply == total_supply, "",
-                  ("gpo.total_supply", gpo.total_supply)
-                  ("total_supply", total_supply));
+    total_supply += asset(gpo.total_scorumpower.amount, SCORUM_SYMBOL);
+    total_supply += obtain_service<dbs_content_reward_scr>().get().balance;
+    total_supply += obtain_service<dbs_voters_reward_scr>().get().balance;
+    total_supply += obtain_service<dbs_voters_reward_sp>().get().balance.amount;
 
-        FC_ASSERT(gpo.total_scorumpower == accounts_circulating.sp, "",
-                  ("gpo.total_supply", gpo.total_supply)
-                  ("gpo.total_scorumpower", gpo.total_scorumpower)
-                  ("gpo.circulating_capital", gpo.circulating_capital)
-                  ("accounts_circulating.sp", accounts_circulating.sp)
-                  ("accounts_circulating.scr", accounts_circulating.scr));
+    if (obtain_service<dbs_fund_budget>().is_exists())
+    {
+        total_supply += obtain_service<dbs_fund_budget>().get().balance.amount;
+    }
 
-        FC_ASSERT(gpo.circulating_capital.amount - gpo.total_scorumpower.amount == accounts_circulating.scr.amount, "",
-                  ("gpo.total_supply", gpo.total_supply)
-                  ("gpo.total_scorumpower", gpo.total_scorumpower)
-                  ("gpo.circulating_capital", gpo.circulating_capital)
-                  ("accounts_circulating.sp", accounts_circulating.sp)
-                  ("accounts_circulating.scr", accounts_circulating.scr));
+    if (obtain_service<dbs_registration_pool>().is_exists())
+    {
+        auto& pool = obtain_service<dbs_registration_pool>().get();
+        total_supply += pool.balance;
+        total_supply += asset(pool.delegated.amount, SCORUM_SYMBOL);
+    }
 
-        FC_ASSERT(gpo.total_scorumpower.amount == accounts_circulating.vsf_votes, "",
-                  ("total_scorumpower", gpo.total_scorumpower)
-                  ("accounts_circulating.total_vsf_votes", accounts_circulating.vsf_votes));
+    total_supply += asset(obtain_service<dbs_dev_pool>().get().sp_balance.amount, SCORUM_SYMBOL);
+    total_supply += obtain_service<dbs_dev_pool>().get().scr_balance;
 
-        FC_ASSERT(gpo.total_pending_scr == accounts_circulating.pending_scr, "",
-                  ("total_pending_scr", gpo.total_pending_scr)
-                  ("accounts_circulating.pending_scr", accounts_circulating.pending_scr));
+    if (obtain_service<dbs_witness_reward_in_sp_migration>().is_exists())
+    {
+        total_supply += asset(obtain_service<dbs_witness_reward_in_sp_migration>().get().balance, SCORUM_SYMBOL);
+    }
 
-        FC_ASSERT(gpo.total_pending_sp == accounts_circulating.pending_sp, "",
-                  ("total_pending_sp", gpo.total_pending_sp)
-                  ("accounts_circulating.pending_sp", accounts_circulating.pending_sp));
+    // clang-format off
+    FC_ASSERT(total_supply <= asset::maximum(SCORUM_SYMBOL), "Assets SCR overflow");
+    FC_ASSERT(accounts_circulating.sp <= asset::maximum(SP_SYMBOL), "Assets SP overflow");
+
+    FC_ASSERT(gpo.total_supply == total_supply, "",
+              ("gpo.total_supply", gpo.total_supply)
+              ("total_supply", total_supply));
+
+    FC_ASSERT(gpo.total_scorumpower == accounts_circulating.sp, "",
+              ("gpo.total_supply", gpo.total_supply)
+              ("gpo.total_scorumpower", gpo.total_scorumpower)
+              ("gpo.circulating_capital", gpo.circulating_capital)
+              ("accounts_circulating.sp", accounts_circulating.sp)
+              ("accounts_circulating.scr", accounts_circulating.scr));
+
+    FC_ASSERT(gpo.circulating_capital.amount - gpo.total_scorumpower.amount == accounts_circulating.scr.amount, "",
+              ("gpo.total_supply", gpo.total_supply)
+              ("gpo.total_scorumpower", gpo.total_scorumpower)
+              ("gpo.circulating_capital", gpo.circulating_capital)
+              ("accounts_circulating.sp", accounts_circulating.sp)
+              ("accounts_circulating.scr", accounts_circulating.scr));
+
+    FC_ASSERT(gpo.total_scorumpower.amount == accounts_circulating.vsf_votes, "",
+              ("total_scorumpower", gpo.total_scorumpower)
+              ("accounts_circulating.total_vsf_votes", accounts_circulating.vsf_votes));
+
+    FC_ASSERT(gpo.total_pending_scr == accounts_circulating.pending_scr, "",
+              ("total_pending_scr", gpo.total_pending_scr)
+              ("accounts_circulating.pending_scr", accounts_circulating.pending_scr));
+
+    FC_ASSERT(gpo.total_pending_sp == accounts_circulating.pending_sp, "",
+              ("total_pending_sp", gpo.total_pending_sp)
+              ("accounts_circulating.pending_sp", accounts_circulating.pending_sp));
 
-        // clang-format on
-    }
-    FC_CAPTURE_LOG_AND_RETHROW((head_block_num()));
+    // clang-format on
 }
 
 } // namespace chain
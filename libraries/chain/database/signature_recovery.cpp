@@ -0,0 +1,351 @@
+#include <scorum/chain/database/signature_recovery.hpp>
+
+#include <scorum/protocol/exceptions.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace scorum {
+namespace chain {
+
+recovered_keys_cache::recovered_keys_cache(size_t max_size)
+    : _max_size(max_size)
+{
+}
+
+fc::flat_set<public_key_type> recovered_keys_cache::get_signature_keys(const signed_transaction& trx,
+                                                                       const chain_id_type& chain_id)
+{
+    return get_signature_keys(trx, trx.sig_digest(chain_id));
+}
+
+fc::flat_set<public_key_type> recovered_keys_cache::get_signature_keys(const signed_transaction& trx,
+                                                                       const digest_type& digest)
+{
+    try
+    {
+        fc::flat_set<public_key_type> result;
+        std::vector<entry> recovered;
+
+        for (const auto& sig : trx.signatures)
+        {
+            fc::optional<public_key_type> key;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                const auto& idx = _entries.get<by_signature>();
+                auto itr = idx.find(boost::make_tuple(digest, sig));
+                if (itr != idx.end())
+                    key = itr->key;
+            }
+
+            if (!key)
+            {
+                key = public_key_type(fc::ecc::public_key(sig, digest));
+                recovered.push_back(entry{ digest, sig, *key, trx.expiration });
+            }
+
+            SCORUM_ASSERT(result.insert(*key).second, protocol::tx_duplicate_sig, "Duplicate Signature detected");
+        }
+
+        if (!recovered.empty())
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_max_size)
+            {
+                shrink(_max_size - std::min(_max_size, recovered.size()));
+                for (auto& e : recovered)
+                    _entries.insert(std::move(e));
+            }
+        }
+
+        return result;
+    }
+    FC_CAPTURE_AND_RETHROW()
+}
+
+void recovered_keys_cache::remove_expired(fc::time_point_sec now)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto& idx = _entries.get<by_expiration>();
+    idx.erase(idx.begin(), idx.lower_bound(now));
+}
+
+void recovered_keys_cache::set_max_size(size_t max_size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _max_size = max_size;
+    shrink(max_size);
+}
+
+size_t recovered_keys_cache::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+// callers hold the mutex, entries which expire first are dropped
+void recovered_keys_cache::shrink(size_t max_size)
+{
+    auto& idx = _entries.get<by_expiration>();
+    while (idx.size() > max_size)
+        idx.erase(idx.begin());
+}
+
+signature_recovery_pool::signature_recovery_pool(size_t threads_count)
+{
+    for (size_t i = 0; i < threads_count; ++i)
+        _threads.emplace_back([this]() { run(); });
+}
+
+signature_recovery_pool::~signature_recovery_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_all();
+
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+prepared_block signature_recovery_pool::prepare(const signed_block& block,
+                                                const chain_id_type& chain_id,
+                                                recovered_keys_cache& cache,
+                                                bool recover_signee,
+                                                bool recover_tx_keys)
+{
+    return prepare(block, chain_id, cache, recover_signee, recover_tx_keys, _threads.size());
+}
+
+std::shared_future<prepared_block> signature_recovery_pool::prepare_async(std::shared_ptr<const signed_block> block,
+                                                                          const chain_id_type& chain_id,
+                                                                          recovered_keys_cache& cache,
+                                                                          bool recover_signee,
+                                                                          bool recover_tx_keys)
+{
+    auto promise = std::make_shared<std::promise<prepared_block>>();
+    std::shared_future<prepared_block> result = promise->get_future().share();
+
+    if (_threads.empty())
+    {
+        promise->set_value(prepare(*block, chain_id, cache, recover_signee, recover_tx_keys, 0));
+        return result;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // blocks are prepared in parallel with each other, so a block takes one worker
+        _tasks.emplace_back([this, promise, block, chain_id, &cache, recover_signee, recover_tx_keys]() {
+            try
+            {
+                promise->set_value(prepare(*block, chain_id, cache, recover_signee, recover_tx_keys, 0));
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        });
+    }
+    _cv.notify_one();
+
+    return result;
+}
+
+size_t signature_recovery_pool::threads_count() const
+{
+    return _threads.size();
+}
+
+prepared_block signature_recovery_pool::prepare(const signed_block& block,
+                                                const chain_id_type& chain_id,
+                                                recovered_keys_cache& cache,
+                                                bool recover_signee,
+                                                bool recover_tx_keys,
+                                                size_t helpers_count)
+{
+    prepared_block result;
+    result.block_id = block.id();
+    result.digests.resize(block.transactions.size());
+    result.keys.resize(block.transactions.size());
+
+    // 0 is the witness signature, transactions follow it
+    struct job
+    {
+        std::atomic<size_t> next{ 0 };
+        size_t count = 0;
+        std::function<void()> work;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t active = 0;
+    };
+
+    auto shared_job = std::make_shared<job>();
+    shared_job->count = block.transactions.size() + 1;
+    // work runs only while the block is prepared, so it captures the locals by reference
+    shared_job->work = [&]() {
+        for (size_t i = shared_job->next++; i < shared_job->count; i = shared_job->next++)
+        {
+            try
+            {
+                if (i == 0)
+                {
+                    if (recover_signee)
+                        result.signee = public_key_type(block.signee());
+                    continue;
+                }
+
+                const auto& trx = block.transactions[i - 1];
+                result.digests[i - 1] = signed_transaction_digests(trx, chain_id);
+                if (recover_tx_keys)
+                    result.keys[i - 1] = cache.get_signature_keys(trx, result.digests[i - 1]->sig_digest);
+            }
+            catch (...)
+            {
+            }
+        }
+    };
+
+    const size_t helpers = std::min(helpers_count, shared_job->count - 1);
+    if (helpers)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < helpers; ++i)
+        {
+            // helper which is taken after the work is done returns at once, so the block isn't waiting
+            // for the workers busy with prepare_async
+            _tasks.emplace_back([shared_job]() {
+                {
+                    std::lock_guard<std::mutex> job_lock(shared_job->mutex);
+                    if (shared_job->next >= shared_job->count)
+                        return;
+                    ++shared_job->active;
+                }
+
+                shared_job->work();
+
+                std::lock_guard<std::mutex> job_lock(shared_job->mutex);
+                if (--shared_job->active == 0)
+                    shared_job->cv.notify_one();
+            });
+        }
+    }
+    _cv.notify_all();
+
+    shared_job->work();
+
+    std::unique_lock<std::mutex> job_lock(shared_job->mutex);
+    shared_job->cv.wait(job_lock, [&]() { return shared_job->active == 0; });
+
+    if (std::all_of(result.digests.begin(), result.digests.end(),
+                    [](const fc::optional<signed_transaction_digests>& digests) { return digests.valid(); }))
+    {
+        std::vector<digest_type> merkle_digests;
+        merkle_digests.reserve(result.digests.size());
+        for (const auto& digests : result.digests)
+            merkle_digests.push_back(digests->merkle_digest);
+
+        result.merkle_root = signed_block::calculate_merkle_root(std::move(merkle_digests));
+    }
+
+    return result;
+}
+
+void signature_recovery_pool::run()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]() { return !_tasks.empty() || _stop; });
+
+            if (_stop)
+                return;
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+bool prevalidated_blocks::add(std::shared_ptr<const signed_block> block,
+                              const std::function<std::shared_future<prepared_block>()>& prepare)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const block_id_type block_id = block->id();
+    if (_blocks.size() >= default_max_size || _blocks.count(block_id))
+        return false;
+
+    _blocks.emplace(block_id, entry{ std::move(block), prepare() });
+    return true;
+}
+
+fc::optional<prepared_block> prevalidated_blocks::take(const signed_block& block)
+{
+    const block_id_type block_id = block.id();
+
+    entry taken;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto itr = _blocks.find(block_id);
+        if (itr != _blocks.end())
+        {
+            taken = std::move(itr->second);
+            _blocks.erase(itr);
+        }
+
+        // blocks of other forks at this height and below won't be pushed
+        const uint32_t block_num = signed_block::num_from_id(block_id);
+        for (auto it = _blocks.begin(); it != _blocks.end();)
+        {
+            if (signed_block::num_from_id(it->first) <= block_num)
+                it = _blocks.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    if (!taken.prepared.valid())
+        return {};
+
+    // a block with the same header may come with other transactions, they are serialized once more to
+    // compare but signatures aren't recovered again
+    if (taken.block.get() != &block
+        && fc::raw::pack(taken.block->transactions) != fc::raw::pack(block.transactions))
+        return {};
+
+    try
+    {
+        fc::optional<prepared_block> prepared = taken.prepared.get();
+        if (!prepared->merkle_root || *prepared->merkle_root != block.transaction_merkle_root)
+            return {};
+        return prepared;
+    }
+    catch (...)
+    {
+        return {};
+    }
+}
+
+void prevalidated_blocks::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _blocks.clear();
+}
+
+size_t prevalidated_blocks::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _blocks.size();
+}
+
+} // namespace chain
+} // namespace scorum
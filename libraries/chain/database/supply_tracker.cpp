@@ -0,0 +1,175 @@
+#include <scorum/chain/database/supply_tracker.hpp>
+
+#include <scorum/chain/database/database.hpp>
+
+#include <scorum/chain/schema/account_objects.hpp>
+#include <scorum/chain/schema/atomicswap_objects.hpp>
+#include <scorum/chain/schema/bet_objects.hpp>
+#include <scorum/chain/schema/budget_objects.hpp>
+#include <scorum/chain/schema/scorum_objects.hpp>
+
+namespace scorum {
+namespace chain {
+
+namespace {
+
+supply_totals contribution(const account_object& account)
+{
+    supply_totals result;
+    result.accounts.add(account);
+    return result;
+}
+
+supply_totals contribution(const escrow_object& escrow)
+{
+    supply_totals result;
+    result.locked_scr += escrow.scorum_balance;
+    result.locked_scr += escrow.pending_fee;
+    return result;
+}
+
+template <budget_type type> supply_totals contribution(const adv_budget_object<type>& budget)
+{
+    supply_totals result;
+    result.locked_scr += budget.balance;
+    result.locked_scr += budget.owner_pending_income;
+    result.locked_scr += budget.budget_pending_outgo;
+    return result;
+}
+
+supply_totals contribution(const atomicswap_contract_object& contract)
+{
+    supply_totals result;
+    result.locked_scr += contract.amount;
+    return result;
+}
+
+supply_totals contribution(const matched_bet_object& bet)
+{
+    supply_totals result;
+    result.locked_scr += bet.bet1_data.stake;
+    result.locked_scr += bet.bet2_data.stake;
+    return result;
+}
+
+supply_totals contribution(const pending_bet_object& bet)
+{
+    supply_totals result;
+    result.locked_scr += bet.data.stake;
+    return result;
+}
+
+template <typename ObjectType> class supply_observer : public chainbase::object_observer<ObjectType>
+{
+public:
+    explicit supply_observer(chainbase::revision_journal<supply_totals>& journal)
+        : _journal(journal)
+    {
+    }
+
+    void on_add(const ObjectType& obj, int64_t revision) override
+    {
+        _journal.add(contribution(obj), revision);
+    }
+
+    void on_remove(const ObjectType& obj, int64_t revision) override
+    {
+        _journal.subtract(contribution(obj), revision);
+    }
+
+private:
+    chainbase::revision_journal<supply_totals>& _journal;
+};
+
+template <typename ObjectType> void add_index_totals(const database& db, supply_totals& totals)
+{
+    for (const ObjectType& obj : db.get_index<typename chainbase::get_index_type<ObjectType>::type>().indices())
+        totals += contribution(obj);
+}
+
+} // namespace
+
+supply_totals& supply_totals::operator+=(const supply_totals& other)
+{
+    accounts += other.accounts;
+    locked_scr += other.locked_scr;
+    return *this;
+}
+
+supply_totals& supply_totals::operator-=(const supply_totals& other)
+{
+    accounts -= other.accounts;
+    locked_scr -= other.locked_scr;
+    return *this;
+}
+
+bool supply_totals::operator==(const supply_totals& other) const
+{
+    return accounts.scr == other.accounts.scr && accounts.sp == other.accounts.sp
+        && accounts.pending_scr == other.accounts.pending_scr && accounts.pending_sp == other.accounts.pending_sp
+        && accounts.vsf_votes == other.accounts.vsf_votes && locked_scr == other.locked_scr;
+}
+
+bool supply_totals::operator!=(const supply_totals& other) const
+{
+    return !(*this == other);
+}
+
+supply_tracker::supply_tracker(database& db)
+    : _db(db)
+{
+    observe<account_object>();
+    observe<escrow_object>();
+    observe<post_budget_object>();
+    observe<banner_budget_object>();
+    observe<atomicswap_contract_object>();
+    observe<matched_bet_object>();
+    observe<pending_bet_object>();
+
+    _db.add_revision_listener(_journal);
+}
+
+supply_tracker::~supply_tracker()
+{
+    _db.remove_revision_listener(_journal);
+
+    for (const auto& detach : _detach)
+        detach();
+}
+
+template <typename ObjectType> void supply_tracker::observe()
+{
+    auto observer = std::make_shared<supply_observer<ObjectType>>(_journal);
+    _db.set_observer<ObjectType>(observer.get());
+
+    _observers.push_back(observer);
+    _detach.push_back([this]() { _db.set_observer<ObjectType>(nullptr); });
+}
+
+const supply_totals& supply_tracker::totals() const
+{
+    return _journal.value();
+}
+
+void supply_tracker::reset()
+{
+    _journal.reset(calculate(_db));
+}
+
+supply_totals supply_tracker::calculate(const database& db)
+{
+    supply_totals totals;
+
+    add_index_totals<account_object>(db, totals);
+    add_index_totals<escrow_object>(db, totals);
+    add_index_totals<post_budget_object>(db, totals);
+    add_index_totals<banner_budget_object>(db, totals);
+    add_index_totals<atomicswap_contract_object>(db, totals);
+    add_index_totals<matched_bet_object>(db, totals);
+    add_index_totals<pending_bet_object>(db, totals);
+
+    return totals;
+}
+
+} // namespace chain
+} // namespace scorum
@@ -34,6 +34,22 @@ class block_log_impl;
  *
  * The main file is the only file that needs to persist. The index file can be reconstructed during a
  * linear scan of the main file.
+ *
+ * Compressed format keeps the same stream of blocks, so positions in it and in the index are the same.
+ * The stream is cut into chunks of a fixed number of blocks which are compressed by zlib, the blocks
+ * of the last chunk are kept raw in the .tail file until the chunk is full. A block is read by
+ * decompression of one chunk, recently decompressed chunks are cached.
+ *
+ * Segmented log keeps each fixed range of blocks in its own file with its own index, e.g.
+ * block_log.0000000001-0001000000, block_log.0001000001-0002000000. Segments before the head one are
+ * complete, they can be removed by remove_segments or moved to an archive while the node is stopped,
+ * the log then starts with the first remaining segment. Positions of the segmented log have the segment
+ * number in the high bits, they are passed back to read_block as they are.
+ *
+ * Files are read through memory mappings, so reads don't take locks and can be made from many threads
+ * while blocks are appended. Appended blocks become visible to readers on flush, a read of a block which
+ * isn't flushed yet flushes the log. open, close, append, append_async and remove_segments are called
+ * by one thread.
  */
 
 class block_log
@@ -42,13 +58,48 @@ public:
     block_log();
     ~block_log();
 
-    void open(const fc::path& file);
+    /**
+     * New log is created in the compressed format if blocks_per_chunk isn't 0 and is split into segments
+     * if blocks_per_segment isn't 0, an existing log keeps its format and layout.
+     */
+    void open(const fc::path& file, uint32_t blocks_per_chunk = 0, uint32_t blocks_per_segment = 0);
+    /**
+     * Opens an existing log to check it, the files are not changed: an incomplete chunk isn't cut off, the tail
+     * isn't reset and the index isn't reconstructed. Such problems are returned by problems(), blocks can't
+     * be appended.
+     */
+    void open_read_only(const fc::path& file);
+    /// Problems found by open_read_only which open would repair
+    std::vector<std::string> problems() const;
     void close();
     bool is_open() const;
 
+    /// 0 for the raw format
+    uint32_t blocks_per_chunk() const;
+    /// 0 for the log in one file
+    uint32_t blocks_per_segment() const;
+
     static fc::path block_log_index_path(const fc::path& block_log_file);
+    static fc::path block_log_tail_path(const fc::path& block_log_file);
+    /// Removes all files of the log, segments including
+    static void wipe(const fc::path& block_log_file);
 
     uint64_t append(const signed_block& b);
+
+    /**
+     * Appends of append_async are made by a background thread which writes queued blocks in groups and syncs
+     * them to the disk after each group. Up to max_queue_size blocks wait for it, then append_async waits.
+     * Queued blocks are read by read_block_by_num, they have no positions until they are written.
+     * The writer is stopped by close after the queue is written.
+     *
+     * If a block can't be written the writer stops, the block and the following ones stay in the queue.
+     * The error is thrown by append_async, flush and close until the log is closed.
+     */
+    void start_writer(size_t max_queue_size);
+    /// Queues the block for the writer, it's appended at once if the writer isn't started
+    void append_async(const signed_block& b);
+
+    /// Waits until queued blocks are written and makes appended blocks readable
     void flush();
     std::pair<signed_block, uint64_t> read_block(uint64_t file_pos) const;
     optional<signed_block> read_block_by_num(uint32_t block_num) const;
@@ -58,13 +109,22 @@ public:
      */
     uint64_t get_block_pos(uint32_t block_num) const;
     signed_block read_head() const;
+    /// Last block passed to append or append_async, it's for the appending thread
     const optional<signed_block>& head() const;
+    /// Last block which is written, blocks after it wait in the queue of the writer. It's 0 if the log is empty
+    uint32_t written_block_num() const;
+    /// First block which is kept in the log, it's 0 if the log is empty
+    uint32_t first_block_num() const;
+
+    /**
+     * Removes segments which blocks are all below block_num, the head segment is kept. Blocks of the removed
+     * segments are not read anymore. Returns number of the removed segments, it's 0 for the log in one file.
+     */
+    uint32_t remove_segments(uint32_t block_num);
 
     static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
 private:
-    void construct_index();
-
     std::unique_ptr<detail::block_log_impl> my;
 };
 }
@@ -23,6 +23,7 @@
 #include <fc/shared_string.hpp>
 #include <fc/log/logger.hpp>
 
+#include <functional>
 #include <map>
 #include <memory>
 
@@ -34,8 +35,15 @@ using scorum::protocol::asset_symbol_type;
 using scorum::protocol::authority;
 using scorum::protocol::operation;
 using scorum::protocol::signed_transaction;
+using scorum::protocol::signed_transaction_digests;
 
 class database_impl;
+class supply_tracker;
+struct supply_totals;
+class signature_recovery_pool;
+struct prepared_block;
+class recovered_keys_cache;
+class prevalidated_blocks;
 
 struct genesis_state_type;
 struct genesis_persistent_state_type;
@@ -122,6 +130,43 @@ public:
                  uint32_t skip_flags,
                  const genesis_state_type& genesis_state);
 
+    /**
+     * @brief Load state from the snapshot and open database
+     *
+     * This method may be called instead of @ref database::reindex. It wipes the shared memory, loads the state
+     * saved by @ref database::export_snapshot and replays blocks from the block log which follow the snapshot.
+     */
+    void import_snapshot(const fc::path& data_dir,
+                         const fc::path& shared_mem_dir,
+                         uint64_t shared_file_size,
+                         uint32_t skip_flags,
+                         const genesis_state_type& genesis_state,
+                         const fc::path& snapshot_file);
+
+    /**
+     * @brief Save the state to the portable snapshot file
+     *
+     * State must be at the last irreversible block (without undo history), that is just after
+     * @ref database::open or @ref database::reindex.
+     */
+    void export_snapshot(const fc::path& snapshot_file);
+
+    /**
+     * @brief Rebuild the shared memory file densely
+     *
+     * Database must be just opened. The state is saved to a temporary snapshot in the shared memory dir
+     * and loaded into a new shared memory file of shared_file_size, so objects are allocated in primary key
+     * order without gaps left by removed ones. Object counts of every index and invariants are verified.
+     * The new file is built in a separate dir and replaces the original one only after that. On failure
+     * the original file and the snapshot are kept and the database is left closed. Blocks of the block log
+     * which are ahead of the state are replayed after the new file is verified and opened.
+     */
+    void compact_shared_file(const fc::path& data_dir,
+                             const fc::path& shared_mem_dir,
+                             uint64_t shared_file_size,
+                             uint32_t skip_flags,
+                             const genesis_state_type& genesis_state);
+
     /**
      * @brief wipe Delete database from disk, and potentially the raw chain as well.
      * @param include_blocks If true, delete the raw chain as well as the database.
@@ -171,6 +216,13 @@ public:
     bool before_last_checkpoint() const;
 
     bool push_block(const signed_block& b, uint32_t skip = skip_nothing);
+
+    /**
+     * Starts the checks of a block which don't depend on the chain state (transaction digests, merkle root,
+     * signature keys) on the signature recovery threads, so push_block of the block only waits for the result.
+     * It's used by sync to check blocks ahead of the applied one, skip must be the flags of push_block.
+     */
+    void prevalidate_block(const signed_block& b, uint32_t skip = skip_nothing);
     void push_transaction(const signed_transaction& trx, uint32_t skip = skip_nothing);
 
     void _push_transaction(const signed_transaction& trx);
@@ -316,9 +368,50 @@ public:
        with id N, applies all hardforks with id <= N */
     void set_hardfork(uint32_t hardfork, bool process_now = true);
 
+    /**
+     * Verifies supply invariants by the scan of all balances, it also checks the tracked totals against the scan.
+     * Cost grows with the number of accounts, it's made on open and every full_invariants_check_interval blocks.
+     */
     void validate_invariants() const;
 
+    /// Verifies supply invariants by the totals tracked on object changes, it's made on every applied block
+    void validate_tracked_invariants() const;
+
+    /// Full check of invariants is made this many blocks, 0 disables it
+    void set_full_invariants_check_interval(uint32_t blocks);
+
+    /**
+     * Transaction digests and signatures of pushed blocks are computed by this many threads before
+     * the write lock is taken, with 0 nothing is computed ahead and apply recovers the signatures inline.
+     */
+    void set_signature_recovery_threads(size_t threads);
+
+    /// Maximum number of signatures which recovered keys are kept for, 0 disables the cache
+    void set_signature_cache_size(size_t size);
+
     void set_flush_interval(uint32_t flush_blocks);
+
+    /**
+     * Shared file is grown by this size when free memory drops below the threshold, 0 disables growth.
+     * Growth is limited by segment_options::max_size.
+     */
+    void set_shared_file_grow_step(uint64_t grow_step);
+
+    /// New block log is split into segment files of this many blocks, 0 keeps it in one file
+    void set_block_log_segment_size(uint32_t blocks);
+
+    /**
+     * Segments of the block log which blocks are all older than this many last irreversible blocks are removed,
+     * 0 keeps all blocks. Node without them can't be reindexed and doesn't serve them to peers.
+     */
+    void set_block_log_keep_blocks(uint32_t blocks);
+
+    /**
+     * Irreversible blocks are appended to the block log by a background thread, up to this many blocks wait
+     * for it. 0 makes the appends by the applying thread. The state isn't committed past the written blocks,
+     * so the undo history grows by the queued blocks.
+     */
+    void set_block_log_write_queue_size(uint32_t blocks);
     void show_free_memory(bool force);
 
     // index
@@ -331,6 +424,25 @@ public:
     const genesis_persistent_state_type& genesis_persistent_state() const;
 
 private:
+    void open(const fc::path& data_dir,
+              const fc::path& shared_mem_dir,
+              uint64_t shared_file_size,
+              uint32_t chainbase_flags,
+              const genesis_state_type& genesis_state,
+              const std::function<void()>& init_state);
+
+    void replay_blocks(uint32_t from_block_num, uint32_t skip_flags);
+
+    /// Wipes the shared memory and opens the database with the state from the snapshot, returns its block num
+    uint32_t load_snapshot(const fc::path& data_dir,
+                           const fc::path& shared_mem_dir,
+                           uint64_t shared_file_size,
+                           const genesis_state_type& genesis_state,
+                           const fc::path& snapshot_file);
+
+    /// Applies blocks from the block log which follow the loaded snapshot
+    void replay_snapshot_tail(uint32_t snapshot_block_num, uint32_t skip_flags);
+
     // witness_schedule
     void update_witness_schedule();
     void _reset_witness_virtual_schedule_time();
@@ -361,11 +473,15 @@ protected:
     ///@{
 
     const witness_object& validate_block_header(uint32_t skip, const signed_block& next_block) const;
+
+    /// digests of the transaction being applied if its block is prepared, nullptr otherwise
+    const signed_transaction_digests* current_trx_digests() const;
     void create_block_summary(const signed_block& next_block);
 
     void update_global_dynamic_data(const signed_block& b);
     void update_signing_witness(const witness_object& signing_witness, const signed_block& new_block);
     void update_last_irreversible_block();
+    void on_irreversible_block(uint32_t block_num);
     void clear_expired_transactions();
     void clear_expired_delegations();
     void process_header_extensions(const signed_block& next_block);
@@ -375,6 +491,8 @@ protected:
     void apply_hardfork(uint32_t hardfork);
     ///@}
 
+    void check_supply_invariants(const supply_totals& totals) const;
+
 private:
     std::unique_ptr<database_impl> _my;
 
@@ -406,6 +524,23 @@ private:
 
     uint32_t _last_free_gb_printed = 0;
 
+    std::unique_ptr<supply_tracker> _supply_tracker;
+    uint32_t _full_invariants_check_blocks = 0;
+
+    // the pool is destroyed first, its workers use the cache
+    std::unique_ptr<recovered_keys_cache> _recovered_keys_cache;
+    std::unique_ptr<signature_recovery_pool> _signature_recovery;
+    std::unique_ptr<prevalidated_blocks> _prevalidated_blocks;
+    const prepared_block* _prepared_block = nullptr; ///< data of the block being pushed
+    const signed_block* _pushed_block = nullptr; ///< block which _prepared_block is computed from
+    const prepared_block* _current_prepared = nullptr; ///< data of the block being applied
+
+    uint64_t _shared_file_grow_step = 0;
+
+    uint32_t _block_log_segment_size = 0;
+    uint32_t _block_log_keep_blocks = 0;
+    uint32_t _block_log_write_queue_size = 0;
+
     fc::time_point_sec _const_genesis_time; // should be const
 };
 } // namespace chain
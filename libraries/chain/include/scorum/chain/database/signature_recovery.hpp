@@ -0,0 +1,197 @@
+#pragma once
+
+#include <scorum/protocol/block.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace scorum {
+namespace chain {
+
+using scorum::protocol::block_id_type;
+using scorum::protocol::chain_id_type;
+using scorum::protocol::checksum_type;
+using scorum::protocol::digest_type;
+using scorum::protocol::public_key_type;
+using scorum::protocol::signature_type;
+using scorum::protocol::signed_block;
+using scorum::protocol::signed_transaction;
+using scorum::protocol::signed_transaction_digests;
+
+/**
+ * Public keys recovered from transaction signatures. A transaction is verified when it enters the pending
+ * list, when pending transactions are reapplied to generate a block and when the block is pushed,
+ * the cache makes recovery once for all of them.
+ *
+ * Entry is addressed by the signature digest and the signature, it's dropped when the transaction
+ * expires or the cache is full. It's thread safe.
+ */
+class recovered_keys_cache
+{
+public:
+    static constexpr size_t default_max_size = 100000;
+
+    explicit recovered_keys_cache(size_t max_size);
+
+    /// Same as signed_transaction::get_signature_keys, recovers only signatures which are not in the cache
+    fc::flat_set<public_key_type> get_signature_keys(const signed_transaction& trx, const chain_id_type& chain_id);
+    fc::flat_set<public_key_type> get_signature_keys(const signed_transaction& trx, const digest_type& sig_digest);
+
+    /// Drops entries of transactions expired before the time
+    void remove_expired(fc::time_point_sec now);
+
+    void set_max_size(size_t max_size);
+
+    size_t size() const;
+
+private:
+    struct entry
+    {
+        digest_type digest;
+        signature_type signature;
+        public_key_type key;
+        fc::time_point_sec expiration;
+    };
+
+    struct by_signature;
+    struct by_expiration;
+
+    // clang-format off
+    using entry_index = boost::multi_index_container<entry,
+        boost::multi_index::indexed_by<
+            boost::multi_index::ordered_unique<boost::multi_index::tag<by_signature>,
+                boost::multi_index::composite_key<entry,
+                    boost::multi_index::member<entry, digest_type, &entry::digest>,
+                    boost::multi_index::member<entry, signature_type, &entry::signature>>>,
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_expiration>,
+                boost::multi_index::member<entry, fc::time_point_sec, &entry::expiration>>>>;
+    // clang-format on
+
+    void shrink(size_t max_size);
+
+    mutable std::mutex _mutex;
+    entry_index _entries;
+    size_t _max_size;
+};
+
+/**
+ * Data of a block computed before the write lock is taken: transaction digests and public keys recovered
+ * from the signatures. Entry is empty if it's not computed or its recovery failed, apply computes it again
+ * to report the error.
+ */
+struct prepared_block
+{
+    block_id_type block_id;
+
+    fc::optional<public_key_type> signee;
+    /// root of the transaction digests, it's set if all of them are computed
+    fc::optional<checksum_type> merkle_root;
+    std::vector<fc::optional<signed_transaction_digests>> digests;
+    std::vector<fc::optional<fc::flat_set<public_key_type>>> keys;
+};
+
+/**
+ * Computes transaction digests and recovers public keys of the block signatures on the worker threads.
+ * It's made before the write lock is taken, so apply only checks the keys against authorities.
+ */
+class signature_recovery_pool
+{
+public:
+    explicit signature_recovery_pool(size_t threads_count);
+    ~signature_recovery_pool();
+
+    signature_recovery_pool(const signature_recovery_pool&) = delete;
+    signature_recovery_pool& operator=(const signature_recovery_pool&) = delete;
+
+    /**
+     * Returns when the block is prepared, the calling thread takes part in the work.
+     * Witness key is recovered if recover_signee is set and transaction keys if recover_tx_keys is set,
+     * e.g. nodes which skip transaction signatures still check the witness signature.
+     */
+    prepared_block prepare(const signed_block& block,
+                           const chain_id_type& chain_id,
+                           recovered_keys_cache& cache,
+                           bool recover_signee,
+                           bool recover_tx_keys);
+
+    /**
+     * Queues the block to be prepared by a worker thread, it's used to check blocks ahead of the applied one.
+     * Block is prepared by the calling thread if the pool has no threads. Cache must outlive the pool.
+     */
+    std::shared_future<prepared_block> prepare_async(std::shared_ptr<const signed_block> block,
+                                                     const chain_id_type& chain_id,
+                                                     recovered_keys_cache& cache,
+                                                     bool recover_signee,
+                                                     bool recover_tx_keys);
+
+    size_t threads_count() const;
+
+private:
+    prepared_block prepare(const signed_block& block,
+                           const chain_id_type& chain_id,
+                           recovered_keys_cache& cache,
+                           bool recover_signee,
+                           bool recover_tx_keys,
+                           size_t helpers_count);
+
+    void run();
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::function<void()>> _tasks;
+    bool _stop = false;
+
+    std::vector<std::thread> _threads;
+};
+
+/**
+ * Blocks which are prepared ahead of the applied one during sync. Block is taken when it's pushed, entries of
+ * blocks which are not pushed are dropped when the chain passes their numbers. It's thread safe.
+ *
+ * Block id covers the header only, so the prepared data is given to the pushed block only if it's prepared
+ * from the same transactions.
+ */
+class prevalidated_blocks
+{
+public:
+    static constexpr size_t default_max_size = 1000;
+
+    /// Calls prepare and keeps its result if the block isn't here yet and max size isn't reached
+    bool add(std::shared_ptr<const signed_block> block,
+             const std::function<std::shared_future<prepared_block>()>& prepare);
+
+    /**
+     * Waits until the block is prepared, returns empty value if it wasn't added, its preparation failed
+     * or it was prepared from other transactions than the block has
+     */
+    fc::optional<prepared_block> take(const signed_block& block);
+
+    void clear();
+
+    size_t size() const;
+
+private:
+    struct entry
+    {
+        std::shared_ptr<const signed_block> block;
+        std::shared_future<prepared_block> prepared;
+    };
+
+    mutable std::mutex _mutex;
+    std::map<block_id_type, entry> _blocks;
+};
+
+} // namespace chain
+} // namespace scorum
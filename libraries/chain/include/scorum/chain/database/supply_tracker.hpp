@@ -0,0 +1,69 @@
+#pragma once
+
+#include <scorum/chain/services/account.hpp>
+
+#include <chainbase/object_observer.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace scorum {
+namespace chain {
+
+class database;
+
+/**
+ * Balances of the objects which are checked by database::validate_invariants.
+ * Balances of singleton objects are not here, they are read directly.
+ */
+struct supply_totals
+{
+    accounts_total accounts;
+
+    /// SCR held by escrows, advertising budgets, atomic swaps and bets
+    asset locked_scr = asset(0, SCORUM_SYMBOL);
+
+    supply_totals& operator+=(const supply_totals& other);
+    supply_totals& operator-=(const supply_totals& other);
+
+    bool operator==(const supply_totals& other) const;
+    bool operator!=(const supply_totals& other) const;
+};
+
+/**
+ * Keeps supply_totals up to date as the objects are created, modified and removed, so the invariants
+ * are checked without the scan of all accounts. Totals follow undo/squash/commit of the database.
+ */
+class supply_tracker
+{
+public:
+    explicit supply_tracker(database& db);
+    ~supply_tracker();
+
+    supply_tracker(const supply_tracker&) = delete;
+    supply_tracker& operator=(const supply_tracker&) = delete;
+
+    const supply_totals& totals() const;
+
+    /**
+     * Recalculates totals by the scan of the indices. It's needed when the objects were changed
+     * bypassing observers, e.g. restored from a snapshot. Undo history must be empty.
+     */
+    void reset();
+
+    /// scans all indices, O(number of objects)
+    static supply_totals calculate(const database& db);
+
+private:
+    template <typename ObjectType> void observe();
+
+    database& _db;
+    chainbase::revision_journal<supply_totals> _journal;
+
+    std::vector<std::shared_ptr<void>> _observers;
+    std::vector<std::function<void()>> _detach;
+};
+
+} // namespace chain
+} // namespace scorum
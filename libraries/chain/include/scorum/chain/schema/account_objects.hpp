@@ -578,6 +578,7 @@ FC_REFLECT( scorum::chain::account_object,
              (active_sp_holders_pending_sp_reward)
           )
 CHAINBASE_SET_INDEX_TYPE( scorum::chain::account_object, scorum::chain::account_index )
+CHAINBASE_SET_UNDO_POLICY( scorum::chain::account_object, chainbase::field_delta_undo )
 
 FC_REFLECT( scorum::chain::account_blogging_statistic_object,
              (id)(account)
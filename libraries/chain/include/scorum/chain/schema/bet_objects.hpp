@@ -108,7 +108,7 @@ using bet_uuid_history_index
                                                                    &bet_uuid_history_object::uuid>>>>;
 
 using pending_bet_index
-    = shared_multi_index_container<pending_bet_object,
+    = pooled_multi_index_container<pending_bet_object,
                                    indexed_by<ordered_unique<tag<by_id>,
                                                              member<pending_bet_object,
                                                                     pending_bet_id_type,
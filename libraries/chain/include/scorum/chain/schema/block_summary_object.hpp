@@ -1,6 +1,8 @@
 #pragma once
 #include <scorum/chain/schema/scorum_object_types.hpp>
 
+#include <chainbase/array_index.hpp>
+
 namespace scorum {
 namespace chain {
 
@@ -24,14 +26,11 @@ public:
     block_id_type block_id;
 };
 
-typedef shared_multi_index_container<block_summary_object,
-                                     indexed_by<ordered_unique<tag<by_id>,
-                                                               member<block_summary_object,
-                                                                      block_summary_object::id_type,
-                                                                      &block_summary_object::id>>>>
-    block_summary_index;
+// id is a block number masked by SCORUM_BLOCKID_POOL_SIZE, so it's never above 0xffff
+typedef chainbase::array_index<block_summary_object, 0x10000> block_summary_index;
 }
 } // scorum::chain
 
 FC_REFLECT(scorum::chain::block_summary_object, (id)(block_id))
 CHAINBASE_SET_INDEX_TYPE(scorum::chain::block_summary_object, scorum::chain::block_summary_index)
+CHAINBASE_SET_UNDO_POLICY(scorum::chain::block_summary_object, chainbase::field_delta_undo)
@@ -369,6 +369,7 @@ FC_REFLECT( scorum::chain::comment_object,
             (rewarded)
           )
 CHAINBASE_SET_INDEX_TYPE( scorum::chain::comment_object, scorum::chain::comment_index )
+CHAINBASE_SET_UNDO_POLICY( scorum::chain::comment_object, chainbase::field_delta_undo )
 
 FC_REFLECT( scorum::chain::comment_vote_object,
             (id)
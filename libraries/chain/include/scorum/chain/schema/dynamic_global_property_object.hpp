@@ -3,6 +3,8 @@
 
 #include <scorum/chain/schema/scorum_object_types.hpp>
 
+#include <chainbase/array_index.hpp>
+
 #include <scorum/protocol/asset.hpp>
 #include <scorum/protocol/version.hpp>
 #include <scorum/protocol/chain_properties.hpp>
@@ -122,12 +124,7 @@ public:
     betting_total_stats betting_stats;
 };
 
-typedef shared_multi_index_container<dynamic_global_property_object,
-                                     indexed_by<ordered_unique<tag<by_id>,
-                                                               member<dynamic_global_property_object,
-                                                                      dynamic_global_property_object::id_type,
-                                                                      &dynamic_global_property_object::id>>>>
-    dynamic_global_property_index;
+typedef chainbase::array_index<dynamic_global_property_object, 1> dynamic_global_property_index;
 } // namespace chain
 } // namespace scorum
 
@@ -160,3 +157,4 @@ FC_REFLECT(scorum::chain::betting_total_stats, (pending_bets_volume)(matched_bet
 // clang-format on
 
 CHAINBASE_SET_INDEX_TYPE(scorum::chain::dynamic_global_property_object, scorum::chain::dynamic_global_property_index)
+CHAINBASE_SET_UNDO_POLICY(scorum::chain::dynamic_global_property_object, chainbase::field_delta_undo)
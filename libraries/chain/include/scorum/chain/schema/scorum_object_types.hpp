@@ -21,6 +21,7 @@ namespace chain {
 using namespace boost::multi_index;
 
 using fc::shared_multi_index_container;
+using chainbase::pooled_multi_index_container;
 
 using chainbase::object;
 using chainbase::oid;
@@ -33,6 +34,15 @@ using scorum::protocol::transaction_id_type;
 
 struct by_id;
 
+/**
+ * Version of the layout of objects and indices kept in the shared memory file. It's increased by every
+ * change of the layout, the file of another version isn't opened and the state has to be replayed.
+ *
+ * 1 - array indices of block summaries and singletons, pooled indices of transactions, bets, history
+ *     and operations
+ */
+const uint32_t shared_memory_schema_version = 1;
+
 enum object_type
 {
     account_authority_object_type,
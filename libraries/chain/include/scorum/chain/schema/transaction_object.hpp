@@ -29,7 +29,7 @@ public:
 
 struct by_expiration;
 struct by_trx_id;
-typedef shared_multi_index_container<transaction_object,
+typedef pooled_multi_index_container<transaction_object,
                                      indexed_by<ordered_unique<tag<by_id>,
                                                                member<transaction_object,
                                                                       transaction_object_id_type,
@@ -6,6 +6,8 @@
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <chainbase/array_index.hpp>
+
 namespace scorum {
 namespace chain {
 
@@ -198,12 +200,7 @@ typedef shared_multi_index_container<witness_vote_object,
                                      >
     witness_vote_index;
 
-typedef shared_multi_index_container<witness_schedule_object,
-                                     indexed_by<ordered_unique<tag<by_id>,
-                                                               member<witness_schedule_object,
-                                                                      witness_schedule_id_type,
-                                                                      &witness_schedule_object::id>>>>
-    witness_schedule_index;
+typedef chainbase::array_index<witness_schedule_object, 1> witness_schedule_index;
 
 typedef shared_multi_index_container<witness_reward_in_sp_migration_object,
                                      indexed_by<ordered_unique<tag<by_id>,
@@ -238,6 +235,7 @@ FC_REFLECT( scorum::chain::witness_schedule_object,
              (id)(current_virtual_time)(current_shuffled_witnesses)(num_scheduled_witnesses)
           )
 CHAINBASE_SET_INDEX_TYPE( scorum::chain::witness_schedule_object, scorum::chain::witness_schedule_index )
+CHAINBASE_SET_UNDO_POLICY( scorum::chain::witness_schedule_object, chainbase::field_delta_undo )
 
 FC_REFLECT( scorum::chain::witness_reward_in_sp_migration_object,
              (id)(balance)
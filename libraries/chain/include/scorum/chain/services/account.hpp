@@ -22,6 +22,12 @@ struct accounts_total
     asset pending_sp = asset(0, SP_SYMBOL);
 
     share_type vsf_votes = 0;
+
+    /// adds balances of the account
+    void add(const account_object& account);
+
+    accounts_total& operator+=(const accounts_total& other);
+    accounts_total& operator-=(const accounts_total& other);
 };
 
 struct account_service_i : public base_service_i<account_object>
@@ -701,20 +701,45 @@ accounts_total dbs_account::accounts_circulating_capital() const
     const auto& account_idx = db_impl().get_index<account_index>().indices().get<by_name>();
     for (auto itr = account_idx.begin(); itr != account_idx.end(); ++itr)
     {
-        totals.scr += itr->balance;
-        totals.sp += itr->scorumpower;
-        totals.pending_scr += itr->active_sp_holders_pending_scr_reward;
-        totals.pending_sp += itr->active_sp_holders_pending_sp_reward;
-
-        totals.vsf_votes += (itr->proxy == SCORUM_PROXY_TO_SELF_ACCOUNT
-                                 ? itr->witness_vote_weight()
-                                 : (SCORUM_MAX_PROXY_RECURSION_DEPTH > 0
-                                        ? itr->proxied_vsf_votes[SCORUM_MAX_PROXY_RECURSION_DEPTH - 1]
-                                        : itr->scorumpower.amount));
+        totals.add(*itr);
     }
 
     return totals;
 }
 
+void accounts_total::add(const account_object& account)
+{
+    scr += account.balance;
+    sp += account.scorumpower;
+    pending_scr += account.active_sp_holders_pending_scr_reward;
+    pending_sp += account.active_sp_holders_pending_sp_reward;
+
+    vsf_votes += (account.proxy == SCORUM_PROXY_TO_SELF_ACCOUNT
+                      ? account.witness_vote_weight()
+                      : (SCORUM_MAX_PROXY_RECURSION_DEPTH > 0
+                             ? account.proxied_vsf_votes[SCORUM_MAX_PROXY_RECURSION_DEPTH - 1]
+                             : account.scorumpower.amount));
+}
+
+accounts_total& accounts_total::operator+=(const accounts_total& other)
+{
+    scr += other.scr;
+    sp += other.sp;
+    pending_scr += other.pending_scr;
+    pending_sp += other.pending_sp;
+    vsf_votes += other.vsf_votes;
+    return *this;
+}
+
+accounts_total& accounts_total::operator-=(const accounts_total& other)
+{
+    scr -= other.scr;
+    sp -= other.sp;
+    pending_scr -= other.pending_scr;
+    pending_sp -= other.pending_sp;
+    vsf_votes -= other.vsf_votes;
+    return *this;
+}
+
 } // namespace chain
 } // namespace scorum
@@ -1,5 +1,7 @@
 #include <chainbase/chainbase.hpp>
 
+#include <map>
+
 namespace chainbase {
 
 database::~database()
@@ -56,6 +58,8 @@ void database::open(const boost::filesystem::path& dir, uint32_t flags, uint64_t
 
     create_segment_file(shared_memory_path(dir), read_only, shared_file_size);
 
+    open_undo_state();
+
     create_meta_file(shared_memory_meta_path(dir));
 
     // create lock on meta file
@@ -75,11 +79,49 @@ void database::flush()
         _meta->flush();
 }
 
+void database::start_background_flush(const flush_options& options)
+{
+    FC_ASSERT(_segment && !_read_only, "Database must be opened in read/write mode");
+
+    _flusher.reset(new segment_flusher(
+        [this]() { return get_mapped_ranges(); },
+        [this](const std::function<void()>& callback, uint64_t wait_micro) {
+            return try_with_write_lock([&]() { callback(); }, wait_micro);
+        },
+        options));
+}
+
+void database::request_flush()
+{
+    if (_flusher)
+        _flusher->request();
+    else
+        flush();
+}
+
+flush_statistic database::get_flush_statistic() const
+{
+    if (!_flusher)
+        return flush_statistic();
+
+    return _flusher->get_statistic();
+}
+
 void database::close()
 {
+    // flusher must not see the segment unmapped
+    _flusher.reset();
+
+    close_undo_state();
+
     close_segment_file();
 
     _meta.reset();
+
+    // indices are bound to the closed segment, they are added again after the next open
+    _index_table.clear();
+    _snapshot_map.clear();
+    _statistic_map.clear();
 }
 
 void database::wipe(const boost::filesystem::path& dir)
@@ -88,7 +130,89 @@ void database::wipe(const boost::filesystem::path& dir)
 
     boost::filesystem::remove_all(shared_memory_path(dir));
     boost::filesystem::remove_all(shared_memory_meta_path(dir));
-    _index_map.clear();
+    _revision_listeners.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace {
+const uint32_t snapshot_magic = 0x534e4243; // "CBNS"
+const uint32_t snapshot_version = 1;
+}
+
+void database::write_snapshot(const boost::filesystem::path& file, const std::vector<char>& user_data) const
+{
+    if (enabled())
+        BOOST_THROW_EXCEPTION(std::logic_error("cannot write snapshot while there is an undo stack"));
+
+    for (const auto& item : _snapshot_map)
+    {
+        if (!item.second)
+            BOOST_THROW_EXCEPTION(std::logic_error("index of type " + std::to_string(item.first)
+                                                   + " is not reflected and can't be stored to snapshot"));
+    }
+
+    snapshot_writer writer(file);
+
+    writer.write(snapshot_magic);
+    writer.write(snapshot_version);
+    writer.write(user_data);
+    writer.write<uint32_t>(_snapshot_map.size());
+
+    for (const auto& item : _snapshot_map)
+    {
+        writer.write(item.second->name());
+        item.second->write(writer);
+    }
+
+    writer.finish();
+}
+
+std::vector<char> database::read_snapshot(const boost::filesystem::path& file)
+{
+    if (enabled())
+        BOOST_THROW_EXCEPTION(std::logic_error("cannot read snapshot while there is an undo stack"));
+
+    snapshot_reader reader(file);
+
+    if (reader.read<uint32_t>() != snapshot_magic)
+        BOOST_THROW_EXCEPTION(std::runtime_error(file.generic_string() + " is not a snapshot file"));
+
+    const auto version = reader.read<uint32_t>();
+    if (version != snapshot_version)
+        BOOST_THROW_EXCEPTION(std::runtime_error("unsupported snapshot version " + std::to_string(version)));
+
+    std::vector<char> user_data;
+    reader.read(user_data);
+
+    std::map<std::string, abstract_index_snapshot_i*> indices;
+    for (const auto& item : _snapshot_map)
+    {
+        if (item.second)
+            indices[item.second->name()] = item.second.get();
+    }
+
+    if (indices.size() != _snapshot_map.size())
+        BOOST_THROW_EXCEPTION(std::logic_error("database has indices which can't be loaded from snapshot"));
+
+    const auto count = reader.read<uint32_t>();
+    if (count != indices.size())
+        BOOST_THROW_EXCEPTION(std::runtime_error("snapshot has " + std::to_string(count) + " indices, but database has "
+                                                 + std::to_string(indices.size())));
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::string name;
+        reader.read(name);
+
+        auto itr = indices.find(name);
+        if (itr == indices.end())
+            BOOST_THROW_EXCEPTION(std::runtime_error("index " + name + " from snapshot is not added to database"));
+
+        itr->second->read(reader);
+    }
+
+    return user_data;
 }
 
 } // namespace chainbase
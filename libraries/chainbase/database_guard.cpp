@@ -31,6 +31,10 @@ uint32_t read_write_mutex_manager::current_lock_num()
 }
 
 //////////////////////////////////////////////////////////////////////////
+thread_local uint32_t database_guard::_thread_read_depth = 0;
+thread_local bool database_guard::_thread_read_interruptible = false;
+thread_local bool database_guard::_thread_read_interrupted = false;
+
 database_guard::~database_guard()
 {
 }
@@ -40,24 +44,29 @@ void database_guard::set_require_locking(bool enable_require_locking)
     _enable_require_locking = enable_require_locking;
 }
 
-void database_guard::require_lock_fail(const char* method, const char* lock_type, const char* tname) const
+void database_guard::set_writer_priority(bool writer_priority)
 {
-    std::string err_msg = "database_guard::" + std::string(method) + " require_" + std::string(lock_type)
-        + "_lock() failed on type " + std::string(tname);
-    std::cerr << err_msg << std::endl;
-    BOOST_THROW_EXCEPTION(std::runtime_error(err_msg));
+    _writer_priority = writer_priority;
+}
+
+void database_guard::set_lock_statistic(bool enable)
+{
+    _lock_statistic_enabled = enable;
+    if (!enable)
+        _lock_statistic.clear();
 }
 
-void database_guard::require_read_lock(const char* method, const char* tname) const
+std::vector<lock_statistic> database_guard::get_lock_statistic() const
 {
-    if (BOOST_UNLIKELY(_enable_require_locking & /*_read_only & */ (_read_lock_count <= 0)))
-        require_lock_fail(method, "read", tname);
+    return _lock_statistic.get();
 }
 
-void database_guard::require_write_lock(const char* method, const char* tname)
+void database_guard::require_lock_fail(const char* method, const char* lock_type, const char* tname) const
 {
-    if (BOOST_UNLIKELY(_enable_require_locking & (_write_lock_count <= 0)))
-        require_lock_fail(method, "write", tname);
+    std::string err_msg = "database_guard::" + std::string(method) + " require_" + std::string(lock_type)
+        + "_lock() failed on type " + std::string(tname);
+    std::cerr << err_msg << std::endl;
+    BOOST_THROW_EXCEPTION(std::runtime_error(err_msg));
 }
 
 void database_guard::set_read_write_mutex_manager(read_write_mutex_manager* manager)
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <memory>
-#include <vector>
 #include <boost/cstdint.hpp>
 
 namespace chainbase {
@@ -14,21 +13,30 @@ struct abstract_undo_session
 };
 
 using abstract_undo_session_ptr = std::unique_ptr<abstract_undo_session>;
-using abstract_undo_session_list = std::vector<abstract_undo_session_ptr>;
+
+//------------------------------------------------------------------------------------------------------//
+struct abstract_undoable_i
+{
+    virtual ~abstract_undoable_i(){};
+
+    virtual void undo() = 0;
+};
 
 //------------------------------------------------------------------------------------------------------//
 struct abstract_generic_index_i
 {
     virtual ~abstract_generic_index_i(){};
 
-    virtual abstract_undo_session_ptr start_undo_session() = 0;
+    /**
+    * Lazily opens undo state for the revision, it's called before the index is written.
+    * @return true if the index had no undo history before the call
+    */
+    virtual bool start_undo_session(int64_t revision) = 0;
 
-    virtual int64_t revision() const = 0;
-    virtual void set_revision(int64_t revision) = 0;
+    virtual bool enabled() const = 0;
 
-    virtual void undo() = 0;
-    virtual void undo_all() = 0;
-    virtual void squash() = 0;
+    virtual void undo(int64_t revision) = 0;
+    virtual void squash(int64_t revision) = 0;
     virtual void commit(int64_t revision) = 0;
 };
 }
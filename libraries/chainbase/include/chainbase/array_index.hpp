@@ -0,0 +1,350 @@
+#pragma once
+
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/mpl/vector.hpp>
+
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include <fc/shared_containers.hpp>
+
+#include <chainbase/undo_delta.hpp>
+
+namespace chainbase {
+
+/**
+*  Container for objects which are addressed by id only and whose ids are bounded: ring buffers
+*  (e.g. block summaries addressed by block number modulo pool size) and singletons.
+*
+*  The object with id N is stored in the slot N, so lookup is an array access and there are no tree nodes.
+*  Slots are allocated by chunks on first use and never move, references to objects stay valid
+*  like in multi index container.
+*
+*  It may replace a multi index container with the single ordered_unique index by id. It implements
+*  the interface of such an index (find, lower_bound, upper_bound, equal_range, bidirectional and reverse
+*  iterators) and the part of the container interface which is used by generic_index, so it can be passed
+*  to CHAINBASE_SET_INDEX_TYPE and supports undo. Every tag passed to get<>() refers to the id index.
+*  Containers with any other index can't be replaced.
+*
+*  Object type must use field_delta_undo policy, so the undo state keeps only the changed fields
+*  instead of object copies.
+*
+*  Usage:
+*
+*  typedef chainbase::array_index<block_summary_object, 0x10000> block_summary_index;
+*  CHAINBASE_SET_UNDO_POLICY(block_summary_object, chainbase::field_delta_undo)
+*/
+template <typename Object, size_t Capacity> class array_index
+{
+    static_assert(Capacity > 0, "capacity must be positive");
+
+    struct slot
+    {
+        typename std::aligned_storage<sizeof(Object), alignof(Object)>::type storage;
+        bool used = false;
+    };
+
+    static constexpr size_t chunk_size = Capacity < 256 ? Capacity : 256;
+    static constexpr size_t chunks_count = (Capacity + chunk_size - 1) / chunk_size;
+
+    struct chunk
+    {
+        slot slots[chunk_size];
+    };
+
+public:
+    using value_type = Object;
+    using allocator_type = fc::shared_allocator<Object>;
+    using node_type = slot;
+    using index_type_list = boost::mpl::vector0<>;
+
+    class const_iterator
+        : public boost::iterator_facade<const_iterator, const value_type, boost::bidirectional_traversal_tag>
+    {
+    public:
+        const_iterator() = default;
+
+    private:
+        friend class array_index;
+        friend class boost::iterator_core_access;
+
+        const_iterator(const array_index* index, size_t pos)
+            : _index(index)
+            , _pos(pos)
+        {
+        }
+
+        const value_type& dereference() const
+        {
+            return *_index->get_slot_value(_pos);
+        }
+
+        bool equal(const const_iterator& other) const
+        {
+            return _pos == other._pos;
+        }
+
+        void increment()
+        {
+            _pos = _index->next_used(_pos + 1);
+        }
+
+        void decrement()
+        {
+            _pos = _index->prev_used(_pos);
+        }
+
+        const array_index* _index = nullptr;
+        size_t _pos = Capacity;
+    };
+
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    template <typename Allocator>
+    explicit array_index(const Allocator& a)
+        : _allocator(a)
+    {
+        static_assert(std::is_same<typename get_undo_policy<value_type>::type, field_delta_undo>::value,
+                      "array_index requires field_delta_undo policy");
+    }
+
+    array_index(const array_index&) = delete;
+    array_index& operator=(const array_index&) = delete;
+
+    ~array_index()
+    {
+        chunk_allocator al(_allocator);
+        for (auto& ch : _chunks)
+        {
+            if (!ch)
+                continue;
+
+            for (auto& s : ch->slots)
+            {
+                if (s.used)
+                    value_ptr(s)->~value_type();
+            }
+
+            al.deallocate(ch, 1);
+        }
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, next_used(0));
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, Capacity);
+    }
+
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+
+    const_iterator cend() const
+    {
+        return end();
+    }
+
+    const_reverse_iterator rbegin() const
+    {
+        return const_reverse_iterator(end());
+    }
+
+    const_reverse_iterator rend() const
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return _allocator;
+    }
+
+    template <typename Tag> const array_index& get() const
+    {
+        return *this;
+    }
+
+    template <typename CompatibleKey> const_iterator find(const CompatibleKey& key) const
+    {
+        const typename value_type::id_type id(key);
+
+        if (id._id < 0 || (size_t)id._id >= Capacity || !get_slot_value((size_t)id._id))
+            return end();
+
+        return const_iterator(this, (size_t)id._id);
+    }
+
+    template <typename CompatibleKey> const_iterator lower_bound(const CompatibleKey& key) const
+    {
+        const typename value_type::id_type id(key);
+
+        if (id._id < 0)
+            return begin();
+        if ((size_t)id._id >= Capacity)
+            return end();
+
+        return const_iterator(this, next_used((size_t)id._id));
+    }
+
+    template <typename CompatibleKey> const_iterator upper_bound(const CompatibleKey& key) const
+    {
+        const typename value_type::id_type id(key);
+
+        if (id._id < 0)
+            return begin();
+        if ((size_t)id._id >= Capacity)
+            return end();
+
+        return const_iterator(this, next_used((size_t)id._id + 1));
+    }
+
+    template <typename CompatibleKey>
+    std::pair<const_iterator, const_iterator> equal_range(const CompatibleKey& key) const
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+
+    const_iterator iterator_to(const value_type& obj) const
+    {
+        return const_iterator(this, (size_t)obj.id._id);
+    }
+
+    /**
+    *  Object is constructed aside because its slot is known after the constructor sets the id.
+    *  Insertion fails if the id is out of capacity or the slot is occupied.
+    */
+    template <class... Args> std::pair<const_iterator, bool> emplace(Args&&... args)
+    {
+        value_type value(std::forward<Args>(args)...);
+
+        if (value.id._id < 0 || (size_t)value.id._id >= Capacity)
+            return std::make_pair(end(), false);
+
+        const size_t pos = (size_t)value.id._id;
+
+        auto& ch = _chunks[pos / chunk_size];
+        if (!ch)
+        {
+            chunk_allocator al(_allocator);
+            ch = al.allocate(1);
+            ::new (static_cast<void*>(&*ch)) chunk();
+        }
+
+        auto& s = ch->slots[pos % chunk_size];
+        if (s.used)
+            return std::make_pair(const_iterator(this, pos), false);
+
+        new (&s.storage) value_type(std::move(value));
+        s.used = true;
+        ++_size;
+
+        return std::make_pair(const_iterator(this, pos), true);
+    }
+
+    /**
+    *  Same as multi index container does, the object is erased if the modifier throws or changes the id
+    */
+    template <typename Modifier> bool modify(const_iterator position, Modifier&& m)
+    {
+        auto& obj = const_cast<value_type&>(*position);
+        const auto id = obj.id;
+
+        try
+        {
+            m(obj);
+        }
+        catch (...)
+        {
+            erase(position);
+            throw;
+        }
+
+        if (obj.id != id)
+        {
+            erase(position);
+            return false;
+        }
+
+        return true;
+    }
+
+    const_iterator erase(const_iterator position)
+    {
+        auto& s = _chunks[position._pos / chunk_size]->slots[position._pos % chunk_size];
+
+        value_ptr(s)->~value_type();
+        s.used = false;
+        --_size;
+
+        return const_iterator(this, next_used(position._pos + 1));
+    }
+
+private:
+    using chunk_allocator = typename allocator_type::template rebind<chunk>::other;
+    using chunk_ptr = typename chunk_allocator::pointer;
+
+    static value_type* value_ptr(slot& s)
+    {
+        return reinterpret_cast<value_type*>(&s.storage);
+    }
+
+    const value_type* get_slot_value(size_t pos) const
+    {
+        const auto& ch = _chunks[pos / chunk_size];
+        if (!ch || !ch->slots[pos % chunk_size].used)
+            return nullptr;
+
+        return reinterpret_cast<const value_type*>(&ch->slots[pos % chunk_size].storage);
+    }
+
+    size_t next_used(size_t pos) const
+    {
+        while (pos < Capacity)
+        {
+            if (!_chunks[pos / chunk_size])
+                pos = (pos / chunk_size + 1) * chunk_size;
+            else if (!_chunks[pos / chunk_size]->slots[pos % chunk_size].used)
+                ++pos;
+            else
+                return pos;
+        }
+        return Capacity;
+    }
+
+    size_t prev_used(size_t pos) const
+    {
+        while (pos > 0)
+        {
+            --pos;
+            if (!_chunks[pos / chunk_size])
+                pos = pos / chunk_size * chunk_size;
+            else if (_chunks[pos / chunk_size]->slots[pos % chunk_size].used)
+                return pos;
+        }
+        return Capacity;
+    }
+
+    allocator_type _allocator;
+    chunk_ptr _chunks[chunks_count] = {};
+    size_t _size = 0;
+};
+
+} // namespace chainbase
@@ -3,6 +3,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/interprocess/sync/file_lock.hpp>
 
+#include <chainbase/segment_flusher.hpp>
 #include <chainbase/undo_db_state.hpp>
 
 namespace chainbase {
@@ -13,6 +14,8 @@ class database : public undo_db_state
 
     std::unique_ptr<boost::interprocess::managed_mapped_file> _meta;
 
+    std::unique_ptr<segment_flusher> _flusher;
+
 private:
     void check_dir_existance(const boost::filesystem::path& dir, bool read_only);
     void create_meta_file(const boost::filesystem::path& file);
@@ -30,9 +33,44 @@ public:
     static boost::filesystem::path shared_memory_meta_path(const boost::filesystem::path& data_dir);
 
     void open(const boost::filesystem::path& dir, uint32_t write = read_only, uint64_t shared_file_size = 0);
+
+    /**
+    *  Unmaps the segment and drops its indices, they must be added again after the next open.
+    */
     void close();
     void flush();
+
+    /**
+    *  Starts the thread which syncs the segment file on request_flush, see segment_flusher.
+    *  Database must be opened in read_write mode, the thread is stopped by close.
+    */
+    void start_background_flush(const flush_options& options);
+
+    /**
+    *  Schedules the background flush if it's started or flushes synchronously otherwise.
+    *  Caller must hold the write lock, the file gets the state at the moment the lock is released.
+    */
+    void request_flush();
+
+    flush_statistic get_flush_statistic() const;
+
     void wipe(const boost::filesystem::path& dir);
+
+    /**
+    *  Writes every index to the portable snapshot file, see snapshot.hpp for the format.
+    *  Database must have no undo history and all objects must be reflected.
+    *
+    *  @param user_data is stored as is, it's intended to identify the state (e.g. head block)
+    */
+    void write_snapshot(const boost::filesystem::path& file, const std::vector<char>& user_data) const;
+
+    /**
+    *  Loads the snapshot into the database. Every index of the snapshot must be added and be empty,
+    *  indices which are absent in the snapshot are not allowed.
+    *
+    *  @return user data which was passed to write_snapshot
+    */
+    std::vector<char> read_snapshot(const boost::filesystem::path& file);
 };
 
 } // namespace chainbase
@@ -2,8 +2,10 @@
 
 #include <atomic>
 #include <array>
+#include <type_traits>
 #include <typeinfo>
 
+#include <boost/config.hpp>
 #include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
 #include <boost/interprocess/sync/sharable_lock.hpp>
 #include <boost/thread/locks.hpp>
@@ -11,10 +13,16 @@
 #include <fc/exception/exception.hpp>
 #include <fc/scoped_increment.hpp>
 
+#include <chainbase/lock_statistic.hpp>
+
 #ifndef CHAINBASE_NUM_RW_LOCKS
 #define CHAINBASE_NUM_RW_LOCKS 10
 #endif
 
+#ifndef CHAINBASE_MAX_READ_RETRIES
+#define CHAINBASE_MAX_READ_RETRIES 3
+#endif
+
 #define CHAINBASE_REQUIRE_READ_LOCK(t) require_read_lock(__FUNCTION__, typeid(t).name())
 #define CHAINBASE_REQUIRE_WRITE_LOCK(t) require_write_lock(__FUNCTION__, typeid(t).name())
 
@@ -40,6 +48,14 @@ private:
     std::atomic<uint32_t> _current_lock;
 };
 
+//////////////////////////////////////////////////////////////////////////
+/**
+*  Thrown from a read section when a writer is waiting for the lock. FC_CAPTURE_AND_RETHROW and the like
+*  rethrow it as it is. The reader code can still wrap or swallow it, so with_read_lock retries the section
+*  by the interruption mark of the thread, whatever the section returned or threw.
+*/
+FC_DECLARE_EXCEPTION(read_interrupted, 5000000, "read section is interrupted by a writer")
+
 //////////////////////////////////////////////////////////////////////////
 class database_guard
 {
@@ -50,16 +66,54 @@ protected:
     int32_t _write_lock_count = 0;
     bool _enable_require_locking = false;
 
+    bool _writer_priority = false;
+    std::atomic<uint32_t> _pending_writers{ 0 };
+
+    bool _lock_statistic_enabled = false;
+    lock_statistic_collector _lock_statistic;
+
+    static thread_local uint32_t _thread_read_depth;
+    static thread_local bool _thread_read_interruptible;
+    static thread_local bool _thread_read_interrupted;
+
 public:
     virtual ~database_guard();
 
     void set_require_locking(bool enable_require_locking);
 
+    /**
+    *  In this mode writers never wait for readers which are in progress. A reader is interrupted on the next
+    *  database access after a writer came, it releases the lock and is started over when the writer is done.
+    *  Reader is retried CHAINBASE_MAX_READ_RETRIES times, after that it waits for writers as usual, so
+    *  a stream of writes does not starve it. Read sections must have no side effects besides their result.
+    */
+    void set_writer_priority(bool writer_priority);
+
+    /**
+    *  Collects wait and hold times of every lock by call site, it's disabled by default.
+    *  Must be set before the database is accessed by other threads.
+    */
+    void set_lock_statistic(bool enable);
+
+    std::vector<lock_statistic> get_lock_statistic() const;
+
     void require_lock_fail(const char* method, const char* lock_type, const char* tname) const;
 
-    void require_read_lock(const char* method, const char* tname) const;
+    // checks are made by every database access, so they are inlined and the failure is out of line
+    void require_read_lock(const char* method, const char* tname) const
+    {
+        if (BOOST_UNLIKELY(_thread_read_interruptible && _pending_writers.load(std::memory_order_relaxed)))
+            interrupt_read();
+
+        if (BOOST_UNLIKELY(_enable_require_locking & /*_read_only & */ (_read_lock_count <= 0)))
+            require_lock_fail(method, "read", tname);
+    }
 
-    void require_write_lock(const char* method, const char* tname);
+    void require_write_lock(const char* method, const char* tname)
+    {
+        if (BOOST_UNLIKELY(_enable_require_locking & (_write_lock_count <= 0)))
+            require_lock_fail(method, "write", tname);
+    }
 
     void set_read_write_mutex_manager(read_write_mutex_manager* manager);
 
@@ -68,21 +122,24 @@ public:
     {
         FC_ASSERT(_rw_manager);
 
-        read_lock lock(_rw_manager->current_lock(), boost::interprocess::defer_lock_type());
-        SCOPED_INCREMENT(_read_lock_count);
+        // nested section is interrupted together with the outermost one which holds the lock
+        if (!_writer_priority || _thread_read_depth)
+            return read_locked(callback, wait_micro);
 
-        if (!wait_micro)
-        {
-            lock.lock();
-        }
-        else
+        for (uint32_t attempt = 1;; ++attempt)
         {
-            if (!lock.timed_lock(boost::posix_time::microsec_clock::universal_time()
-                                 + boost::posix_time::microseconds(wait_micro)))
-                BOOST_THROW_EXCEPTION(std::runtime_error("unable to acquire lock"));
+            interruptible_read_scope scope(attempt <= CHAINBASE_MAX_READ_RETRIES);
+            try
+            {
+                return read_locked(callback, wait_micro);
+            }
+            catch (...)
+            {
+                // lock is released, the next attempt waits for the writer
+                if (!_thread_read_interrupted)
+                    throw;
+            }
         }
-
-        return callback();
     }
 
     template <typename Lambda>
@@ -95,6 +152,63 @@ public:
 
         write_lock lock(_rw_manager->current_lock(), boost::defer_lock_t());
         SCOPED_INCREMENT(_write_lock_count);
+        lock_timer timer(*this, typeid(Lambda).name(), true);
+
+        {
+            pending_writer_scope pending(_pending_writers);
+
+            if (!wait_micro)
+            {
+                lock.lock();
+            }
+            else
+            {
+                while (!lock.timed_lock(boost::posix_time::microsec_clock::universal_time()
+                                        + boost::posix_time::microseconds(wait_micro)))
+                {
+                    timer.timeout();
+                    _rw_manager->next_lock();
+                    std::cerr << "Lock timeout, moving to lock " << _rw_manager->current_lock_num() << std::endl;
+                    lock = write_lock(_rw_manager->current_lock(), boost::defer_lock_t());
+                }
+            }
+        }
+
+        timer.locked();
+        return callback();
+    }
+
+    /**
+    *  Write lock for background work: it isn't taken if it's busy for wait_micro, then false is returned and
+    *  the caller retries later. Readers are not interrupted for it and it doesn't move to the next lock.
+    */
+    template <typename Lambda> bool try_with_write_lock(Lambda&& callback, uint64_t wait_micro)
+    {
+        FC_ASSERT(_rw_manager);
+
+        write_lock lock(_rw_manager->current_lock(), boost::defer_lock_t());
+        lock_timer timer(*this, typeid(Lambda).name(), true);
+
+        if (!lock.timed_lock(boost::posix_time::microsec_clock::universal_time()
+                             + boost::posix_time::microseconds(wait_micro)))
+        {
+            timer.timeout();
+            return false;
+        }
+
+        SCOPED_INCREMENT(_write_lock_count);
+        timer.locked();
+        callback();
+        return true;
+    }
+
+private:
+    template <typename Lambda> auto read_locked(Lambda& callback, uint64_t wait_micro) -> decltype(callback())
+    {
+        read_lock lock(_rw_manager->current_lock(), boost::interprocess::defer_lock_type());
+        SCOPED_INCREMENT(_read_lock_count);
+        read_depth_scope depth;
+        lock_timer timer(*this, typeid(Lambda).name(), false);
 
         if (!wait_micro)
         {
@@ -102,16 +216,138 @@ public:
         }
         else
         {
-            while (!lock.timed_lock(boost::posix_time::microsec_clock::universal_time()
-                                    + boost::posix_time::microseconds(wait_micro)))
+            if (!lock.timed_lock(boost::posix_time::microsec_clock::universal_time()
+                                 + boost::posix_time::microseconds(wait_micro)))
             {
-                _rw_manager->next_lock();
-                std::cerr << "Lock timeout, moving to lock " << _rw_manager->current_lock_num() << std::endl;
-                lock = write_lock(_rw_manager->current_lock(), boost::defer_lock_t());
+                timer.timeout();
+                BOOST_THROW_EXCEPTION(std::runtime_error("unable to acquire lock"));
             }
         }
 
-        return callback();
+        timer.locked();
+        return call_read_section(callback, std::is_void<decltype(callback())>());
+    }
+
+    // a section which returned after its interruption was swallowed is interrupted again
+    template <typename Lambda> void call_read_section(Lambda& callback, std::true_type)
+    {
+        callback();
+        if (BOOST_UNLIKELY(_thread_read_interrupted))
+            interrupt_read();
+    }
+
+    template <typename Lambda>
+    auto call_read_section(Lambda& callback, std::false_type) -> decltype(callback())
+    {
+        decltype(callback()) result = callback();
+        if (BOOST_UNLIKELY(_thread_read_interrupted))
+            interrupt_read();
+        return std::forward<decltype(callback())>(result);
     }
+
+    BOOST_NOINLINE void interrupt_read() const
+    {
+        _thread_read_interrupted = true;
+        throw read_interrupted();
+    }
+
+    /**
+    *  Measures the lock it's declared after: wait till locked() and hold till the lock is released
+    */
+    class lock_timer
+    {
+        using clock = std::chrono::steady_clock;
+
+    public:
+        lock_timer(database_guard& guard, const char* site, bool write)
+            : _guard(guard)
+            , _site(site)
+            , _write(write)
+            , _enabled(guard._lock_statistic_enabled)
+        {
+            if (_enabled)
+                _start = clock::now();
+        }
+
+        ~lock_timer()
+        {
+            if (!_enabled)
+                return;
+
+            const auto now = clock::now();
+            const auto wait = (_is_locked ? _locked : now) - _start;
+            const auto hold = _is_locked ? now - _locked : clock::duration::zero();
+
+            _guard._lock_statistic.record(_site, _write, to_us(wait), to_us(hold), _is_locked, _timeouts);
+        }
+
+        void locked()
+        {
+            if (_enabled)
+                _locked = clock::now();
+            _is_locked = true;
+        }
+
+        void timeout()
+        {
+            ++_timeouts;
+        }
+
+    private:
+        static uint64_t to_us(clock::duration d)
+        {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        }
+
+        database_guard& _guard;
+        const char* _site;
+        bool _write;
+        bool _enabled;
+        bool _is_locked = false;
+        uint64_t _timeouts = 0;
+        clock::time_point _start;
+        clock::time_point _locked;
+    };
+
+    struct interruptible_read_scope
+    {
+        explicit interruptible_read_scope(bool interruptible)
+        {
+            _thread_read_interruptible = interruptible;
+            _thread_read_interrupted = false;
+        }
+        ~interruptible_read_scope()
+        {
+            _thread_read_interruptible = false;
+            _thread_read_interrupted = false;
+        }
+    };
+
+    struct read_depth_scope
+    {
+        read_depth_scope()
+        {
+            ++_thread_read_depth;
+        }
+        ~read_depth_scope()
+        {
+            --_thread_read_depth;
+        }
+    };
+
+    struct pending_writer_scope
+    {
+        explicit pending_writer_scope(std::atomic<uint32_t>& pending_writers)
+            : _pending_writers(pending_writers)
+        {
+            ++_pending_writers;
+        }
+        ~pending_writer_scope()
+        {
+            --_pending_writers;
+        }
+
+        std::atomic<uint32_t>& _pending_writers;
+    };
 };
 }
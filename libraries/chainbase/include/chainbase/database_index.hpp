@@ -1,13 +1,30 @@
 #pragma once
 
+#include <boost/config.hpp>
 #include <boost/container/flat_map.hpp>
 
+#include <algorithm>
+#include <vector>
+
 #include <chainbase/chain_object.hpp>
 #include <chainbase/database_guard.hpp>
 #include <chainbase/generic_index.hpp>
+#include <chainbase/index_statistic.hpp>
+#include <chainbase/object_observer.hpp>
+#include <chainbase/snapshot.hpp>
 
 namespace chainbase {
 
+/**
+*  Revision of the undo history. It is stored in the segment to survive restart.
+*  Undo history contains revisions (committed, revision].
+*/
+struct undo_revision
+{
+    int64_t revision = 0;
+    int64_t committed = 0;
+};
+
 /**
 *  This class
 */
@@ -25,7 +42,7 @@ public:
 
         const uint16_t type_id = index_type::value_type::type_id;
 
-        if (_index_map.find(type_id) != _index_map.end())
+        if (type_id < _index_table.size() && _index_table[type_id].index)
         {
             std::string type_name = boost::core::demangle(typeid(typename index_type::value_type).name());
             BOOST_THROW_EXCEPTION(std::logic_error(type_name + "::type_id is already in use"));
@@ -35,7 +52,20 @@ public:
 
         idx_ptr->validate();
 
-        _index_map[type_id] = idx_ptr;
+        _snapshot_map[type_id] = make_index_snapshot(
+            *idx_ptr, std::integral_constant<bool, fc::reflector<typename index_type::value_type>::is_defined::value>());
+        _statistic_map[type_id] = make_index_statistic(*idx_ptr);
+
+        if (type_id >= _index_table.size())
+            _index_table.resize(type_id + 1);
+
+        index_slot& slot = _index_table[type_id];
+        slot.index = idx_ptr;
+        slot.undo = idx_ptr;
+        slot.counters = &_statistic_map[type_id]->counters;
+
+        if (static_cast<abstract_generic_index_i*>(idx_ptr)->enabled())
+            _dirty_indices.push_back(idx_ptr);
 
         return *idx_ptr;
     }
@@ -43,56 +73,27 @@ public:
     template <typename MultiIndexType> bool has_index() const
     {
         CHAINBASE_REQUIRE_READ_LOCK(typename MultiIndexType::value_type);
-        typedef generic_index<MultiIndexType> index_type;
-        return _index_map.find((uint16_t)index_type::value_type::type_id) != _index_map.end();
+        const uint16_t type_id = MultiIndexType::value_type::type_id;
+        return type_id < _index_table.size() && _index_table[type_id].index;
     }
 
     template <typename MultiIndexType> const generic_index<MultiIndexType>& get_index() const
     {
         CHAINBASE_REQUIRE_READ_LOCK(typename MultiIndexType::value_type);
-        typedef generic_index<MultiIndexType> index_type;
-        typedef index_type* index_type_ptr;
-
-        if (!has_index<MultiIndexType>())
-        {
-            std::string type_name = boost::core::demangle(typeid(typename index_type::value_type).name());
-            BOOST_THROW_EXCEPTION(std::runtime_error("unable to find index for " + type_name + " in database"));
-        }
-
-        return *index_type_ptr(_index_map.find((uint16_t)index_type::value_type::type_id)->second);
+        return get_typed_index<MultiIndexType>();
     }
 
     template <typename MultiIndexType, typename ByIndex>
     auto get_index() const -> decltype(((generic_index<MultiIndexType>*)(nullptr))->indices().template get<ByIndex>())
     {
         CHAINBASE_REQUIRE_READ_LOCK(typename MultiIndexType::value_type);
-        typedef generic_index<MultiIndexType> index_type;
-        typedef index_type* index_type_ptr;
-
-        if (!has_index<MultiIndexType>())
-        {
-            std::string type_name = boost::core::demangle(typeid(typename index_type::value_type).name());
-            BOOST_THROW_EXCEPTION(std::runtime_error("unable to find index for " + type_name + " in database"));
-        }
-
-        return index_type_ptr(_index_map.find((uint16_t)index_type::value_type::type_id)->second)
-            ->indices()
-            .template get<ByIndex>();
+        return get_typed_index<MultiIndexType>().indices().template get<ByIndex>();
     }
 
     template <typename MultiIndexType> generic_index<MultiIndexType>& get_mutable_index()
     {
         CHAINBASE_REQUIRE_WRITE_LOCK(typename MultiIndexType::value_type);
-        typedef generic_index<MultiIndexType> index_type;
-        typedef index_type* index_type_ptr;
-
-        if (!has_index<MultiIndexType>())
-        {
-            std::string type_name = boost::core::demangle(typeid(typename index_type::value_type).name());
-            BOOST_THROW_EXCEPTION(std::runtime_error("unable to find index for " + type_name + " in database"));
-        }
-
-        return *index_type_ptr(_index_map.find((uint16_t)index_type::value_type::type_id)->second);
+        return get_mutable_index<MultiIndexType>(get_index_slot<MultiIndexType>());
     }
 
     template <typename ObjectType, typename IndexedByType, typename CompatibleKey>
@@ -100,7 +101,7 @@ public:
     {
         CHAINBASE_REQUIRE_READ_LOCK(ObjectType);
         typedef typename get_index_type<ObjectType>::type index_type;
-        const auto& idx = get_index<index_type>().indices().template get<IndexedByType>();
+        const auto& idx = get_typed_index<index_type>().indices().template get<IndexedByType>();
         auto itr = idx.find(std::forward<CompatibleKey>(key));
         if (itr == idx.end())
             return nullptr;
@@ -111,7 +112,7 @@ public:
     {
         CHAINBASE_REQUIRE_READ_LOCK(ObjectType);
         typedef typename get_index_type<ObjectType>::type index_type;
-        const auto& idx = get_index<index_type>().indices();
+        const auto& idx = get_typed_index<index_type>().indices();
         auto itr = idx.find(key);
         if (itr == idx.end())
             return nullptr;
@@ -149,27 +150,158 @@ public:
     {
         CHAINBASE_REQUIRE_WRITE_LOCK(ObjectType);
         typedef typename get_index_type<ObjectType>::type index_type;
-        get_mutable_index<index_type>().modify(obj, m);
+        const index_slot& slot = get_index_slot<index_type>();
+        auto& idx = get_mutable_index<index_type>(slot);
+        auto observer = static_cast<object_observer<ObjectType>*>(slot.observer);
+        if (observer)
+            observer->on_remove(obj, observed_revision());
+        // object is erased if the modifier throws, so it's not added back
+        idx.modify(obj, m);
+        if (observer)
+            observer->on_add(obj, observed_revision());
+        ++slot.counters->modified;
     }
 
     template <typename ObjectType> auto remove(const ObjectType& obj)
     {
         CHAINBASE_REQUIRE_WRITE_LOCK(ObjectType);
         typedef typename get_index_type<ObjectType>::type index_type;
-        return get_mutable_index<index_type>().remove(obj);
+        const index_slot& slot = get_index_slot<index_type>();
+        auto& idx = get_mutable_index<index_type>(slot);
+        if (slot.observer)
+            static_cast<object_observer<ObjectType>*>(slot.observer)->on_remove(obj, observed_revision());
+        ++slot.counters->removed;
+        return idx.remove(obj);
     }
 
     template <typename ObjectType, typename Constructor> const ObjectType& create(Constructor&& con)
     {
         CHAINBASE_REQUIRE_WRITE_LOCK(ObjectType);
         typedef typename get_index_type<ObjectType>::type index_type;
-        return get_mutable_index<index_type>().emplace(std::forward<Constructor>(con));
+        const index_slot& slot = get_index_slot<index_type>();
+        const auto& obj = get_mutable_index<index_type>(slot).emplace(std::forward<Constructor>(con));
+        if (slot.observer)
+            static_cast<object_observer<ObjectType>*>(slot.observer)->on_add(obj, observed_revision());
+        ++slot.counters->created;
+        return obj;
+    }
+
+    /**
+    *  Sets the observer of the index, null resets it. Observer must outlive the index,
+    *  objects restored from a snapshot are not reported.
+    */
+    template <typename ObjectType> void set_observer(object_observer<ObjectType>* observer)
+    {
+        typedef typename get_index_type<ObjectType>::type index_type;
+        get_index_slot<index_type>();
+        _index_table[index_type::value_type::type_id].observer = observer;
+    }
+
+    /**
+    *  Statistic of every added index, see index_statistic.hpp
+    */
+    std::vector<index_statistic> get_index_statistic() const
+    {
+        std::vector<index_statistic> result;
+        result.reserve(_statistic_map.size());
+        for (const auto& item : _statistic_map)
+            result.push_back(item.second->get());
+        return result;
+    }
+
+    /**
+    *  Calls functor(type_id, const index_counters&) for every added index. Unlike get_index_statistic
+    *  it doesn't visit the objects and the undo state, so it can be called on every block.
+    */
+    template <typename Functor> void for_each_index_counters(Functor&& functor) const
+    {
+        for (const auto& item : _statistic_map)
+            functor(item.first, item.second->counters);
     }
 
 protected:
     /**
-    * This is a full map (size 2^16) of all possible index designed for constant time lookup
+    *  Entry of the index table. Pointers are resolved when the index is added, so the hot path
+    *  does no casts between the index interfaces and no map lookups.
+    */
+    struct index_slot
+    {
+        void* index = nullptr; ///< generic_index<MultiIndexType>* of the type_id
+        abstract_generic_index_i* undo = nullptr;
+        index_counters* counters = nullptr;
+        void* observer = nullptr; ///< object_observer<ObjectType>* set by set_observer
+    };
+
+    template <typename MultiIndexType> const index_slot& get_index_slot() const
+    {
+        const uint16_t type_id = MultiIndexType::value_type::type_id;
+        if (BOOST_UNLIKELY(type_id >= _index_table.size() || !_index_table[type_id].index))
+        {
+            std::string type_name = boost::core::demangle(typeid(typename MultiIndexType::value_type).name());
+            BOOST_THROW_EXCEPTION(std::runtime_error("unable to find index for " + type_name + " in database"));
+        }
+        return _index_table[type_id];
+    }
+
+    // callers check the lock
+    template <typename MultiIndexType> const generic_index<MultiIndexType>& get_typed_index() const
+    {
+        return *static_cast<const generic_index<MultiIndexType>*>(get_index_slot<MultiIndexType>().index);
+    }
+
+    template <typename MultiIndexType> generic_index<MultiIndexType>& get_mutable_index(const index_slot& slot)
+    {
+        start_index_undo_session(*slot.undo);
+        return *static_cast<generic_index<MultiIndexType>*>(slot.index);
+    }
+
+    /**
+    * Index gets undo state only when it's written for the first time in the revision
     */
-    boost::container::flat_map<uint16_t, void*> _index_map;
+    void start_index_undo_session(abstract_generic_index_i& idx)
+    {
+        if (_undo_revision && _undo_revision->revision > _undo_revision->committed
+            && idx.start_undo_session(_undo_revision->revision))
+        {
+            _dirty_indices.push_back(&idx);
+        }
+    }
+
+    /// revision changes go to, 0 if they are not undoable
+    int64_t observed_revision() const
+    {
+        return _undo_revision && _undo_revision->revision > _undo_revision->committed ? _undo_revision->revision
+                                                                                      : 0;
+    }
+
+    void remove_clean_indices()
+    {
+        _dirty_indices.erase(std::remove_if(_dirty_indices.begin(), _dirty_indices.end(),
+                                            [](abstract_generic_index_i* idx) { return !idx->enabled(); }),
+                             _dirty_indices.end());
+    }
+
+protected:
+    /**
+    * Indices addressed by type_id, it's sized up to the largest added type_id for constant time lookup
+    */
+    std::vector<index_slot> _index_table;
+
+    /**
+    * Serializers of the indices, null for indices of not reflected objects
+    */
+    boost::container::flat_map<uint16_t, abstract_index_snapshot_ptr> _snapshot_map;
+
+    /**
+    * Memory and operation accounting of the indices, it's kept in the process memory
+    */
+    boost::container::flat_map<uint16_t, abstract_index_statistic_ptr> _statistic_map;
+
+    /**
+    * Indices which have undo history, only they are visited by undo/squash/commit
+    */
+    std::vector<abstract_generic_index_i*> _dirty_indices;
+
+    undo_revision* _undo_revision = nullptr;
 };
 }
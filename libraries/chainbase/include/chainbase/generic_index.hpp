@@ -5,7 +5,8 @@
 
 #include <fc/shared_containers.hpp>
 
-#include <chainbase/undo_session.hpp>
+#include <chainbase/abstract_interfaces.hpp>
+#include <chainbase/undo_delta.hpp>
 
 namespace chainbase {
 
@@ -19,19 +20,23 @@ template <typename MultiIndexType> class base_index
 {
 public:
     using value_type = typename MultiIndexType::value_type;
-    using allocator_type = typename MultiIndexType::allocator_type;
+    // objects and undo state use the segment allocator whatever allocates nodes of the container
+    using allocator_type = fc::shared_allocator<value_type>;
 
     template <typename Allocator>
-    base_index(const Allocator& a)
+    base_index(const Allocator& a, uint32_t size_of_undo_state)
         : _indices(a)
         , _size_of_value_type(sizeof(typename MultiIndexType::node_type))
         , _size_of_this(sizeof(*this))
+        , _size_of_undo_state(size_of_undo_state)
     {
     }
 
-    void validate() const /// What for???
+    /// Sizes are checked when an existing index is opened, undo state is kept in the file as well
+    void validate(uint32_t size_of_undo_state) const
     {
-        if (sizeof(typename MultiIndexType::node_type) != _size_of_value_type || sizeof(*this) != _size_of_this)
+        if (sizeof(typename MultiIndexType::node_type) != _size_of_value_type || sizeof(*this) != _size_of_this
+            || size_of_undo_state != _size_of_undo_state)
             BOOST_THROW_EXCEPTION(std::runtime_error("content of memory does not match data expected by executable"));
     }
 
@@ -56,6 +61,11 @@ public:
         return *ptr;
     }
 
+    typename value_type::id_type next_id() const
+    {
+        return _next_id;
+    }
+
 protected:
     /**
     * Construct a new element in the shared_multi_index_container.
@@ -92,7 +102,7 @@ protected:
 
     allocator_type get_allocator() const noexcept
     {
-        return _indices.get_allocator();
+        return allocator_type(_indices.get_allocator().get_segment_manager());
     }
 
     template <class... Args> const value_type& emplace_(Args&&... args)
@@ -113,6 +123,7 @@ protected:
     MultiIndexType _indices;
     uint32_t _size_of_value_type = 0;
     uint32_t _size_of_this = 0;
+    uint32_t _size_of_undo_state = 0;
 };
 
 //------------------------------------------------------------------------------------------------------//
@@ -123,8 +134,13 @@ class generic_index : public abstract_generic_index_i, public base_index<MultiIn
 public:
     using value_type = typename MultiIndexType::value_type;
     using base_index_type = base_index<MultiIndexType>;
+    using undo_policy_type = typename get_undo_policy<value_type>::type;
 
 private:
+    using field_delta_type = detail::field_delta<value_type>;
+
+    static constexpr size_t tree_node_overhead = 4 * sizeof(void*); ///< parent, left, right and color
+
     //------------------------------------------//
     class undo_state
     {
@@ -132,16 +148,19 @@ private:
         using id_type = typename value_type::id_type;
         using id_type_set = fc::shared_set<id_type>;
         using id_value_type_map = fc::shared_map<id_type, value_type>;
+        using id_delta_map = fc::shared_map<id_type, fc::shared_buffer>;
 
         template <typename T>
         undo_state(const fc::shared_allocator<T>& al)
             : old_values(al)
+            , old_deltas(al)
             , removed_values(al)
             , new_ids(al)
         {
         }
 
         id_value_type_map old_values;
+        id_delta_map old_deltas; ///< used instead of old_values by field_delta_undo policy
         id_value_type_map removed_values;
         id_type_set new_ids;
         id_type old_next_id = 0;
@@ -151,11 +170,16 @@ private:
 public:
     template <typename Allocator>
     generic_index(const Allocator& a)
-        : base_index_type(a)
+        : base_index_type(a, sizeof(undo_state))
         , _stack(a)
     {
     }
 
+    void validate() const
+    {
+        base_index_type::validate(sizeof(undo_state));
+    }
+
     template <typename Constructor> const value_type& emplace(Constructor&& c)
     {
         const value_type& value = base_index_type::emplace(c);
@@ -167,11 +191,7 @@ public:
 
     template <typename Modifier> void modify(const value_type& obj, Modifier&& m)
     {
-        auto unmodified_copy = obj;
-
-        base_index_type::modify(obj, m);
-
-        on_modify(unmodified_copy);
+        modify_(obj, m, undo_policy_type());
     }
 
     auto remove(const value_type& obj)
@@ -181,24 +201,90 @@ public:
         return base_index_type::remove(obj);
     }
 
+    /**
+    *  Creates the object with the id set by the constructor, it's used to load a snapshot
+    *  so undo must be disabled.
+    */
+    template <typename Constructor> const value_type& restore(Constructor&& c)
+    {
+        if (enabled())
+            BOOST_THROW_EXCEPTION(std::logic_error("cannot restore object while there is an undo stack"));
+
+        return base_index_type::emplace_(c, this->get_allocator());
+    }
+
+    void set_next_id(typename value_type::id_type next_id)
+    {
+        if (enabled())
+            BOOST_THROW_EXCEPTION(std::logic_error("cannot set next id while there is an undo stack"));
+
+        this->_next_id = next_id;
+    }
+
+    /**
+    *  Number of revisions in which the index was written and which are not committed yet
+    */
+    size_t undo_depth() const
+    {
+        return _stack.size();
+    }
+
+    /**
+    *  Number of pre-images, deltas and created ids kept by the undo history
+    */
+    size_t undo_size() const
+    {
+        size_t size = 0;
+        for (const auto& state : _stack)
+            size += state.old_values.size() + state.old_deltas.size() + state.removed_values.size()
+                + state.new_ids.size();
+        return size;
+    }
+
+    /**
+    *  Memory taken by the undo history. It's an estimate: tree nodes are counted by their size,
+    *  memory allocated by the objects themselves (strings, containers) is not included.
+    */
+    size_t undo_bytes() const
+    {
+        using value_node = typename undo_state::id_value_type_map::value_type;
+        using delta_node = typename undo_state::id_delta_map::value_type;
+
+        size_t bytes = _stack.size() * sizeof(undo_state);
+        for (const auto& state : _stack)
+        {
+            bytes += (state.old_values.size() + state.removed_values.size()) * (sizeof(value_node) + tree_node_overhead);
+            bytes += state.new_ids.size() * (sizeof(typename value_type::id_type) + tree_node_overhead);
+            bytes += state.old_deltas.size() * (sizeof(delta_node) + tree_node_overhead);
+            for (const auto& delta : state.old_deltas)
+                bytes += delta.second.size();
+        }
+        return bytes;
+    }
+
 private:
     // abstract_generic_index_i interface
-    abstract_undo_session_ptr start_undo_session() override
+    bool start_undo_session(int64_t revision) override
     {
+        if (enabled() && _stack.back().revision == revision)
+            return false;
+
+        const bool was_enabled = enabled();
+
         _stack.emplace_back(this->get_allocator());
         _stack.back().old_next_id = this->_next_id;
-        _stack.back().revision = ++_revision;
+        _stack.back().revision = revision;
 
-        return abstract_undo_session_ptr(new session(*this));
+        return !was_enabled;
     }
 
     /**
-    *  Restores the state to how it was prior to the current session discarding all changes
-    *  made between the last revision and the current revision.
+    *  Restores the state to how it was prior to the revision discarding all changes
+    *  made in the revision. Does nothing if the index was not written in the revision.
     */
-    void undo() override
+    void undo(int64_t revision) override
     {
-        if (!enabled())
+        if (!enabled() || _stack.back().revision != revision)
             return;
 
         const auto& head = _stack.back();
@@ -208,6 +294,8 @@ private:
             base_index_type::modify(this->get(item.second.id), [&](value_type& v) { v = std::move(item.second); });
         }
 
+        undo_deltas(head, undo_policy_type());
+
         for (auto id : head.new_ids)
         {
             base_index_type::remove(this->get(id));
@@ -221,7 +309,6 @@ private:
         }
 
         _stack.pop_back();
-        --_revision;
     }
 
     /**
@@ -229,14 +316,16 @@ private:
     *  recent revision numbers into one revision number (reducing the head revision number)
     *
     *  This method does not change the state of the index, only the state of the undo buffer.
+    *
+    *  If the index was not written in the previous revision, the head state is just relabeled.
     */
-    void squash() override
+    void squash(int64_t revision) override
     {
-        if (!enabled())
+        if (!enabled() || _stack.back().revision != revision)
             return;
-        if (_stack.size() == 1)
+        if (_stack.size() == 1 || _stack[_stack.size() - 2].revision != revision - 1)
         {
-            _stack.pop_front();
+            _stack.back().revision = revision - 1;
             return;
         }
 
@@ -309,6 +398,8 @@ private:
             prev_state.old_values.emplace(std::move(item));
         }
 
+        squash_deltas(state, prev_state, undo_policy_type());
+
         // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
         for (auto id : state.new_ids)
             prev_state.new_ids.insert(id);
@@ -330,6 +421,14 @@ private:
                 prev_state.old_values.erase(obj.second.id);
                 continue;
             }
+            auto dit = prev_state.old_deltas.find(obj.second.id);
+            if (dit != prev_state.old_deltas.end())
+            {
+                // upd(delta) + del(was=Y) -> del(was=Y with delta restored)
+                restore_removed(prev_state, obj.second, dit->second, undo_policy_type());
+                prev_state.old_deltas.erase(dit);
+                continue;
+            }
             // del + del -> N/A
             assert(prev_state.removed_values.find(obj.second.id) == prev_state.removed_values.end());
             // nop + del(was=Y) -> del(was=Y)
@@ -337,7 +436,6 @@ private:
         }
 
         _stack.pop_back();
-        --_revision;
     }
 
     /**
@@ -351,48 +449,135 @@ private:
         }
     }
 
-    /**
-    * Unwinds all undo states
-    */
-    void undo_all() override
+    bool enabled() const override
     {
-        while (enabled())
-            undo();
+        return !_stack.empty();
     }
 
-    void set_revision(int64_t revision) override
-    {
-        if (_stack.size() != 0)
-            BOOST_THROW_EXCEPTION(std::logic_error("cannot set revision while there is an existing undo stack"));
-        _revision = revision;
-    }
+    //////////////////////////////////////////////////////////////////////////
 
-    int64_t revision() const override
+    /**
+    *  Pre-image is needed only once per revision and only if the object was not created in it,
+    *  so it is copied right into the undo state and nothing is copied when undo is disabled.
+    */
+    template <typename Modifier> void modify_(const value_type& obj, Modifier& m, full_object_undo)
     {
-        return _revision;
+        const auto id = obj.id;
+
+        if (enabled())
+        {
+            auto& head = _stack.back();
+
+            if (head.new_ids.find(id) == head.new_ids.end() && head.old_values.find(id) == head.old_values.end())
+                head.old_values.emplace(std::pair<typename value_type::id_type, const value_type&>(id, obj));
+        }
+
+        try
+        {
+            base_index_type::modify(obj, m);
+        }
+        catch (...)
+        {
+            on_modify_failed(id);
+            throw;
+        }
     }
 
-    //////////////////////////////////////////////////////////////////////////
-    bool enabled() const
+    /**
+    *  Pre-image of the fields which are not recorded in the head revision yet is packed into a thread local
+    *  buffer, only the fields which the modifier changed are appended to the delta in the undo state.
+    */
+    template <typename Modifier> void modify_(const value_type& obj, Modifier& m, field_delta_undo)
     {
-        return !_stack.empty();
+        const auto id = obj.id;
+
+        if (!enabled() || _stack.back().new_ids.find(id) != _stack.back().new_ids.end())
+        {
+            try
+            {
+                base_index_type::modify(obj, m);
+            }
+            catch (...)
+            {
+                on_modify_failed(id);
+                throw;
+            }
+            return;
+        }
+
+        auto& head = _stack.back();
+
+        auto itr = head.old_deltas.find(id);
+        detail::scratch_buffer pre_image;
+        field_delta_type::add_pre_image(obj,
+                                        itr != head.old_deltas.end() ? field_delta_type::recorded(itr->second)
+                                                                     : typename field_delta_type::fields_type(),
+                                        pre_image.get());
+
+        try
+        {
+            base_index_type::modify(obj, m);
+        }
+        catch (...)
+        {
+            on_modify_failed(id, pre_image.get());
+            throw;
+        }
+
+        field_delta_type::drop_unchanged(obj, pre_image.get());
+        if (pre_image.get().empty())
+            return;
+
+        if (itr == head.old_deltas.end())
+        {
+            itr = head.old_deltas.emplace(id, fc::shared_buffer(this->get_allocator())).first;
+        }
+        field_delta_type::append(itr->second, pre_image.get());
     }
 
-    void on_modify(const value_type& v)
+    /**
+    *  Multi index container erases the object if modification fails, so it is recorded as removed.
+    */
+    void on_modify_failed(typename value_type::id_type id)
     {
         if (!enabled())
             return;
 
         auto& head = _stack.back();
-
-        if (head.new_ids.find(v.id) != head.new_ids.end())
+        if (head.new_ids.count(id))
+        {
+            head.new_ids.erase(id);
             return;
+        }
 
-        auto itr = head.old_values.find(v.id);
+        auto itr = head.old_values.find(id);
         if (itr != head.old_values.end())
-            return;
+        {
+            head.removed_values.emplace(std::move(*itr));
+            head.old_values.erase(itr);
+        }
+    }
 
-        head.old_values.emplace(std::pair<typename value_type::id_type, const value_type&>(v.id, v));
+    /**
+    *  Object of field_delta_undo policy is restored from its delta and the pre-image of the other fields.
+    */
+    void on_modify_failed(typename value_type::id_type id, const std::vector<char>& pre_image)
+    {
+        auto& head = _stack.back();
+
+        auto ditr = head.old_deltas.find(id);
+        const value_type v(
+            [&](value_type& o) {
+                o.id = id;
+                if (ditr != head.old_deltas.end())
+                    field_delta_type::apply(o, ditr->second);
+                field_delta_type::apply(o, pre_image);
+            },
+            this->get_allocator());
+        head.removed_values.emplace(std::pair<typename value_type::id_type, const value_type&>(id, v));
+
+        if (ditr != head.old_deltas.end())
+            head.old_deltas.erase(ditr);
     }
 
     void on_remove(const value_type& v)
@@ -415,6 +600,14 @@ private:
             return;
         }
 
+        auto ditr = head.old_deltas.find(v.id);
+        if (ditr != head.old_deltas.end())
+        {
+            restore_removed(head, v, ditr->second, undo_policy_type());
+            head.old_deltas.erase(ditr);
+            return;
+        }
+
         if (head.removed_values.count(v.id))
             return;
 
@@ -430,15 +623,63 @@ private:
         head.new_ids.insert(v.id);
     }
 
+    // field_delta_undo policy helpers, no-op for full_object_undo
+
+    void undo_deltas(const undo_state&, full_object_undo)
+    {
+    }
+
+    void undo_deltas(const undo_state& head, field_delta_undo)
+    {
+        for (const auto& item : head.old_deltas)
+        {
+            base_index_type::modify(this->get(item.first),
+                                    [&](value_type& v) { field_delta_type::apply(v, item.second); });
+        }
+    }
+
+    void squash_deltas(undo_state&, undo_state&, full_object_undo)
+    {
+    }
+
+    void squash_deltas(undo_state& state, undo_state& prev_state, field_delta_undo)
+    {
+        for (auto& item : state.old_deltas)
+        {
+            if (prev_state.new_ids.find(item.first) != prev_state.new_ids.end())
+            {
+                // new+upd -> new, type A
+                continue;
+            }
+            auto it = prev_state.old_deltas.find(item.first);
+            if (it != prev_state.old_deltas.end())
+            {
+                // upd(was=X) + upd(was=Y) -> upd(was=X), fields changed only in B are taken from B
+                field_delta_type::merge(it->second, item.second);
+                continue;
+            }
+            // del+upd -> N/A
+            assert(prev_state.removed_values.find(item.first) == prev_state.removed_values.end());
+            // nop+upd(was=Y) -> upd(was=Y), type B
+            prev_state.old_deltas.emplace(std::move(item));
+        }
+    }
+
+    void restore_removed(undo_state&, const value_type&, const fc::shared_buffer&, full_object_undo)
+    {
+    }
+
+    void restore_removed(undo_state& state, const value_type& v, const fc::shared_buffer& delta, field_delta_undo)
+    {
+        auto itr = state.removed_values.emplace(std::pair<typename value_type::id_type, const value_type&>(v.id, v));
+        field_delta_type::apply(itr.first->second, delta);
+    }
+
 private:
     /**
-    *  Each new session increments the revision, a squash will decrement the revision by combining
-    *  the two most recent revisions into one revision.
-    *
-    *  Commit will discard all revisions prior to the committed revision.
+    *  Undo states of the revisions in which the index was written, ordered by revision.
+    *  Revisions are managed by undo_db_state.
     */
-    int64_t _revision = 0;
-
     fc::shared_deque<undo_state> _stack;
 };
 
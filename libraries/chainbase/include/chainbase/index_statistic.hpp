@@ -0,0 +1,103 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <boost/core/demangle.hpp>
+#include <boost/mpl/size.hpp>
+
+#include <fc/reflect/reflect.hpp>
+
+#include <chainbase/generic_index.hpp>
+
+namespace chainbase {
+
+/**
+*  Operations made through the database since it was opened. They are kept in the process memory
+*  so they are not affected by undo.
+*/
+struct index_counters
+{
+    uint64_t created = 0;
+    uint64_t modified = 0;
+    uint64_t removed = 0;
+};
+
+/**
+*  Memory figures are estimates: nodes are counted by their size, memory allocated by the objects
+*  themselves (strings, containers) is not included.
+*/
+struct index_statistic : public index_counters
+{
+    std::string name;
+    uint16_t type_id = 0;
+
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+
+    uint32_t undo_depth = 0;
+    uint64_t undo_size = 0;
+    uint64_t undo_bytes = 0;
+};
+
+struct abstract_index_statistic_i
+{
+    virtual ~abstract_index_statistic_i(){};
+
+    virtual index_statistic get() const = 0;
+
+    index_counters counters;
+};
+
+template <typename MultiIndexType> class index_statistic_collector : public abstract_index_statistic_i
+{
+    using index_type = generic_index<MultiIndexType>;
+    using value_type = typename index_type::value_type;
+
+public:
+    explicit index_statistic_collector(const index_type& index)
+        : _index(index)
+    {
+    }
+
+    index_statistic get() const override
+    {
+        index_statistic result;
+
+        static_cast<index_counters&>(result) = counters;
+
+        result.name = boost::core::demangle(typeid(value_type).name());
+        result.type_id = value_type::type_id;
+
+        result.count = _index.indices().size();
+        result.bytes = result.count * node_size;
+
+        result.undo_depth = _index.undo_depth();
+        result.undo_size = _index.undo_size();
+        result.undo_bytes = _index.undo_bytes();
+
+        return result;
+    }
+
+private:
+    // every index of the container adds its tree node header (parent, left, right and color) to the object
+    static constexpr size_t node_size
+        = sizeof(value_type) + boost::mpl::size<typename MultiIndexType::index_type_list>::value * 4 * sizeof(void*);
+
+    const index_type& _index;
+};
+
+using abstract_index_statistic_ptr = std::unique_ptr<abstract_index_statistic_i>;
+
+template <typename MultiIndexType>
+abstract_index_statistic_ptr make_index_statistic(const generic_index<MultiIndexType>& index)
+{
+    return abstract_index_statistic_ptr(new index_statistic_collector<MultiIndexType>(index));
+}
+
+} // namespace chainbase
+
+FC_REFLECT(chainbase::index_counters, (created)(modified)(removed))
+FC_REFLECT_DERIVED(chainbase::index_statistic,
+                   (chainbase::index_counters),
+                   (name)(type_id)(count)(bytes)(undo_depth)(undo_size)(undo_bytes))
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <fc/reflect/reflect.hpp>
+
+namespace chainbase {
+
+/**
+*  Durations in microseconds, buckets[i] counts durations below 2^i us, the last bucket is unbounded
+*/
+struct lock_histogram
+{
+    uint64_t count = 0;
+    uint64_t total_us = 0;
+    uint64_t max_us = 0;
+    std::vector<uint64_t> buckets;
+};
+
+struct lock_statistic
+{
+    std::string tag; ///< set by lock_tag_scope, empty if the caller is not tagged
+    std::string site; ///< function which took the lock
+    std::string lock; ///< read or write
+
+    uint64_t timeouts = 0; ///< failed timed waits, for a writer each one moves to the next lock
+    lock_histogram wait;
+    lock_histogram hold;
+};
+
+/**
+*  Tags locks taken by the current thread while the scope is alive, e.g. by the p2p block handler.
+*  Tag must be a string literal, it's stored by pointer.
+*/
+class lock_tag_scope
+{
+public:
+    explicit lock_tag_scope(const char* tag);
+    ~lock_tag_scope();
+
+    lock_tag_scope(const lock_tag_scope&) = delete;
+    lock_tag_scope& operator=(const lock_tag_scope&) = delete;
+
+    static const char* current();
+
+private:
+    const char* _prev;
+};
+
+/**
+*  Wait and hold times of database_guard locks grouped by tag and call site. Call site is identified
+*  by the type of the callback passed to with_read_lock/with_write_lock, so it needs no code at the caller.
+*/
+class lock_statistic_collector
+{
+public:
+    static constexpr size_t buckets_count = 24;
+
+    void record(const char* site, bool write, uint64_t wait_us, uint64_t hold_us, bool locked, uint64_t timeouts);
+
+    std::vector<lock_statistic> get() const;
+
+    void clear();
+
+private:
+    struct histogram
+    {
+        uint64_t count = 0;
+        uint64_t total_us = 0;
+        uint64_t max_us = 0;
+        std::array<uint64_t, buckets_count> buckets = {};
+
+        void add(uint64_t us);
+        lock_histogram get() const;
+    };
+
+    struct entry
+    {
+        uint64_t timeouts = 0;
+        histogram wait;
+        histogram hold;
+    };
+
+    // tag, site and lock type, names are pointers to static strings
+    using key = std::tuple<const char*, const char*, bool>;
+
+    mutable std::mutex _mutex;
+    std::map<key, entry> _entries;
+};
+
+} // namespace chainbase
+
+FC_REFLECT(chainbase::lock_histogram, (count)(total_us)(max_us)(buckets))
+FC_REFLECT(chainbase::lock_statistic, (tag)(site)(lock)(timeouts)(wait)(hold))
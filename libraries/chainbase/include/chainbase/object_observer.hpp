@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+namespace chainbase {
+
+/**
+*  Gets objects of the index as they enter and leave it, a modification is seen as remove of the old
+*  state and add of the new one. Revision is the undo revision the change belongs to, 0 if the change
+*  can't be undone.
+*
+*  Changes reverted by undo are not reported, observers get undo/squash/commit through
+*  abstract_revision_listener instead.
+*/
+template <typename ObjectType> struct object_observer
+{
+    virtual ~object_observer()
+    {
+    }
+
+    virtual void on_add(const ObjectType& obj, int64_t revision) = 0;
+    virtual void on_remove(const ObjectType& obj, int64_t revision) = 0;
+};
+
+struct abstract_revision_listener
+{
+    virtual ~abstract_revision_listener()
+    {
+    }
+
+    virtual void on_undo(int64_t revision) = 0;
+    /// revision is merged into revision - 1
+    virtual void on_squash(int64_t revision) = 0;
+    virtual void on_commit(int64_t revision) = 0;
+};
+
+/**
+*  Value aggregated from the observed changes which follows undo history of the database,
+*  e.g. a running sum over an index. T must be default constructible to zero and support += and -=.
+*/
+template <typename T> class revision_journal : public abstract_revision_listener
+{
+public:
+    const T& value() const
+    {
+        return _value;
+    }
+
+    /// drops the history, it's used after the value is recalculated from the database
+    void reset(const T& value)
+    {
+        _value = value;
+        _deltas.clear();
+    }
+
+    void add(const T& delta, int64_t revision)
+    {
+        _value += delta;
+        if (revision)
+            _deltas[revision] += delta;
+    }
+
+    void subtract(const T& delta, int64_t revision)
+    {
+        _value -= delta;
+        if (revision)
+            _deltas[revision] -= delta;
+    }
+
+    void on_undo(int64_t revision) override
+    {
+        auto itr = _deltas.find(revision);
+        if (itr == _deltas.end())
+            return;
+
+        _value -= itr->second;
+        _deltas.erase(itr);
+    }
+
+    void on_squash(int64_t revision) override
+    {
+        auto itr = _deltas.find(revision);
+        if (itr == _deltas.end())
+            return;
+
+        T delta = itr->second;
+        _deltas.erase(itr);
+        _deltas[revision - 1] += delta;
+    }
+
+    void on_commit(int64_t revision) override
+    {
+        _deltas.erase(_deltas.begin(), _deltas.upper_bound(revision));
+    }
+
+private:
+    T _value = T();
+    std::map<int64_t, T> _deltas;
+};
+}
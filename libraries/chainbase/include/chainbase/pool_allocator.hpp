@@ -0,0 +1,232 @@
+#pragma once
+
+#include <boost/interprocess/managed_mapped_file.hpp>
+#include <boost/interprocess/offset_ptr.hpp>
+#include <boost/multi_index_container.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include <fc/reflect/reflect.hpp>
+
+namespace chainbase {
+
+namespace bip = boost::interprocess;
+
+using segment_manager_type = bip::managed_mapped_file::segment_manager;
+
+/**
+*  Simple segregated storage living in the segment. Nodes of one size are carved from slabs
+*  allocated from the segment and are kept in the free list after deallocation, so they are reused
+*  by the same type only and allocation does not search the segment tree.
+*
+*  It's not synchronized: chainbase is written by a single writer under the write lock.
+*/
+class node_pool
+{
+public:
+    static const char* name_prefix()
+    {
+        return "pool:";
+    }
+
+    /// Name of the pool in the segment, it doesn't depend on the build: "pool:<object type id>:<node size>"
+    static std::string name(uint16_t type_id, size_t node_size)
+    {
+        return name_prefix() + std::to_string(type_id) + ":" + std::to_string(node_size);
+    }
+
+    node_pool(segment_manager_type* segment_manager, size_t node_size)
+        : _segment_manager(segment_manager)
+        , _node_size(round_up(std::max(node_size, sizeof(free_node))))
+        , _nodes_per_slab(std::max<size_t>(1, slab_size / _node_size))
+    {
+    }
+
+    node_pool(const node_pool&) = delete;
+    node_pool& operator=(const node_pool&) = delete;
+
+    void* allocate()
+    {
+        if (!_free)
+            allocate_slab();
+
+        free_node* node = _free.get();
+        _free = node->next;
+        --_free_nodes;
+
+        return node;
+    }
+
+    void deallocate(void* p)
+    {
+        free_node* node = static_cast<free_node*>(p);
+        node->next = _free;
+        _free = node;
+        ++_free_nodes;
+    }
+
+    size_t node_size() const
+    {
+        return _node_size;
+    }
+
+    size_t slabs() const
+    {
+        return _slabs;
+    }
+
+    size_t nodes() const
+    {
+        return _slabs * _nodes_per_slab;
+    }
+
+    size_t free_nodes() const
+    {
+        return _free_nodes;
+    }
+
+private:
+    static constexpr size_t slab_size = 64 * 1024;
+
+    struct free_node
+    {
+        bip::offset_ptr<free_node> next;
+    };
+
+    static size_t round_up(size_t size)
+    {
+        constexpr size_t alignment = alignof(std::max_align_t);
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void allocate_slab()
+    {
+        char* slab = static_cast<char*>(_segment_manager->allocate(_nodes_per_slab * _node_size));
+
+        for (size_t i = _nodes_per_slab; i > 0; --i)
+            deallocate(slab + (i - 1) * _node_size);
+
+        ++_slabs;
+    }
+
+    bip::offset_ptr<segment_manager_type> _segment_manager;
+    bip::offset_ptr<free_node> _free;
+    size_t _node_size = 0;
+    size_t _nodes_per_slab = 0;
+    size_t _slabs = 0;
+    size_t _free_nodes = 0;
+};
+
+/**
+*  Free nodes are kept by the pool of the type, they are not available to other types
+*  but are counted by get_free_memory
+*/
+struct pool_statistic
+{
+    uint16_t type_id = 0; ///< type id of the objects of the index
+    uint64_t node_size = 0;
+    uint64_t slabs = 0;
+    uint64_t nodes = 0;
+    uint64_t free_nodes = 0;
+};
+
+/**
+*  Allocator which takes single objects from the node_pool of its type and arrays (e.g. hash buckets)
+*  from the segment. Every type the allocator is rebound to gets its own pool, it's found by name
+*  on the first allocation. The name is made of the type id of Object, the object type of the index,
+*  and the node size, so the pool is found by a build of another compiler too.
+*/
+template <typename T, typename Object = T> class pool_allocator
+{
+public:
+    using value_type = T;
+    using pointer = bip::offset_ptr<T>;
+    using const_pointer = bip::offset_ptr<const T>;
+    using void_pointer = bip::offset_ptr<void>;
+    using reference = T&;
+    using const_reference = const T&;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    template <typename U> struct rebind
+    {
+        using other = pool_allocator<U, Object>;
+    };
+
+    pool_allocator(segment_manager_type* segment_manager)
+        : _segment_manager(segment_manager)
+    {
+    }
+
+    template <typename U>
+    pool_allocator(const pool_allocator<U, Object>& other)
+        : _segment_manager(other.get_segment_manager())
+    {
+    }
+
+    pointer allocate(size_type n)
+    {
+        if (n != 1)
+            return pointer(static_cast<T*>(_segment_manager->allocate(n * sizeof(T))));
+
+        return pointer(static_cast<T*>(get_pool()->allocate()));
+    }
+
+    void deallocate(const pointer& p, size_type n)
+    {
+        if (n != 1)
+            _segment_manager->deallocate(p.get());
+        else
+            get_pool()->deallocate(p.get());
+    }
+
+    size_type max_size() const
+    {
+        return _segment_manager->get_size() / sizeof(T);
+    }
+
+    segment_manager_type* get_segment_manager() const
+    {
+        return _segment_manager.get();
+    }
+
+    template <typename U> bool operator==(const pool_allocator<U, Object>& other) const
+    {
+        return get_segment_manager() == other.get_segment_manager();
+    }
+
+    template <typename U> bool operator!=(const pool_allocator<U, Object>& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    node_pool* get_pool()
+    {
+        if (!_pool)
+        {
+            static const std::string name = node_pool::name(Object::type_id, sizeof(T));
+
+            _pool = _segment_manager->find_or_construct<node_pool>(name.c_str())(_segment_manager.get(), sizeof(T));
+        }
+        return _pool.get();
+    }
+
+    bip::offset_ptr<segment_manager_type> _segment_manager;
+    bip::offset_ptr<node_pool> _pool;
+};
+
+/**
+*  Multi index container whose nodes are allocated from the pool of the object type. It's intended
+*  for indices with high churn, where nodes of different sizes would fragment the segment.
+*  Switching an index to it changes the layout of the file, so the schema version is increased
+*  (see segment_manager::set_schema_version) and existing state is replayed.
+*/
+template <typename T, typename IndexSpecifierList>
+using pooled_multi_index_container = boost::multi_index_container<T, IndexSpecifierList, pool_allocator<T>>;
+
+} // namespace chainbase
+
+FC_REFLECT(chainbase::pool_statistic, (type_id)(node_size)(slabs)(nodes)(free_nodes))
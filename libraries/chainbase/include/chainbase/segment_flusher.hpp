@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fc/reflect/reflect.hpp>
+
+namespace chainbase {
+
+struct flush_options
+{
+    uint64_t chunk_size = 16 * 1024 * 1024; ///< size of the range synced by one msync call
+    uint64_t max_bytes_per_second = 0; ///< throughput limit of the unlocked pass, 0 - unlimited
+    uint64_t lock_wait_us = 100000; ///< the final pass waits this long for the write lock, then it's retried
+};
+
+struct flush_statistic
+{
+    uint64_t flushes = 0;
+    uint64_t bytes = 0; ///< size of the synced ranges, clean pages are not written by the kernel
+
+    uint64_t last_duration_us = 0;
+    uint64_t max_duration_us = 0;
+
+    /// the final pass is made under the write lock, it's what the block processing waits for
+    uint64_t last_locked_duration_us = 0;
+    uint64_t max_locked_duration_us = 0;
+
+    /// times the write lock was busy for the final pass
+    uint64_t lock_retries = 0;
+};
+
+/**
+*  Syncs the mapped segment to disk in a background thread. A flush makes two passes: the first one
+*  syncs the segment by chunks without the lock and with the throughput limit while blocks are applied,
+*  the second one is made under the write lock, so the file gets the state at a block boundary.
+*  The second pass writes only pages dirtied during the first one, so the writer is blocked for short.
+*  The write lock is taken with a bounded wait, so the flusher gives way to the block processing and retries.
+*/
+class segment_flusher
+{
+public:
+    using range = std::pair<char*, size_t>;
+    using ranges_getter = std::function<std::vector<range>()>;
+    /// Calls the callback under the write lock, returns false if the lock wasn't taken in lock_wait_us
+    using lock_wrapper = std::function<bool(const std::function<void()>&, uint64_t)>;
+
+    segment_flusher(ranges_getter ranges, lock_wrapper with_write_lock, const flush_options& options);
+    ~segment_flusher();
+
+    segment_flusher(const segment_flusher&) = delete;
+    segment_flusher& operator=(const segment_flusher&) = delete;
+
+    /**
+    *  Schedules a flush and returns immediately, requests made while a flush is running are merged.
+    *  Caller must hold the write lock: mapped ranges are taken here, the segment could be grown meanwhile.
+    */
+    void request();
+
+    flush_statistic get_statistic() const;
+
+private:
+    void run();
+    void flush(const std::vector<range>& ranges);
+
+    // @return false if the flusher is being stopped
+    bool sync(const std::vector<range>& ranges, bool throttle);
+
+    ranges_getter _ranges;
+    lock_wrapper _with_write_lock;
+    flush_options _options;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _requested = false;
+    std::vector<range> _requested_ranges;
+    bool _stop = false;
+
+    flush_statistic _statistic;
+
+    std::thread _thread;
+};
+
+} // namespace chainbase
+
+FC_REFLECT(chainbase::flush_statistic,
+           (flushes)(bytes)(last_duration_us)(max_duration_us)(last_locked_duration_us)(max_locked_duration_us)(
+               lock_retries))
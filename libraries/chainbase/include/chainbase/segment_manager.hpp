@@ -3,9 +3,39 @@
 #include <boost/filesystem/path.hpp>
 
 #include <chainbase/generic_index.hpp>
+#include <chainbase/pool_allocator.hpp>
 
 namespace chainbase {
 
+/**
+*  Hints for the kernel how to back the mapped segment, they are applied when the segment is opened (Linux only).
+*
+*  Explicit huge pages are used by placing the segment file on a hugetlbfs mount.
+*/
+struct segment_options
+{
+    enum prefault_type
+    {
+        prefault_none,
+        prefault_advise, ///< madvise(MADV_WILLNEED) the used part of the segment
+        prefault_touch ///< read every page of the used part of the segment
+    };
+
+    enum numa_policy
+    {
+        numa_default,
+        numa_interleave, ///< interleave pages over all NUMA nodes
+        numa_bind ///< place pages on numa_node
+    };
+
+    bool huge_pages = false; ///< madvise(MADV_HUGEPAGE), transparent huge pages
+    prefault_type prefault = prefault_none;
+    numa_policy numa = numa_default;
+    uint32_t numa_node = 0;
+
+    uint64_t max_size = 0; ///< size up to which the segment can be grown while it's open, 0 - growth is disabled
+};
+
 class segment_manager
 {
 protected:
@@ -13,11 +43,64 @@ protected:
 
     std::unique_ptr<boost::interprocess::managed_mapped_file> _segment;
 
+    segment_options _segment_options;
+
+    uint32_t _schema_version = 0;
+
+    boost::filesystem::path _segment_file;
+
+    /**
+    *  Address space right after the mapped file is reserved up to segment_options::max_size, so the segment
+    *  is grown in place and pointers to objects stay valid. Grown part is mapped separately from _segment.
+    */
+    char* _reserved_begin = nullptr;
+    size_t _reserved_size = 0;
+    char* _grown_begin = nullptr;
+    size_t _grown_size = 0;
+
 public:
+    /**
+    *  Free memory of the segment and free nodes of the pools, a free node is reused by objects of its type only
+    */
     size_t get_free_memory() const;
 
+    /**
+    *  Bytes of the free nodes kept by the pools of pooled_multi_index_container indices
+    */
+    size_t get_pool_free_memory() const;
+
     size_t get_size() const;
 
+    /**
+    *  Usage of node pools of pooled_multi_index_container indices
+    */
+    std::vector<pool_statistic> get_pool_statistic() const;
+
+    /**
+    * Must be set before the segment is opened
+    */
+    void set_segment_options(const segment_options& options);
+
+    /**
+    *  Version of the layout of the application objects, it's stored in a new segment file together with
+    *  the version of chainbase structures. Existing file of other versions isn't opened, the state has to be
+    *  replayed. Must be set before the segment is opened.
+    */
+    void set_schema_version(uint32_t version);
+
+    /**
+    *  Extends the file and the mapped segment without remapping it. Caller must hold the write lock,
+    *  other processes which map the file have to reopen it to see the new memory.
+    *
+    *  @return false if the growth space is exhausted (segment_options::max_size is reached)
+    */
+    bool grow_segment(uint64_t extra_size);
+
+    /**
+    *  Address ranges the segment file is mapped to: the segment and its grown part
+    */
+    std::vector<std::pair<char*, size_t>> get_mapped_ranges() const;
+
 protected:
     void create_segment_file(const boost::filesystem::path& file, bool read_only, uint64_t shared_file_size);
 
@@ -25,6 +108,11 @@ protected:
 
     void close_segment_file();
 
+    void apply_segment_options();
+
+    void* reserve_growth_space(uint64_t size);
+    void release_growth_space();
+
     template <typename index_type> index_type* allocate_index()
     {
         std::string type_name = boost::core::demangle(typeid(typename index_type::value_type).name());
@@ -46,5 +134,23 @@ protected:
 
         return idx_ptr;
     }
+
+    template <typename object_type> object_type* allocate_object(const char* name)
+    {
+        object_type* obj_ptr = nullptr;
+        if (!_read_only)
+        {
+            obj_ptr = _segment->find_or_construct<object_type>(name)();
+        }
+        else
+        {
+            obj_ptr = _segment->find<object_type>(name).first;
+        }
+
+        if (!obj_ptr)
+            BOOST_THROW_EXCEPTION(std::runtime_error("unable to find " + std::string(name) + " in read only database"));
+
+        return obj_ptr;
+    }
 };
 }
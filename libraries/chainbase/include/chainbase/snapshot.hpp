@@ -0,0 +1,222 @@
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <boost/crc.hpp>
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <chainbase/generic_index.hpp>
+#include <chainbase/undo_delta.hpp>
+
+namespace chainbase {
+
+/**
+*  Snapshot is a portable copy of the database state. Unlike the segment file it does not depend
+*  on the compiler, build or memory layout of objects, so it can be loaded by another binary.
+*
+*  +-------+---------+-----------+---------------+---------------+-----+---------------+
+*  | magic | version | user data | indices count | index section | ... | crc32 of file |
+*  +-------+---------+-----------+---------------+---------------+-----+---------------+
+*
+*  Index section:
+*
+*  +-----------+---------+---------------+-------------+-----------------------+-----+
+*  | type name | next id | objects count | object size | fc::raw packed fields | ... |
+*  +-----------+---------+---------------+-------------+-----------------------+-----+
+*
+*  Integers are little endian, strings and blobs are prefixed with uint32 size. Objects are written
+*  field by field in the order of their FC_REFLECT declaration, so only reflected types can be stored.
+*/
+class snapshot_writer
+{
+public:
+    explicit snapshot_writer(const boost::filesystem::path& file);
+
+    template <typename T> void write(T value)
+    {
+        static_assert(std::is_integral<T>::value, "only integers are supported");
+
+        boost::endian::native_to_little_inplace(value);
+        write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void write(const std::string& value);
+    void write(const std::vector<char>& value);
+
+    /**
+    * Appends the checksum, nothing can be written after this call
+    */
+    void finish();
+
+private:
+    void write(const char* data, size_t size);
+
+    std::ofstream _stream;
+    boost::crc_32_type _crc;
+};
+
+class snapshot_reader
+{
+public:
+    /**
+    * Checks the checksum of the whole file before anything is read
+    */
+    explicit snapshot_reader(const boost::filesystem::path& file);
+
+    template <typename T> T read()
+    {
+        static_assert(std::is_integral<T>::value, "only integers are supported");
+
+        T value;
+        read(reinterpret_cast<char*>(&value), sizeof(value));
+        return boost::endian::little_to_native(value);
+    }
+
+    void read(std::string& value);
+    void read(std::vector<char>& value);
+
+private:
+    void read(char* data, size_t size);
+
+    std::ifstream _stream;
+    uint64_t _remaining = 0;
+};
+
+//------------------------------------------------------------------------------------------------------//
+
+struct abstract_index_snapshot_i
+{
+    virtual ~abstract_index_snapshot_i(){};
+
+    virtual std::string name() const = 0;
+
+    virtual void write(snapshot_writer& writer) const = 0;
+    virtual void read(snapshot_reader& reader) = 0;
+};
+
+namespace detail {
+
+template <typename T> class pack_visitor
+{
+public:
+    pack_visitor(const T& obj, std::vector<char>& data)
+        : _obj(obj)
+        , _data(data)
+    {
+    }
+
+    template <typename Member, class Class, Member(Class::*member)> void operator()(const char*) const
+    {
+        append_packed_field(_obj.*member, _data);
+    }
+
+private:
+    const T& _obj;
+    std::vector<char>& _data;
+};
+
+template <typename T> class unpack_visitor
+{
+public:
+    unpack_visitor(T& obj, fc::datastream<const char*>& ds)
+        : _obj(obj)
+        , _ds(ds)
+    {
+    }
+
+    template <typename Member, class Class, Member(Class::*member)> void operator()(const char*) const
+    {
+        unpack_field(_ds, _obj.*member);
+    }
+
+private:
+    T& _obj;
+    fc::datastream<const char*>& _ds;
+};
+
+} // namespace detail
+
+template <typename MultiIndexType> class index_snapshot : public abstract_index_snapshot_i
+{
+    using index_type = generic_index<MultiIndexType>;
+    using value_type = typename index_type::value_type;
+
+public:
+    explicit index_snapshot(index_type& index)
+        : _index(index)
+    {
+    }
+
+    std::string name() const override
+    {
+        return fc::get_typename<value_type>::name();
+    }
+
+    void write(snapshot_writer& writer) const override
+    {
+        writer.write<int64_t>(_index.next_id()._id);
+        writer.write<uint64_t>(_index.indices().size());
+
+        std::vector<char> data;
+        for (const auto& obj : _index.indices())
+        {
+            data.clear();
+            fc::reflector<value_type>::visit(detail::pack_visitor<value_type>(obj, data));
+            writer.write(data);
+        }
+    }
+
+    void read(snapshot_reader& reader) override
+    {
+        if (!_index.indices().empty())
+            BOOST_THROW_EXCEPTION(std::logic_error("snapshot can be loaded only into empty index " + name()));
+
+        const auto next_id = reader.read<int64_t>();
+        const auto count = reader.read<uint64_t>();
+
+        std::vector<char> data;
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            reader.read(data);
+
+            fc::datastream<const char*> ds(data.data(), data.size());
+            _index.restore(
+                [&](value_type& v) { fc::reflector<value_type>::visit(detail::unpack_visitor<value_type>(v, ds)); });
+
+            if (ds.remaining())
+                BOOST_THROW_EXCEPTION(std::runtime_error("snapshot object does not match " + name()));
+        }
+
+        _index.set_next_id(next_id);
+    }
+
+private:
+    index_type& _index;
+};
+
+using abstract_index_snapshot_ptr = std::unique_ptr<abstract_index_snapshot_i>;
+
+template <typename MultiIndexType>
+abstract_index_snapshot_ptr make_index_snapshot(generic_index<MultiIndexType>& index, std::true_type)
+{
+    return abstract_index_snapshot_ptr(new index_snapshot<MultiIndexType>(index));
+}
+
+/**
+* Objects which are not reflected can't be stored, such index makes the database unsuitable for snapshots
+*/
+template <typename MultiIndexType>
+abstract_index_snapshot_ptr make_index_snapshot(generic_index<MultiIndexType>&, std::false_type)
+{
+    return abstract_index_snapshot_ptr();
+}
+
+} // namespace chainbase
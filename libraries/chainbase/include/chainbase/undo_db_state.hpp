@@ -3,21 +3,69 @@
 #include <chainbase/abstract_interfaces.hpp>
 #include <chainbase/database_index.hpp>
 #include <chainbase/segment_manager.hpp>
+#include <chainbase/undo_session.hpp>
 
 namespace chainbase {
 
-class undo_db_state : public database_index<segment_manager>
+/**
+*  Each new session increments the revision, a squash will decrement the revision by combining
+*  the two most recent revisions into one revision.
+*
+*  Commit will discard all revisions prior to the committed revision.
+*
+*  Indices get undo state lazily (on first write in the revision), so sessions cost nothing for
+*  idle indices and undo/squash/commit visit only indices which have undo history.
+*/
+class undo_db_state : public database_index<segment_manager>, public abstract_undoable_i
 {
 public:
     template <typename Lambda> void for_each_index(Lambda&& functor)
     {
-        for (auto& item : _index_map)
+        for (auto& slot : _index_table)
         {
-            abstract_generic_index_i* index = static_cast<abstract_generic_index_i*>(item.second);
-            functor(*index);
+            if (slot.undo)
+                functor(*slot.undo);
         }
     }
 
     abstract_undo_session_ptr start_undo_session();
+
+    /**
+    *  Restores the state to how it was prior to the current session discarding all changes
+    *  made between the last revision and the current revision.
+    */
+    void undo() override;
+
+    /**
+    * Unwinds all undo states
+    */
+    void undo_all();
+
+    /**
+    *  Merges the change set from the two most recent revisions into one revision
+    */
+    void squash();
+
+    /**
+    * Discards all undo history prior to revision
+    */
+    void commit(int64_t revision);
+
+    int64_t revision() const;
+    void set_revision(int64_t revision);
+
+    /**
+    *  Listener gets undo/squash/commit of revisions, it must outlive the database or be removed
+    */
+    void add_revision_listener(abstract_revision_listener& listener);
+    void remove_revision_listener(abstract_revision_listener& listener);
+
+protected:
+    void open_undo_state();
+    void close_undo_state();
+
+    bool enabled() const;
+
+    std::vector<abstract_revision_listener*> _revision_listeners;
 };
 }
@@ -0,0 +1,442 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/container/small_vector.hpp>
+#include <boost/interprocess/containers/string.hpp>
+#include <boost/interprocess/containers/vector.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/shared_buffer.hpp>
+
+namespace chainbase {
+
+/**
+*  Undo journal policies.
+*
+*  full_object_undo  - undo state stores a full copy of every modified object (default).
+*  field_delta_undo  - undo state stores only the reflected fields which were changed by modify().
+*                      Object type must be reflected with FC_REFLECT and every member must be in the
+*                      reflection list, otherwise its changes are not undone and an object erased by
+*                      a failed modify() is restored without it.
+*
+*  Policy is selected per object type with CHAINBASE_SET_UNDO_POLICY.
+*/
+struct full_object_undo
+{
+};
+
+struct field_delta_undo
+{
+};
+
+template <typename T> struct get_undo_policy
+{
+    typedef full_object_undo type;
+};
+
+namespace detail {
+
+template <typename T> size_t packed_field_size(const T& v)
+{
+    return fc::raw::pack_size(v);
+}
+
+// interprocess containers are packed as their std counterparts but without a temporary copy
+
+template <typename CharT, typename Traits, typename Allocator>
+size_t packed_field_size(const boost::interprocess::basic_string<CharT, Traits, Allocator>& v)
+{
+    return fc::raw::pack_size(fc::unsigned_int((uint32_t)v.size())) + v.size() * sizeof(CharT);
+}
+
+template <typename T, typename Allocator>
+size_t packed_field_size(const boost::interprocess::vector<T, Allocator>& v)
+{
+    size_t size = fc::raw::pack_size(fc::unsigned_int((uint32_t)v.size()));
+    for (const auto& item : v)
+        size += fc::raw::pack_size(item);
+    return size;
+}
+
+template <typename Stream, typename T> void pack_field(Stream& ds, const T& v)
+{
+    fc::raw::pack(ds, v);
+}
+
+template <typename Stream, typename CharT, typename Traits, typename Allocator>
+void pack_field(Stream& ds, const boost::interprocess::basic_string<CharT, Traits, Allocator>& v)
+{
+    fc::raw::pack(ds, fc::unsigned_int((uint32_t)v.size()));
+    if (!v.empty())
+        ds.write((const char*)v.data(), v.size() * sizeof(CharT));
+}
+
+template <typename Stream, typename T, typename Allocator>
+void pack_field(Stream& ds, const boost::interprocess::vector<T, Allocator>& v)
+{
+    fc::raw::pack(ds, fc::unsigned_int((uint32_t)v.size()));
+    for (const auto& item : v)
+        fc::raw::pack(ds, item);
+}
+
+/// Appends the packed field to 'out'
+template <typename T> void append_packed_field(const T& v, std::vector<char>& out)
+{
+    const size_t offset = out.size();
+    out.resize(offset + packed_field_size(v));
+    fc::datastream<char*> ds(out.data() + offset, out.size() - offset);
+    pack_field(ds, v);
+}
+
+template <typename T> void unpack_field(fc::datastream<const char*>& ds, T& v)
+{
+    fc::raw::unpack(ds, v);
+}
+
+template <typename CharT, typename Traits, typename Allocator>
+void unpack_field(fc::datastream<const char*>& ds, boost::interprocess::basic_string<CharT, Traits, Allocator>& v)
+{
+    fc::unsigned_int size;
+    fc::raw::unpack(ds, size);
+    v.resize(size.value);
+    if (size.value)
+        ds.read((char*)&v[0], size.value * sizeof(CharT));
+}
+
+template <typename T, typename Allocator>
+void unpack_field(fc::datastream<const char*>& ds, boost::interprocess::vector<T, Allocator>& v)
+{
+    fc::unsigned_int size;
+    fc::raw::unpack(ds, size);
+    v.clear();
+    v.reserve(size.value);
+    for (uint32_t i = 0; i < size.value; ++i)
+    {
+        T item;
+        fc::raw::unpack(ds, item);
+        v.push_back(std::move(item));
+    }
+}
+
+/**
+*  Thread local buffer which capacity is reused by modifications, a nested modification gets its own one.
+*/
+class scratch_buffer
+{
+public:
+    scratch_buffer()
+    {
+        _buffer.swap(pool());
+        _buffer.clear();
+    }
+
+    ~scratch_buffer()
+    {
+        if (_buffer.capacity() > pool().capacity())
+            _buffer.swap(pool());
+    }
+
+    scratch_buffer(const scratch_buffer&) = delete;
+    scratch_buffer& operator=(const scratch_buffer&) = delete;
+
+    std::vector<char>& get()
+    {
+        return _buffer;
+    }
+
+private:
+    static std::vector<char>& pool()
+    {
+        static thread_local std::vector<char> buffer;
+        return buffer;
+    }
+
+    std::vector<char> _buffer;
+};
+
+/**
+*  Field level delta of a reflected object.
+*
+*  Delta is a sequence of records stored in the shared buffer:
+*
+*  +------------------+---------------+----------------------------+-----+
+*  | field # (uint16) | size (uint32) | fc::raw packed field value | ... |
+*  +------------------+---------------+----------------------------+-----+
+*
+*  Each field occurs once and keeps the value the field had when it was recorded for the first time.
+*  Modification packs the pre-image of the fields which are not in the delta yet into a local buffer, only
+*  the fields which the modifier changed are appended to the shared one.
+*/
+template <typename T> class field_delta
+{
+    using field_num_type = uint16_t;
+    using field_size_type = uint32_t;
+
+    static constexpr size_t header_size = sizeof(field_num_type) + sizeof(field_size_type);
+    static constexpr size_t fields_count = fc::reflector<T>::total_member_count;
+
+    struct record
+    {
+        field_num_type field;
+        const char* data;
+        field_size_type size;
+    };
+
+    using records_type = boost::container::small_vector<record, 8>;
+
+public:
+    /// Fields which have a record in a delta
+    using fields_type = std::bitset<fields_count>;
+
+    static fields_type recorded(const fc::shared_buffer& delta)
+    {
+        fields_type fields;
+        for (const auto& r : parse(delta.data(), delta.size()))
+            fields.set(r.field);
+        return fields;
+    }
+
+    /**
+    *  Packs records of the fields of 'obj' which are not 'recorded' into 'pre_image'.
+    *  Pre-image and delta then hold all fields of the object as they were at the beginning of the revision.
+    */
+    static void add_pre_image(const T& obj, const fields_type& recorded, std::vector<char>& pre_image)
+    {
+        pre_image.clear();
+        fc::reflector<T>::visit(pre_image_visitor(obj, recorded, pre_image));
+    }
+
+    /**
+    *  Drops records of 'pre_image' which are equal to the fields of the modified 'obj'.
+    */
+    static void drop_unchanged(const T& obj, std::vector<char>& pre_image)
+    {
+        scratch_buffer current;
+        size_t size = 0;
+        fc::reflector<T>::visit(drop_unchanged_visitor(obj, pre_image, current.get(), size));
+        pre_image.resize(size);
+    }
+
+    /**
+    *  Appends records of 'pre_image' to 'delta', shared memory is allocated for them only.
+    */
+    static void append(fc::shared_buffer& delta, const std::vector<char>& pre_image)
+    {
+        delta.reserve(delta.size() + pre_image.size());
+        delta.insert(delta.end(), pre_image.begin(), pre_image.end());
+    }
+
+    /**
+    *  Appends records of 'from' which are not in 'into' yet.
+    */
+    static void merge(fc::shared_buffer& into, const fc::shared_buffer& from)
+    {
+        const fields_type fields = recorded(into);
+        const records_type records = parse(from.data(), from.size());
+
+        size_t size = into.size();
+        for (const auto& r : records)
+        {
+            if (!fields.test(r.field))
+                size += header_size + r.size;
+        }
+        into.reserve(size);
+
+        for (const auto& r : records)
+        {
+            if (!fields.test(r.field))
+                append(into, r.field, r.data, r.size);
+        }
+    }
+
+    /**
+    *  Restores recorded fields of 'obj'.
+    */
+    static void apply(T& obj, const fc::shared_buffer& delta)
+    {
+        apply(obj, delta.data(), delta.size());
+    }
+
+    static void apply(T& obj, const std::vector<char>& pre_image)
+    {
+        apply(obj, pre_image.data(), pre_image.size());
+    }
+
+    static bool contains(const fc::shared_buffer& delta, field_num_type field)
+    {
+        return field < fields_count && recorded(delta).test(field);
+    }
+
+private:
+    static records_type parse(const char* pos, size_t size)
+    {
+        records_type records;
+
+        const char* end = pos + size;
+        while (pos < end)
+        {
+            record r;
+            memcpy(&r.field, pos, sizeof(r.field));
+            memcpy(&r.size, pos + sizeof(r.field), sizeof(r.size));
+            r.data = pos + header_size;
+            records.push_back(r);
+
+            pos += header_size + r.size;
+        }
+
+        return records;
+    }
+
+    static void apply(T& obj, const char* data, size_t size)
+    {
+        if (!size)
+            return;
+
+        fc::reflector<T>::visit(apply_visitor(obj, parse(data, size)));
+    }
+
+    static void append(fc::shared_buffer& delta, field_num_type field, const char* data, field_size_type size)
+    {
+        const size_t offset = delta.size();
+        delta.resize(offset + header_size + size);
+
+        char* pos = delta.data() + offset;
+        memcpy(pos, &field, sizeof(field));
+        memcpy(pos + sizeof(field), &size, sizeof(size));
+        if (size)
+            memcpy(pos + header_size, data, size);
+    }
+
+    class pre_image_visitor
+    {
+    public:
+        pre_image_visitor(const T& obj, const fields_type& recorded, std::vector<char>& pre_image)
+            : _obj(obj)
+            , _recorded(recorded)
+            , _pre_image(pre_image)
+        {
+        }
+
+        template <typename Member, class Class, Member(Class::*member)> void operator()(const char*) const
+        {
+            const field_num_type field = _field++;
+
+            if (_recorded.test(field))
+                return;
+
+            const size_t offset = _pre_image.size();
+            _pre_image.resize(offset + header_size);
+            append_packed_field(_obj.*member, _pre_image);
+
+            const field_size_type size = (field_size_type)(_pre_image.size() - offset - header_size);
+            memcpy(_pre_image.data() + offset, &field, sizeof(field));
+            memcpy(_pre_image.data() + offset + sizeof(field), &size, sizeof(size));
+        }
+
+    private:
+        const T& _obj;
+        const fields_type& _recorded;
+        std::vector<char>& _pre_image;
+        mutable field_num_type _field = 0;
+    };
+
+    /**
+    *  Records of the pre-image go in the order of fields, kept ones are moved to the end of the kept part
+    */
+    class drop_unchanged_visitor
+    {
+    public:
+        drop_unchanged_visitor(const T& obj, std::vector<char>& pre_image, std::vector<char>& current, size_t& size)
+            : _obj(obj)
+            , _pre_image(pre_image)
+            , _current(current)
+            , _size(size)
+        {
+        }
+
+        template <typename Member, class Class, Member(Class::*member)> void operator()(const char*) const
+        {
+            const field_num_type field = _field++;
+
+            if (_pos >= _pre_image.size())
+                return;
+
+            record r;
+            memcpy(&r.field, _pre_image.data() + _pos, sizeof(r.field));
+            if (r.field != field)
+                return;
+            memcpy(&r.size, _pre_image.data() + _pos + sizeof(r.field), sizeof(r.size));
+            r.data = _pre_image.data() + _pos + header_size;
+
+            const size_t length = header_size + r.size;
+
+            _current.clear();
+            append_packed_field(_obj.*member, _current);
+
+            if (_current.size() != r.size || memcmp(_current.data(), r.data, r.size))
+            {
+                if (_size != _pos)
+                    memmove(_pre_image.data() + _size, _pre_image.data() + _pos, length);
+                _size += length;
+            }
+
+            _pos += length;
+        }
+
+    private:
+        const T& _obj;
+        std::vector<char>& _pre_image;
+        std::vector<char>& _current;
+        size_t& _size;
+        mutable size_t _pos = 0;
+        mutable field_num_type _field = 0;
+    };
+
+    class apply_visitor
+    {
+    public:
+        apply_visitor(T& obj, const records_type& records)
+            : _obj(obj)
+        {
+            _records.fill(nullptr);
+            for (const auto& r : records)
+                _records[r.field] = &r;
+        }
+
+        template <typename Member, class Class, Member(Class::*member)> void operator()(const char*) const
+        {
+            const record* r = _records[_field++];
+            if (!r)
+                return;
+
+            fc::datastream<const char*> ds(r->data, r->size);
+            unpack_field(ds, _obj.*member);
+        }
+
+    private:
+        T& _obj;
+        std::array<const record*, fields_count> _records;
+        mutable field_num_type _field = 0;
+    };
+};
+
+} // namespace detail
+} // namespace chainbase
+
+/**
+*  This macro must be used at global scope and OBJECT_TYPE must be fully qualified
+*/
+#define CHAINBASE_SET_UNDO_POLICY(OBJECT_TYPE, POLICY_TYPE)                                                            \
+    namespace chainbase {                                                                                              \
+    template <> struct get_undo_policy<OBJECT_TYPE>                                                                    \
+    {                                                                                                                  \
+        typedef POLICY_TYPE type;                                                                                      \
+    };                                                                                                                 \
+    }
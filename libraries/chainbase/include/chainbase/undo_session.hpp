@@ -20,7 +20,7 @@ class session : public abstract_undo_session
     {
         virtual void process_undo(session& ctx)
         {
-            ctx._index.undo();
+            ctx._undoable.undo();
             ctx.transit2<empty_state>();
         }
         virtual void process_push(session& ctx)
@@ -36,8 +36,8 @@ class session : public abstract_undo_session
     }
 
 public:
-    session(abstract_generic_index_i& idx)
-        : _index(idx)
+    session(abstract_undoable_i& undoable)
+        : _undoable(undoable)
     {
         transit2<undo_state>();
     }
@@ -54,7 +54,7 @@ public:
     }
 
 private:
-    abstract_generic_index_i& _index;
+    abstract_undoable_i& _undoable;
     empty_state* _state;
 };
 }
@@ -0,0 +1,93 @@
+#include <chainbase/lock_statistic.hpp>
+
+#include <boost/core/demangle.hpp>
+
+#include <algorithm>
+
+namespace chainbase {
+
+namespace {
+thread_local const char* _thread_lock_tag = nullptr;
+}
+
+lock_tag_scope::lock_tag_scope(const char* tag)
+    : _prev(_thread_lock_tag)
+{
+    _thread_lock_tag = tag;
+}
+
+lock_tag_scope::~lock_tag_scope()
+{
+    _thread_lock_tag = _prev;
+}
+
+const char* lock_tag_scope::current()
+{
+    return _thread_lock_tag;
+}
+
+constexpr size_t lock_statistic_collector::buckets_count;
+
+void lock_statistic_collector::histogram::add(uint64_t us)
+{
+    ++count;
+    total_us += us;
+    max_us = std::max(max_us, us);
+
+    size_t bucket = 0;
+    while (bucket < buckets_count - 1 && us >= (uint64_t(1) << bucket))
+        ++bucket;
+    ++buckets[bucket];
+}
+
+lock_histogram lock_statistic_collector::histogram::get() const
+{
+    lock_histogram result;
+    result.count = count;
+    result.total_us = total_us;
+    result.max_us = max_us;
+    result.buckets.assign(buckets.begin(), buckets.end());
+    return result;
+}
+
+void lock_statistic_collector::record(
+    const char* site, bool write, uint64_t wait_us, uint64_t hold_us, bool locked, uint64_t timeouts)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto& e = _entries[std::make_tuple(lock_tag_scope::current(), site, write)];
+    e.timeouts += timeouts;
+    e.wait.add(wait_us);
+    if (locked)
+        e.hold.add(hold_us);
+}
+
+std::vector<lock_statistic> lock_statistic_collector::get() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<lock_statistic> result;
+    result.reserve(_entries.size());
+    for (const auto& item : _entries)
+    {
+        lock_statistic statistic;
+        if (std::get<0>(item.first))
+            statistic.tag = std::get<0>(item.first);
+        statistic.site = boost::core::demangle(std::get<1>(item.first));
+        statistic.lock = std::get<2>(item.first) ? "write" : "read";
+        statistic.timeouts = item.second.timeouts;
+        statistic.wait = item.second.wait.get();
+        statistic.hold = item.second.hold.get();
+
+        result.push_back(std::move(statistic));
+    }
+    return result;
+}
+
+void lock_statistic_collector::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+}
+
+} // namespace chainbase
@@ -0,0 +1,175 @@
+#include <chainbase/segment_flusher.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace chainbase {
+
+segment_flusher::segment_flusher(ranges_getter ranges, lock_wrapper with_write_lock, const flush_options& options)
+    : _ranges(std::move(ranges))
+    , _with_write_lock(std::move(with_write_lock))
+    , _options(options)
+    , _thread([this]() { run(); })
+{
+}
+
+segment_flusher::~segment_flusher()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+void segment_flusher::request()
+{
+    auto ranges = _ranges();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _requested = true;
+        _requested_ranges = std::move(ranges);
+    }
+    _cv.notify_one();
+}
+
+flush_statistic segment_flusher::get_statistic() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _statistic;
+}
+
+void segment_flusher::run()
+{
+    for (;;)
+    {
+        std::vector<range> ranges;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]() { return _requested || _stop; });
+
+            if (_stop)
+                return;
+
+            _requested = false;
+            ranges.swap(_requested_ranges);
+        }
+
+        try
+        {
+            flush(ranges);
+        }
+        catch (const std::exception& e)
+        {
+            elog("Background flush failed: ${e}", ("e", e.what()));
+        }
+        catch (...)
+        {
+            elog("Background flush failed");
+        }
+    }
+}
+
+void segment_flusher::flush(const std::vector<range>& ranges)
+{
+    using clock = std::chrono::steady_clock;
+
+    const auto start = clock::now();
+
+    if (!sync(ranges, true))
+        return;
+
+    clock::duration locked_duration = clock::duration::zero();
+    bool completed = false;
+    for (;;)
+    {
+        const bool locked = _with_write_lock(
+            [&]() {
+                const auto locked_start = clock::now();
+                // segment could be grown during the first pass
+                completed = sync(_ranges(), false);
+                locked_duration = clock::now() - locked_start;
+            },
+            _options.lock_wait_us);
+
+        if (locked)
+            break;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stop)
+            return;
+        ++_statistic.lock_retries;
+    }
+
+    if (!completed)
+        return;
+
+    const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+    const auto locked = std::chrono::duration_cast<std::chrono::microseconds>(locked_duration).count();
+
+    uint64_t bytes = 0;
+    for (const auto& r : ranges)
+        bytes += r.second;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_statistic.flushes;
+        _statistic.bytes += bytes;
+        _statistic.last_duration_us = duration;
+        _statistic.max_duration_us = std::max<uint64_t>(_statistic.max_duration_us, duration);
+        _statistic.last_locked_duration_us = locked;
+        _statistic.max_locked_duration_us = std::max<uint64_t>(_statistic.max_locked_duration_us, locked);
+    }
+
+    ilog("Flushed shared memory in ${t} ms, writer was blocked for ${l} ms",
+         ("t", duration / 1000)("l", locked / 1000));
+}
+
+bool segment_flusher::sync(const std::vector<range>& ranges, bool throttle)
+{
+    using clock = std::chrono::steady_clock;
+
+    const auto start = clock::now();
+    uint64_t synced = 0;
+
+    for (const auto& r : ranges)
+    {
+        for (size_t offset = 0; offset < r.second; offset += _options.chunk_size)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_stop)
+                    return false;
+            }
+
+            const size_t size = std::min<size_t>(_options.chunk_size, r.second - offset);
+
+#ifdef __linux__
+            if (msync(r.first + offset, size, MS_SYNC))
+                wlog("Could not sync shared memory: ${e}", ("e", strerror(errno)));
+#endif
+            synced += size;
+
+            if (throttle && _options.max_bytes_per_second)
+            {
+                const auto planned = std::chrono::microseconds(synced * 1000000 / _options.max_bytes_per_second);
+                const auto elapsed = clock::now() - start;
+                if (planned > elapsed)
+                    std::this_thread::sleep_for(planned - elapsed);
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace chainbase
@@ -1,8 +1,22 @@
 #include <boost/array.hpp>
+#include <boost/core/ignore_unused.hpp>
 #include <boost/filesystem.hpp>
 #include <fc/exception/exception.hpp>
 #include <chainbase/segment_manager.hpp>
 
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <tuple>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace chainbase {
 
 struct environment_check
@@ -37,6 +51,34 @@ struct environment_check
     bool windows = false;
 };
 
+/**
+*  Layout versions of the objects kept in the file. Chainbase version is increased by every change of
+*  the index and undo state structures.
+*/
+struct schema_check
+{
+    static const uint32_t current_chainbase_version = 1;
+
+    explicit schema_check(uint32_t version)
+        : application_version(version)
+    {
+    }
+
+    friend bool operator==(const schema_check& a, const schema_check& b)
+    {
+        return std::make_tuple(a.chainbase_version, a.application_version)
+            == std::make_tuple(b.chainbase_version, b.application_version);
+    }
+
+    std::string to_string() const
+    {
+        return std::to_string(chainbase_version) + "." + std::to_string(application_version);
+    }
+
+    uint32_t chainbase_version = current_chainbase_version;
+    uint32_t application_version = 0;
+};
+
 //////////////////////////////////////////////////////////////////////////
 
 void segment_manager::create_segment_file(const boost::filesystem::path& file,
@@ -45,6 +87,8 @@ void segment_manager::create_segment_file(const boost::filesystem::path& file,
 {
     ilog("Try to open segment file");
 
+    _segment_file = file;
+
     if (boost::filesystem::exists(file))
     {
         if (read_only)
@@ -62,8 +106,9 @@ void segment_manager::create_segment_file(const boost::filesystem::path& file,
                     BOOST_THROW_EXCEPTION(std::runtime_error("could not grow database file to requested size."));
             }
 
+            void* address = reserve_growth_space(std::max(shared_file_size, existing_file_size));
             _segment.reset(new boost::interprocess::managed_mapped_file(boost::interprocess::open_only,
-                                                                        file.generic_string().c_str()));
+                                                                        file.generic_string().c_str(), address));
         }
 
         _read_only = read_only;
@@ -74,30 +119,301 @@ void segment_manager::create_segment_file(const boost::filesystem::path& file,
             BOOST_THROW_EXCEPTION(
                 std::runtime_error("database created by a different compiler, build, or operating system"));
         }
+
+        // files created before the versions were stored have no check
+        const schema_check expected(_schema_version);
+        auto schema = _segment->find<schema_check>("schema_version");
+        if (!schema.first || !(*schema.first == expected))
+        {
+            BOOST_THROW_EXCEPTION(std::runtime_error(
+                "database has schema version " + (schema.first ? schema.first->to_string() : std::string("unknown"))
+                + " instead of " + expected.to_string() + ", layout of objects is changed, replay required"));
+        }
     }
     else
     {
-        _segment.reset(new boost::interprocess::managed_mapped_file(boost::interprocess::create_only,
-                                                                    file.generic_string().c_str(), shared_file_size));
+        void* address = reserve_growth_space(shared_file_size);
+        _segment.reset(new boost::interprocess::managed_mapped_file(
+            boost::interprocess::create_only, file.generic_string().c_str(), shared_file_size, address));
         _segment->construct<environment_check>("environment")();
+        _segment->construct<schema_check>("schema_version")(_schema_version);
+    }
+
+    apply_segment_options();
+}
+
+void segment_manager::set_segment_options(const segment_options& options)
+{
+    _segment_options = options;
+}
+
+void segment_manager::set_schema_version(uint32_t version)
+{
+    _schema_version = version;
+}
+
+#ifdef __linux__
+namespace {
+
+// numaif.h constants, the syscalls are used directly to avoid linking with libnuma
+const int mpol_default = 0;
+const int mpol_bind = 2;
+const int mpol_interleave = 3;
+
+int set_numa_policy(const segment_options& options, unsigned long& nodemask)
+{
+    switch (options.numa)
+    {
+    case segment_options::numa_interleave:
+        nodemask = ~0ul; // kernel restricts the mask to the nodes with memory
+        return mpol_interleave;
+    case segment_options::numa_bind:
+        FC_ASSERT(options.numa_node < sizeof(nodemask) * 8, "NUMA node ${n} is out of range", ("n", options.numa_node));
+        nodemask = 1ul << options.numa_node;
+        return mpol_bind;
+    default:
+        nodemask = 0;
+        return mpol_default;
     }
 }
+}
+#endif
+
+void segment_manager::apply_segment_options()
+{
+    const auto& options = _segment_options;
+
+    if (!options.huge_pages && options.prefault == segment_options::prefault_none
+        && options.numa == segment_options::numa_default)
+        return;
+
+#ifdef __linux__
+    char* address = static_cast<char*>(_segment->get_address());
+    const size_t size = _segment->get_size();
+
+    if (options.huge_pages && madvise(address, size, MADV_HUGEPAGE))
+        wlog("Could not enable transparent huge pages for segment: ${e}", ("e", strerror(errno)));
+
+    unsigned long nodemask = 0;
+    const int numa_mode = set_numa_policy(options, nodemask);
+    if (numa_mode != mpol_default)
+    {
+        // applies to the pages of shmem/hugetlbfs files, page cache of regular files follows the policy
+        // of the thread which faults the pages, so it is set for the prefault below as well
+        if (syscall(SYS_mbind, address, size, numa_mode, &nodemask, sizeof(nodemask) * 8, 0))
+            wlog("Could not set NUMA policy for segment: ${e}", ("e", strerror(errno)));
+        if (syscall(SYS_set_mempolicy, numa_mode, &nodemask, sizeof(nodemask) * 8))
+            wlog("Could not set NUMA policy for prefault: ${e}", ("e", strerror(errno)));
+    }
+
+    if (options.prefault != segment_options::prefault_none)
+    {
+        // objects are allocated from the beginning of the segment, so its used part is hot
+        const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        const size_t used_size = get_size() - _segment->get_segment_manager()->get_free_memory();
+        const size_t hot_size = std::min(size, (used_size + page_size - 1) / page_size * page_size);
+
+        rusage before;
+        getrusage(RUSAGE_SELF, &before);
+        auto start = std::chrono::steady_clock::now();
+
+        if (options.prefault == segment_options::prefault_advise)
+        {
+            if (madvise(address, hot_size, MADV_WILLNEED))
+                wlog("Could not advise segment prefault: ${e}", ("e", strerror(errno)));
+        }
+        else
+        {
+            volatile char sink = 0;
+            for (size_t offset = 0; offset < hot_size; offset += page_size)
+                sink += address[offset];
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        rusage after;
+        getrusage(RUSAGE_SELF, &after);
+
+        ilog("Segment prefault of ${m}M took ${t} ms, ${minor} minor and ${major} major page faults",
+             ("m", hot_size / (1024 * 1024))("t", elapsed.count())("minor", after.ru_minflt - before.ru_minflt)(
+                 "major", after.ru_majflt - before.ru_majflt));
+    }
+
+    if (numa_mode != mpol_default)
+        syscall(SYS_set_mempolicy, mpol_default, nullptr, 0);
+#else
+    wlog("Segment options are supported on Linux only");
+#endif
+}
+
+/**
+ * Reserves address space for the segment and its growth, the segment is mapped to the beginning of it
+ * @return address to map the segment to or nullptr if growth is disabled
+ */
+void* segment_manager::reserve_growth_space(uint64_t size)
+{
+    if (_segment_options.max_size <= size)
+        return nullptr;
+
+#ifdef __linux__
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size = (size + page_size - 1) / page_size * page_size;
+
+    char* reserved = static_cast<char*>(
+        mmap(nullptr, _segment_options.max_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (reserved == MAP_FAILED)
+    {
+        wlog("Could not reserve address space to grow segment: ${e}", ("e", strerror(errno)));
+        return nullptr;
+    }
+
+    // head of the reservation is released for the segment, the tail is kept for growth
+    munmap(reserved, size);
+
+    _reserved_begin = reserved + size;
+    _reserved_size = _segment_options.max_size - size;
+
+    return reserved;
+#else
+    wlog("Segment growth is supported on Linux only");
+    return nullptr;
+#endif
+}
+
+void segment_manager::release_growth_space()
+{
+#ifdef __linux__
+    if (_grown_size)
+        munmap(_grown_begin, _grown_size);
+    if (_reserved_size)
+        munmap(_reserved_begin, _reserved_size);
+#endif
+    _grown_begin = _reserved_begin = nullptr;
+    _grown_size = _reserved_size = 0;
+}
+
+bool segment_manager::grow_segment(uint64_t extra_size)
+{
+    FC_ASSERT(_segment);
+
+#ifdef __linux__
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    extra_size = std::min<uint64_t>((extra_size + page_size - 1) / page_size * page_size, _reserved_size);
+    if (!extra_size)
+        return false;
+
+    // size of the segment manager includes the grown part
+    const size_t mapped_size = _segment->get_size();
+
+    boost::filesystem::resize_file(_segment_file, mapped_size + extra_size);
+
+    int fd = ::open(_segment_file.generic_string().c_str(), O_RDWR);
+    FC_ASSERT(fd != -1, "Could not open segment file: ${e}", ("e", strerror(errno)));
+
+    // replaces the head of the reservation, so the new memory follows the segment
+    void* extension = mmap(_reserved_begin, extra_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+                           (off_t)mapped_size);
+    ::close(fd);
+
+    FC_ASSERT(extension == _reserved_begin, "Could not map grown segment: ${e}", ("e", strerror(errno)));
+
+    if (_segment_options.huge_pages)
+        madvise(extension, extra_size, MADV_HUGEPAGE);
+
+    if (!_grown_size)
+        _grown_begin = _reserved_begin;
+    _grown_size += extra_size;
+    _reserved_begin += extra_size;
+    _reserved_size -= extra_size;
+
+    _segment->get_segment_manager()->grow(extra_size);
+
+    return true;
+#else
+    boost::ignore_unused(extra_size);
+    return false;
+#endif
+}
 
 void segment_manager::flush_segment_file()
 {
     FC_ASSERT(_segment);
     _segment->flush();
+
+#ifdef __linux__
+    if (_grown_size)
+        msync(_grown_begin, _grown_size, MS_SYNC);
+#endif
+}
+
+std::vector<std::pair<char*, size_t>> segment_manager::get_mapped_ranges() const
+{
+    FC_ASSERT(_segment);
+
+    std::vector<std::pair<char*, size_t>> result;
+    result.emplace_back(static_cast<char*>(_segment->get_address()), _segment->get_size() - _grown_size);
+    if (_grown_size)
+        result.emplace_back(_grown_begin, _grown_size);
+
+    return result;
 }
 
 void segment_manager::close_segment_file()
 {
     _segment.reset();
+
+    release_growth_space();
+}
+
+namespace {
+// calls f(name, pool) for node pools of the segment
+template <typename F> void for_each_pool(const segment_manager_type* manager, F&& f)
+{
+    const std::string prefix = node_pool::name_prefix();
+
+    for (auto it = manager->named_begin(); it != manager->named_end(); ++it)
+    {
+        const std::string name(it->name(), it->name_length());
+        if (name.compare(0, prefix.size(), prefix) == 0)
+            f(name.substr(prefix.size()), *static_cast<const node_pool*>(it->value()));
+    }
+}
 }
 
 size_t segment_manager::get_free_memory() const
 {
     FC_ASSERT(_segment);
-    return _segment->get_segment_manager()->get_free_memory();
+    return _segment->get_segment_manager()->get_free_memory() + get_pool_free_memory();
+}
+
+size_t segment_manager::get_pool_free_memory() const
+{
+    FC_ASSERT(_segment);
+
+    size_t result = 0;
+    for_each_pool(_segment->get_segment_manager(),
+                  [&](const std::string&, const node_pool& pool) { result += pool.free_nodes() * pool.node_size(); });
+
+    return result;
+}
+
+std::vector<pool_statistic> segment_manager::get_pool_statistic() const
+{
+    FC_ASSERT(_segment);
+
+    std::vector<pool_statistic> result;
+
+    for_each_pool(_segment->get_segment_manager(), [&](const std::string& name, const node_pool& pool) {
+        pool_statistic statistic;
+        statistic.type_id = (uint16_t)std::stoul(name);
+        statistic.node_size = pool.node_size();
+        statistic.slabs = pool.slabs();
+        statistic.nodes = pool.nodes();
+        statistic.free_nodes = pool.free_nodes();
+
+        result.push_back(std::move(statistic));
+    });
+
+    return result;
 }
 
 size_t segment_manager::get_size() const
@@ -0,0 +1,99 @@
+#include <boost/filesystem.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <chainbase/snapshot.hpp>
+
+namespace chainbase {
+
+snapshot_writer::snapshot_writer(const boost::filesystem::path& file)
+    : _stream(file.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc)
+{
+    if (!_stream)
+        BOOST_THROW_EXCEPTION(std::runtime_error("could not create snapshot file " + file.generic_string()));
+}
+
+void snapshot_writer::write(const std::string& value)
+{
+    write<uint32_t>(value.size());
+    write(value.data(), value.size());
+}
+
+void snapshot_writer::write(const std::vector<char>& value)
+{
+    write<uint32_t>(value.size());
+    write(value.data(), value.size());
+}
+
+void snapshot_writer::finish()
+{
+    uint32_t checksum = boost::endian::native_to_little(_crc.checksum());
+    _stream.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    _stream.flush();
+
+    if (!_stream)
+        BOOST_THROW_EXCEPTION(std::runtime_error("could not write snapshot file"));
+}
+
+void snapshot_writer::write(const char* data, size_t size)
+{
+    _crc.process_bytes(data, size);
+    _stream.write(data, size);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+snapshot_reader::snapshot_reader(const boost::filesystem::path& file)
+    : _stream(file.generic_string(), std::ios::in | std::ios::binary)
+{
+    if (!_stream)
+        BOOST_THROW_EXCEPTION(std::runtime_error("could not open snapshot file " + file.generic_string()));
+
+    const uint64_t file_size = boost::filesystem::file_size(file);
+    if (file_size < sizeof(uint32_t))
+        BOOST_THROW_EXCEPTION(std::runtime_error("snapshot file is truncated"));
+
+    _remaining = file_size - sizeof(uint32_t);
+
+    boost::crc_32_type crc;
+    std::vector<char> buffer(1024 * 1024);
+    for (uint64_t left = _remaining; left > 0;)
+    {
+        const size_t size = (size_t)std::min<uint64_t>(left, buffer.size());
+        _stream.read(buffer.data(), size);
+        crc.process_bytes(buffer.data(), size);
+        left -= size;
+    }
+
+    uint32_t checksum = 0;
+    _stream.read(reinterpret_cast<char*>(&checksum), sizeof(checksum));
+
+    if (!_stream || boost::endian::little_to_native(checksum) != crc.checksum())
+        BOOST_THROW_EXCEPTION(std::runtime_error("snapshot file is corrupted, checksum mismatch"));
+
+    _stream.seekg(0);
+}
+
+void snapshot_reader::read(std::string& value)
+{
+    value.resize(read<uint32_t>());
+    read(&value[0], value.size());
+}
+
+void snapshot_reader::read(std::vector<char>& value)
+{
+    value.resize(read<uint32_t>());
+    read(value.data(), value.size());
+}
+
+void snapshot_reader::read(char* data, size_t size)
+{
+    if (size > _remaining)
+        BOOST_THROW_EXCEPTION(std::runtime_error("unexpected end of snapshot file"));
+
+    _stream.read(data, size);
+    _remaining -= size;
+
+    if (!_stream)
+        BOOST_THROW_EXCEPTION(std::runtime_error("could not read snapshot file"));
+}
+}
@@ -2,12 +2,16 @@
 
 #include <boost/test/unit_test.hpp>
 #include <chainbase/chainbase.hpp>
+#include <chainbase/array_index.hpp>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/member.hpp>
 
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <thread>
 
 using namespace boost::multi_index;
 
@@ -30,6 +34,74 @@ typedef fc::shared_multi_index_container<book,
 
 CHAINBASE_SET_INDEX_TYPE(book, book_index)
 
+struct article : public chainbase::object<1, article>
+{
+    CHAINBASE_DEFAULT_DYNAMIC_CONSTRUCTOR(article, (title)(body))
+
+    id_type id;
+    int votes = 0;
+    fc::shared_string title;
+    fc::shared_string body;
+};
+
+typedef fc::shared_multi_index_container<article,
+                                         indexed_by<ordered_unique<member<article, article::id_type, &article::id>>,
+                                                    ordered_non_unique<BOOST_MULTI_INDEX_MEMBER(article, int, votes)>>>
+    article_index;
+
+FC_REFLECT(article, (id)(votes)(title)(body))
+
+CHAINBASE_SET_INDEX_TYPE(article, article_index)
+CHAINBASE_SET_UNDO_POLICY(article, chainbase::field_delta_undo)
+
+struct summary : public chainbase::object<2, summary>
+{
+    CHAINBASE_DEFAULT_CONSTRUCTOR(summary)
+
+    id_type id;
+    int value = 0;
+};
+
+// spans several chunks
+typedef chainbase::array_index<summary, 300> summary_index;
+
+FC_REFLECT(summary, (id)(value))
+
+CHAINBASE_SET_INDEX_TYPE(summary, summary_index)
+CHAINBASE_SET_UNDO_POLICY(summary, chainbase::field_delta_undo)
+
+struct ticket : public chainbase::object<3, ticket>
+{
+    CHAINBASE_DEFAULT_DYNAMIC_CONSTRUCTOR(ticket, (owner))
+
+    id_type id;
+    int expiration = 0;
+    fc::shared_string owner;
+};
+
+typedef chainbase::pooled_multi_index_container<ticket,
+                                                indexed_by<ordered_unique<member<ticket, ticket::id_type, &ticket::id>>,
+                                                           ordered_non_unique<BOOST_MULTI_INDEX_MEMBER(
+                                                               ticket, int, expiration)>>>
+    ticket_index;
+
+CHAINBASE_SET_INDEX_TYPE(ticket, ticket_index)
+
+// type ids of plugins are in their own spaces
+struct plugin_note : public chainbase::object<(12 << 8) + 1, plugin_note>
+{
+    CHAINBASE_DEFAULT_CONSTRUCTOR(plugin_note)
+
+    id_type id;
+    int value = 0;
+};
+
+typedef fc::shared_multi_index_container<plugin_note,
+                                         indexed_by<ordered_unique<member<plugin_note, plugin_note::id_type, &plugin_note::id>>>>
+    plugin_note_index;
+
+CHAINBASE_SET_INDEX_TYPE(plugin_note, plugin_note_index)
+
 class moc_database : public chainbase::database
 {
     typedef chainbase::database _Base;
@@ -39,11 +111,6 @@ public:
     {
     }
 
-    void undo()
-    {
-        for_each_index([&](chainbase::abstract_generic_index_i& item) { item.undo(); });
-    }
-
     // TODO (if chainbase::database became private)
 };
 
@@ -146,4 +213,933 @@ BOOST_AUTO_TEST_CASE(open_and_create)
     }
 }
 
+// opened database with one article, the article is large enough to make copies of it noticeable
+struct article_db_fixture
+{
+    article_db_fixture()
+        : temp(boost::filesystem::unique_path())
+    {
+        db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+        db.add_index<article_index>();
+
+        db.create<article>([](article& a) {
+            a.votes = 1;
+            a.title = "title";
+            a.body = std::string(1024, 'x').c_str();
+        });
+    }
+
+    ~article_db_fixture()
+    {
+        db.close();
+        boost::filesystem::remove_all(temp);
+    }
+
+    const article& get()
+    {
+        return db.get(article::id_type(0));
+    }
+
+    void check_initial()
+    {
+        BOOST_REQUIRE_EQUAL(get().votes, 1);
+        BOOST_REQUIRE_EQUAL(get().title, "title");
+        BOOST_REQUIRE_EQUAL(get().body, std::string(1024, 'x').c_str());
+    }
+
+    boost::filesystem::path temp;
+    moc_database db;
+};
+
+BOOST_FIXTURE_TEST_CASE(delta_undo_restores_changed_fields, article_db_fixture)
+{
+    {
+        auto session = db.start_undo_session();
+        db.modify(get(), [](article& a) { a.votes = 2; });
+        db.modify(get(), [](article& a) {
+            a.votes = 3;
+            a.title = "new title";
+        });
+
+        BOOST_REQUIRE_EQUAL(get().votes, 3);
+        BOOST_REQUIRE_EQUAL(get().title, "new title");
+    }
+    check_initial();
+}
+
+BOOST_FIXTURE_TEST_CASE(delta_undo_after_squash, article_db_fixture)
+{
+    auto outer = db.start_undo_session();
+    db.modify(get(), [](article& a) { a.votes = 2; });
+    {
+        auto inner = db.start_undo_session();
+        db.modify(get(), [](article& a) {
+            a.votes = 3;
+            a.body = "body";
+        });
+        db.squash();
+        inner->push();
+    }
+    BOOST_REQUIRE_EQUAL(get().votes, 3);
+    BOOST_REQUIRE_EQUAL(get().body, "body");
+
+    db.undo();
+    outer->push();
+    check_initial();
+}
+
+BOOST_FIXTURE_TEST_CASE(delta_undo_modify_then_remove, article_db_fixture)
+{
+    {
+        auto session = db.start_undo_session();
+        db.modify(get(), [](article& a) { a.title = "changed"; });
+        db.remove(get());
+        BOOST_CHECK_THROW(get(), std::out_of_range);
+    }
+    check_initial();
+
+    auto outer = db.start_undo_session();
+    db.modify(get(), [](article& a) { a.title = "changed"; });
+    {
+        auto inner = db.start_undo_session();
+        db.modify(get(), [](article& a) { a.votes = 5; });
+        db.remove(get());
+        db.squash();
+        inner->push();
+    }
+    BOOST_CHECK_THROW(get(), std::out_of_range);
+
+    db.undo();
+    outer->push();
+    check_initial();
+}
+
+BOOST_FIXTURE_TEST_CASE(delta_undo_commit, article_db_fixture)
+{
+    int64_t revision = 0;
+    {
+        auto session = db.start_undo_session();
+        db.modify(get(), [](article& a) { a.votes = 2; });
+        revision = db.revision();
+        session->push();
+    }
+    db.commit(revision);
+    db.undo();
+    BOOST_REQUIRE_EQUAL(get().votes, 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(lazy_undo_sessions, article_db_fixture)
+{
+    db.add_index<book_index>();
+    const auto& new_book = db.create<book>([](book& b) { b.a = 1; });
+
+    const int64_t initial_revision = db.revision();
+    {
+        auto idle = db.start_undo_session();
+        BOOST_REQUIRE_EQUAL(db.revision(), initial_revision + 1);
+    }
+    BOOST_REQUIRE_EQUAL(db.revision(), initial_revision);
+
+    auto outer = db.start_undo_session();
+    db.modify(new_book, [](book& b) { b.a = 2; });
+    {
+        auto inner = db.start_undo_session();
+        db.modify(get(), [](article& a) { a.votes = 2; }); // book index is idle in this revision
+        db.squash();
+        inner->push();
+    }
+    BOOST_REQUIRE_EQUAL(db.revision(), initial_revision + 1);
+    BOOST_REQUIRE_EQUAL(new_book.a, 2);
+    BOOST_REQUIRE_EQUAL(get().votes, 2);
+
+    db.undo();
+    outer->push();
+
+    BOOST_REQUIRE_EQUAL(db.revision(), initial_revision);
+    BOOST_REQUIRE_EQUAL(new_book.a, 1);
+    check_initial();
+}
+
+BOOST_FIXTURE_TEST_CASE(undo_restores_object_erased_by_failed_modify, article_db_fixture)
+{
+    db.add_index<book_index>();
+    db.create<book>([](book& b) { b.a = 1; });
+
+    auto fail = [](auto&) { throw std::runtime_error("modify failed"); };
+    {
+        auto session = db.start_undo_session();
+        db.modify(db.get(book::id_type(0)), [](book& b) { b.a = 2; });
+
+        BOOST_CHECK_THROW(db.modify(db.get(book::id_type(0)), fail), std::runtime_error);
+        BOOST_CHECK_THROW(db.modify(get(), fail), std::runtime_error);
+
+        BOOST_CHECK_THROW(db.get(book::id_type(0)), std::out_of_range);
+        BOOST_CHECK_THROW(get(), std::out_of_range);
+    }
+    BOOST_REQUIRE_EQUAL(db.get(book::id_type(0)).a, 1);
+    check_initial();
+}
+
+BOOST_FIXTURE_TEST_CASE(delta_undo_restores_object_erased_by_failed_modify, article_db_fixture)
+{
+    {
+        auto session = db.start_undo_session();
+        db.modify(get(), [](article& a) { a.votes = 2; });
+        // unchanged fields are not kept in the delta
+        db.modify(get(), [](article& a) { a.votes = 2; });
+
+        BOOST_CHECK_THROW(db.modify(get(),
+                                    [](article& a) {
+                                        a.title = "changed";
+                                        throw std::runtime_error("modify failed");
+                                    }),
+                          std::runtime_error);
+        BOOST_CHECK_THROW(get(), std::out_of_range);
+    }
+    check_initial();
+}
+
+BOOST_FIXTURE_TEST_CASE(delta_undo_keeps_changed_fields_only, article_db_fixture)
+{
+    const auto& index = db.get_index<article_index>();
+    {
+        auto session = db.start_undo_session();
+        db.modify(get(), [](article&) {});
+        BOOST_CHECK_EQUAL(index.undo_size(), 0u);
+
+        db.modify(get(), [](article& a) { a.votes = 2; });
+        BOOST_CHECK_EQUAL(index.undo_size(), 1u);
+        // body is not kept
+        BOOST_CHECK_LT(index.undo_bytes(), 1024u);
+
+        // erased object is restored from the delta and the pre-image of the other fields
+        BOOST_CHECK_THROW(db.modify(get(),
+                                    [](article& a) {
+                                        a.body = "changed";
+                                        throw std::runtime_error("modify failed");
+                                    }),
+                          std::runtime_error);
+        BOOST_CHECK_THROW(get(), std::out_of_range);
+    }
+    check_initial();
+
+    {
+        auto session = db.start_undo_session();
+        BOOST_CHECK_THROW(db.modify(get(),
+                                    [](article& a) {
+                                        a.title = "changed";
+                                        throw std::runtime_error("modify failed");
+                                    }),
+                          std::runtime_error);
+        BOOST_CHECK_THROW(get(), std::out_of_range);
+    }
+    check_initial();
+}
+
+BOOST_FIXTURE_TEST_CASE(snapshot_roundtrip, article_db_fixture)
+{
+    for (int i = 1; i < 10; ++i)
+    {
+        db.create<article>([&](article& a) {
+            a.votes = i;
+            a.title = std::to_string(i).c_str();
+        });
+    }
+    db.remove(db.get(article::id_type(5)));
+
+    const boost::filesystem::path snapshot = temp / "snapshot.bin";
+    db.write_snapshot(snapshot, { 'u', 's', 'e', 'r' });
+
+    const boost::filesystem::path temp2 = boost::filesystem::unique_path();
+    {
+        moc_database db2;
+        db2.open(temp2, chainbase::database::read_write, 1024 * 1024 * 8);
+        db2.add_index<article_index>();
+
+        BOOST_REQUIRE(db2.read_snapshot(snapshot) == std::vector<char>({ 'u', 's', 'e', 'r' }));
+
+        const auto& articles = db.get_index<article_index>().indices();
+        const auto& loaded = db2.get_index<article_index>().indices();
+
+        BOOST_REQUIRE_EQUAL(loaded.size(), articles.size());
+        BOOST_CHECK(db2.find(article::id_type(5)) == nullptr);
+        for (const auto& a : articles)
+        {
+            const auto& b = db2.get(a.id);
+            BOOST_CHECK_EQUAL(a.votes, b.votes);
+            BOOST_CHECK_EQUAL(a.title, b.title);
+            BOOST_CHECK_EQUAL(a.body, b.body);
+        }
+
+        const auto& created = db2.create<article>([](article&) {});
+        BOOST_CHECK(created.id == article::id_type(10));
+
+        db2.close();
+    }
+    boost::filesystem::remove_all(temp2);
+}
+
+BOOST_FIXTURE_TEST_CASE(snapshot_requires_reflected_objects, article_db_fixture)
+{
+    db.add_index<book_index>();
+
+    BOOST_CHECK_THROW(db.write_snapshot(temp / "snapshot.bin", {}), std::logic_error);
+}
+
+BOOST_FIXTURE_TEST_CASE(writer_priority_interrupts_readers, article_db_fixture)
+{
+    db.set_writer_priority(true);
+
+    std::atomic<int> attempts{ 0 };
+    std::atomic<bool> written{ false };
+
+    std::thread reader([&]() {
+        db.with_read_lock([&]() {
+            ++attempts;
+            while (!written)
+            {
+                // reader is interrupted here as soon as the writer comes
+                db.find(article::id_type(0));
+            }
+        });
+    });
+
+    while (!attempts)
+        std::this_thread::yield();
+
+    db.with_write_lock([&]() {
+        db.modify(get(), [](article& a) { a.votes = 2; });
+        written = true;
+    });
+
+    reader.join();
+
+    BOOST_REQUIRE_EQUAL(attempts, 2);
+    BOOST_REQUIRE_EQUAL(get().votes, 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(interrupted_reader_is_retried_after_its_error_handling, article_db_fixture)
+{
+    db.set_writer_priority(true);
+
+    std::atomic<int> attempts{ 0 };
+    std::atomic<bool> written{ false };
+
+    int votes = 0;
+    std::thread reader([&]() {
+        votes = db.with_read_lock([&]() {
+            ++attempts;
+            try
+            {
+                while (!written)
+                    db.find(article::id_type(0));
+                return db.get(article::id_type(0)).votes;
+            }
+            catch (...)
+            {
+                // reader error handling hides the interruption
+                return -1;
+            }
+        });
+    });
+
+    while (!attempts)
+        std::this_thread::yield();
+
+    db.with_write_lock([&]() {
+        db.modify(get(), [](article& a) { a.votes = 2; });
+        written = true;
+    });
+
+    reader.join();
+
+    BOOST_REQUIRE_EQUAL(attempts, 2);
+    BOOST_REQUIRE_EQUAL(votes, 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(lock_statistic_by_call_site, article_db_fixture)
+{
+    db.set_lock_statistic(true);
+
+    std::atomic<bool> locked{ false };
+
+    std::thread writer([&]() {
+        chainbase::lock_tag_scope tag("writer");
+        db.with_write_lock([&]() {
+            locked = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        });
+    });
+
+    while (!locked)
+        std::this_thread::yield();
+
+    auto read = [&]() { return db.with_read_lock([&]() { return get().votes; }); };
+    read();
+    read();
+
+    writer.join();
+
+    auto statistic = db.get_lock_statistic();
+    BOOST_REQUIRE_EQUAL(statistic.size(), 2u);
+
+    auto reads = std::find_if(statistic.begin(), statistic.end(), [](auto& s) { return s.lock == "read"; });
+    auto writes = std::find_if(statistic.begin(), statistic.end(), [](auto& s) { return s.lock == "write"; });
+    BOOST_REQUIRE(reads != statistic.end() && writes != statistic.end());
+
+    BOOST_CHECK(reads->tag.empty());
+    BOOST_CHECK_EQUAL(reads->wait.count, 2u);
+    BOOST_CHECK_EQUAL(reads->hold.count, 2u);
+    // the first read waited for the writer
+    BOOST_CHECK_GE(reads->wait.max_us, 10000u);
+    BOOST_CHECK_EQUAL(reads->wait.buckets.size(), chainbase::lock_statistic_collector::buckets_count);
+
+    BOOST_CHECK_EQUAL(writes->tag, "writer");
+    BOOST_CHECK_EQUAL(writes->hold.count, 1u);
+    BOOST_CHECK_GE(writes->hold.total_us, 20000u);
+    BOOST_CHECK_NE(writes->site.find("lock_statistic_by_call_site"), std::string::npos);
+
+    db.set_lock_statistic(false);
+    read();
+    BOOST_CHECK(db.get_lock_statistic().empty());
+}
+
+BOOST_AUTO_TEST_CASE(open_with_segment_options)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    try
+    {
+        chainbase::segment_options options;
+        options.huge_pages = true;
+        options.prefault = chainbase::segment_options::prefault_touch;
+        options.numa = chainbase::segment_options::numa_interleave;
+
+        moc_database db;
+        db.set_segment_options(options);
+        db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+        db.add_index<book_index>();
+
+        const auto& new_book = db.create<book>([](book& b) { b.a = 3; });
+        BOOST_REQUIRE_EQUAL(new_book.a, 3);
+
+        db.close();
+        boost::filesystem::remove_all(temp);
+    }
+    catch (...)
+    {
+        boost::filesystem::remove_all(temp);
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(open_requires_same_schema_version)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    try
+    {
+        {
+            moc_database db;
+            db.set_schema_version(1);
+            db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+            db.add_index<book_index>();
+            db.create<book>([](book& b) { b.a = 3; });
+            db.close();
+        }
+        {
+            moc_database db;
+            db.set_schema_version(1);
+            db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+            db.add_index<book_index>();
+            BOOST_REQUIRE_EQUAL(db.get(book::id_type(0)).a, 3);
+            db.close();
+        }
+
+        moc_database db;
+        db.set_schema_version(2);
+        BOOST_CHECK_EXCEPTION(db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8), std::runtime_error,
+                              [](const std::runtime_error& e) {
+                                  return std::string(e.what()).find("replay required") != std::string::npos;
+                              });
+
+        boost::filesystem::remove_all(temp);
+    }
+    catch (...)
+    {
+        boost::filesystem::remove_all(temp);
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(grow_open_segment)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    try
+    {
+        const size_t initial_size = 1024 * 1024 * 8;
+        const size_t step = 1024 * 1024 * 4;
+
+        chainbase::segment_options options;
+        options.max_size = initial_size + 2 * step;
+
+        moc_database db;
+        db.set_segment_options(options);
+        db.open(temp, chainbase::database::read_write, initial_size);
+        db.add_index<book_index>();
+
+        const auto& first_book = db.create<book>([](book& b) { b.a = 1; });
+
+        const auto size = db.get_size();
+        BOOST_REQUIRE(db.grow_segment(step));
+        BOOST_REQUIRE(db.grow_segment(step));
+        BOOST_REQUIRE(!db.grow_segment(step));
+        BOOST_REQUIRE_EQUAL(db.get_size(), size + 2 * step);
+
+        // takes more memory than the initial segment has
+        int count = 0;
+        while (db.get_free_memory() > step)
+            db.create<book>([&](book& b) { b.a = ++count; });
+
+        BOOST_REQUIRE_EQUAL(first_book.a, 1); // objects are not moved
+        db.close();
+
+        moc_database db2;
+        db2.open(temp, chainbase::database::read_write);
+        db2.add_index<book_index>();
+
+        BOOST_REQUIRE_EQUAL(db2.get_size(), size + 2 * step);
+        BOOST_REQUIRE_EQUAL(boost::filesystem::file_size(chainbase::database::shared_memory_path(temp)),
+                            size + 2 * step);
+        BOOST_REQUIRE_EQUAL(db2.get_index<book_index>().indices().size(), (size_t)count + 1);
+
+        db2.close();
+        boost::filesystem::remove_all(temp);
+    }
+    catch (...)
+    {
+        boost::filesystem::remove_all(temp);
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(background_flush)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    try
+    {
+        const size_t step = 1024 * 1024 * 4;
+
+        chainbase::segment_options options;
+        options.max_size = 1024 * 1024 * 8 + step;
+
+        moc_database db;
+        db.set_segment_options(options);
+        db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+        db.add_index<book_index>();
+
+        chainbase::flush_options flush_options;
+        flush_options.chunk_size = 1024 * 1024;
+        flush_options.lock_wait_us = 1000;
+        db.start_background_flush(flush_options);
+
+        db.with_write_lock([&]() {
+            for (int i = 0; i < 1000; ++i)
+                db.create<book>([&](book& b) { b.a = i; });
+
+            BOOST_REQUIRE(db.grow_segment(step));
+            db.request_flush();
+        });
+
+        auto statistic = db.get_flush_statistic();
+        for (int i = 0; i < 1000 && !statistic.flushes; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            statistic = db.get_flush_statistic();
+        }
+
+        BOOST_REQUIRE_EQUAL(statistic.flushes, 1u);
+        BOOST_REQUIRE_EQUAL(statistic.bytes, db.get_size());
+        BOOST_REQUIRE_GE(statistic.last_duration_us, statistic.last_locked_duration_us);
+
+        // final pass doesn't wait for a busy lock, it's retried
+        db.with_write_lock([&]() {
+            db.request_flush();
+
+            for (int i = 0; i < 1000 && !db.get_flush_statistic().lock_retries; ++i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        });
+        BOOST_REQUIRE_GT(db.get_flush_statistic().lock_retries, 0u);
+
+        statistic = db.get_flush_statistic();
+        for (int i = 0; i < 1000 && statistic.flushes < 2; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            statistic = db.get_flush_statistic();
+        }
+        BOOST_REQUIRE_EQUAL(statistic.flushes, 2u);
+
+        // the thread is stopped, the flush which is in progress is dropped
+        db.with_write_lock([&]() { db.request_flush(); });
+        db.close();
+
+        moc_database db2;
+        db2.open(temp, chainbase::database::read_write);
+        db2.add_index<book_index>();
+
+        BOOST_REQUIRE_EQUAL(db2.get_index<book_index>().indices().size(), 1000u);
+        BOOST_REQUIRE_EQUAL(db2.get_flush_statistic().flushes, 0u);
+
+        db2.close();
+        boost::filesystem::remove_all(temp);
+    }
+    catch (...)
+    {
+        boost::filesystem::remove_all(temp);
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(index_table_lookup)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    try
+    {
+        moc_database db;
+        db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+        db.add_index<plugin_note_index>();
+
+        BOOST_REQUIRE(db.has_index<plugin_note_index>());
+        BOOST_REQUIRE(!db.has_index<book_index>());
+        BOOST_CHECK_THROW(db.get_index<book_index>(), std::runtime_error);
+        BOOST_CHECK_THROW(db.create<book>([](book&) {}), std::runtime_error);
+
+        db.add_index<book_index>();
+        BOOST_CHECK_THROW(db.add_index<book_index>(), std::logic_error);
+
+        const auto& note = db.create<plugin_note>([](plugin_note& n) { n.value = 1; });
+        db.create<book>([](book& b) { b.a = 2; });
+
+        {
+            auto session = db.start_undo_session();
+            db.modify(note, [](plugin_note& n) { n.value = 3; });
+            db.remove(db.get<book>());
+        }
+
+        BOOST_REQUIRE_EQUAL(db.get<plugin_note>().value, 1);
+        BOOST_REQUIRE_EQUAL(db.get<book>().a, 2);
+
+        size_t indices = 0;
+        db.for_each_index([&](chainbase::abstract_generic_index_i&) { ++indices; });
+        BOOST_REQUIRE_EQUAL(indices, 2u);
+
+        db.close();
+        boost::filesystem::remove_all(temp);
+    }
+    catch (...)
+    {
+        boost::filesystem::remove_all(temp);
+        throw;
+    }
+}
+
+struct book_sum : public chainbase::object_observer<book>
+{
+    chainbase::revision_journal<int> sum;
+
+    void on_add(const book& b, int64_t revision) override
+    {
+        sum.add(b.a, revision);
+    }
+
+    void on_remove(const book& b, int64_t revision) override
+    {
+        sum.subtract(b.a, revision);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(object_observer_follows_undo)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    try
+    {
+        moc_database db;
+        db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+        db.add_index<book_index>();
+
+        book_sum observer;
+        db.set_observer<book>(&observer);
+        db.add_revision_listener(observer.sum);
+
+        auto scan = [&]() {
+            int result = 0;
+            for (const auto& b : db.get_index<book_index>().indices())
+                result += b.a;
+            return result;
+        };
+
+        const auto& first = db.create<book>([](book& b) { b.a = 1; });
+        BOOST_REQUIRE_EQUAL(observer.sum.value(), 1);
+
+        {
+            auto session = db.start_undo_session();
+            db.modify(first, [](book& b) { b.a = 10; });
+            db.create<book>([](book& b) { b.a = 5; });
+            BOOST_REQUIRE_EQUAL(observer.sum.value(), 15);
+        }
+        BOOST_REQUIRE_EQUAL(observer.sum.value(), 1);
+        BOOST_REQUIRE_EQUAL(scan(), 1);
+
+        {
+            // transaction squashed into the block and the block undone
+            auto block = db.start_undo_session();
+            db.create<book>([](book& b) { b.a = 2; });
+            {
+                auto trx = db.start_undo_session();
+                db.modify(first, [](book& b) { b.a = 3; });
+                db.squash();
+                trx->push();
+            }
+            BOOST_REQUIRE_EQUAL(observer.sum.value(), 5);
+            BOOST_REQUIRE_EQUAL(scan(), 5);
+        }
+        BOOST_REQUIRE_EQUAL(observer.sum.value(), 1);
+        BOOST_REQUIRE_EQUAL(scan(), 1);
+
+        {
+            auto session = db.start_undo_session();
+            db.remove(first);
+            db.create<book>([](book& b) { b.a = 7; });
+            session->push();
+            db.commit(db.revision());
+        }
+        BOOST_REQUIRE_EQUAL(observer.sum.value(), 7);
+        BOOST_REQUIRE_EQUAL(scan(), 7);
+
+        {
+            auto session = db.start_undo_session();
+            db.remove(db.get<book>(1));
+        }
+        BOOST_REQUIRE_EQUAL(observer.sum.value(), 7);
+        BOOST_REQUIRE_EQUAL(scan(), 7);
+
+        db.set_observer<book>(nullptr);
+        db.remove_revision_listener(observer.sum);
+        db.create<book>([](book& b) { b.a = 100; });
+        BOOST_REQUIRE_EQUAL(observer.sum.value(), 7);
+
+        db.close();
+        boost::filesystem::remove_all(temp);
+    }
+    catch (...)
+    {
+        boost::filesystem::remove_all(temp);
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(index_statistic)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    try
+    {
+        moc_database db;
+        db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+        db.add_index<book_index>();
+        db.add_index<article_index>();
+
+        const auto& first_book = db.create<book>([](book& b) { b.a = 1; });
+        db.create<book>([](book& b) { b.a = 2; });
+        db.modify(first_book, [](book& b) { b.a = 3; });
+
+        {
+            auto session = db.start_undo_session();
+            db.remove(first_book);
+
+            auto statistic = db.get_index_statistic();
+            BOOST_REQUIRE_EQUAL(statistic.size(), 2u);
+
+            const auto& books = statistic[0];
+            BOOST_CHECK_EQUAL(books.type_id, 0u);
+            BOOST_CHECK_EQUAL(books.count, 1u);
+            BOOST_CHECK_GT(books.bytes, sizeof(book));
+            BOOST_CHECK_EQUAL(books.created, 2u);
+            BOOST_CHECK_EQUAL(books.modified, 1u);
+            BOOST_CHECK_EQUAL(books.removed, 1u);
+            BOOST_CHECK_EQUAL(books.undo_depth, 1u);
+            BOOST_CHECK_EQUAL(books.undo_size, 1u);
+            BOOST_CHECK_GT(books.undo_bytes, sizeof(book));
+
+            const auto& articles = statistic[1];
+            BOOST_CHECK_EQUAL(articles.type_id, 1u);
+            BOOST_CHECK_EQUAL(articles.count, 0u);
+            BOOST_CHECK_EQUAL(articles.created, 0u);
+            BOOST_CHECK_EQUAL(articles.undo_depth, 0u);
+            BOOST_CHECK_EQUAL(articles.undo_bytes, 0u);
+        }
+
+        // undo restores objects but not the counters
+        const auto books = db.get_index_statistic()[0];
+        BOOST_CHECK_EQUAL(books.count, 2u);
+        BOOST_CHECK_EQUAL(books.removed, 1u);
+        BOOST_CHECK_EQUAL(books.undo_depth, 0u);
+        BOOST_CHECK_EQUAL(books.undo_bytes, 0u);
+
+        std::map<uint16_t, chainbase::index_counters> counters;
+        db.for_each_index_counters(
+            [&](uint16_t type_id, const chainbase::index_counters& item) { counters[type_id] = item; });
+        BOOST_REQUIRE_EQUAL(counters.size(), 2u);
+        BOOST_CHECK_EQUAL(counters[0].created, 2u);
+        BOOST_CHECK_EQUAL(counters[0].modified, 1u);
+        BOOST_CHECK_EQUAL(counters[0].removed, 1u);
+        BOOST_CHECK_EQUAL(counters[1].created, 0u);
+
+        db.close();
+        boost::filesystem::remove_all(temp);
+    }
+    catch (...)
+    {
+        boost::filesystem::remove_all(temp);
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(array_index)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    try
+    {
+        moc_database db;
+        db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+        db.add_index<summary_index>();
+
+        for (int i = 0; i < 300; ++i)
+            db.create<summary>([&](summary& s) { s.value = i; });
+
+        BOOST_CHECK_THROW(db.create<summary>([](summary&) {}), std::logic_error); // out of capacity
+
+        const auto& first = db.get<summary>(0);
+        BOOST_REQUIRE_EQUAL(db.get<summary>(299).value, 299);
+        BOOST_REQUIRE(db.find<summary>(300) == nullptr);
+
+        {
+            auto session = db.start_undo_session();
+
+            db.modify(first, [](summary& s) { s.value = 1000; });
+            db.remove(db.get<summary>(256));
+            db.remove(db.get<summary>(257));
+
+            BOOST_REQUIRE_EQUAL(first.value, 1000);
+            BOOST_REQUIRE(db.find<summary>(256) == nullptr);
+            BOOST_REQUIRE_EQUAL(db.get_index<summary_index>().indices().size(), 298u);
+
+            int count = 0;
+            for (const auto& s : db.get_index<summary_index>().indices())
+            {
+                BOOST_REQUIRE_NE(s.id._id, 256);
+                ++count;
+            }
+            BOOST_REQUIRE_EQUAL(count, 298);
+
+            const auto& idx = db.get_index<summary_index>().indices();
+            BOOST_REQUIRE_EQUAL(idx.lower_bound(256)->id._id, 258);
+            BOOST_REQUIRE_EQUAL(idx.upper_bound(255)->id._id, 258);
+            BOOST_REQUIRE(idx.equal_range(257).first == idx.equal_range(257).second);
+            BOOST_REQUIRE_EQUAL(idx.equal_range(258).first->id._id, 258);
+            BOOST_REQUIRE(idx.upper_bound(299) == idx.end());
+            BOOST_REQUIRE_EQUAL(std::prev(idx.lower_bound(256))->id._id, 255); // across chunks
+            BOOST_REQUIRE_EQUAL(idx.rbegin()->id._id, 299);
+            BOOST_REQUIRE_EQUAL(std::distance(idx.rbegin(), idx.rend()), 298);
+        }
+
+        BOOST_REQUIRE_EQUAL(&first, &db.get<summary>(0)); // objects are not moved
+        BOOST_REQUIRE_EQUAL(first.value, 0);
+        BOOST_REQUIRE_EQUAL(db.get<summary>(256).value, 256);
+        BOOST_REQUIRE_EQUAL(db.get<summary>(257).value, 257);
+        BOOST_REQUIRE_EQUAL(db.get_index<summary_index>().indices().size(), 300u);
+
+        BOOST_CHECK_THROW(db.modify(first, [](summary& s) { s.id = 1; }), std::logic_error);
+        BOOST_REQUIRE(db.find<summary>(0) == nullptr);
+
+        db.close();
+        boost::filesystem::remove_all(temp);
+    }
+    catch (...)
+    {
+        boost::filesystem::remove_all(temp);
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pooled_index)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    try
+    {
+        moc_database db;
+        db.open(temp, chainbase::database::read_write, 1024 * 1024 * 8);
+        db.add_index<ticket_index>();
+
+        const int count = 1000;
+        for (int i = 0; i < count; ++i)
+            db.create<ticket>([&](ticket& t) {
+                t.expiration = i;
+                t.owner = std::string(64, 'o').c_str();
+            });
+
+        auto statistic = db.get_pool_statistic();
+        BOOST_REQUIRE_EQUAL(statistic.size(), 1u);
+        // container header is a node too
+        BOOST_REQUIRE_EQUAL(statistic[0].nodes - statistic[0].free_nodes, (size_t)count + 1);
+        BOOST_REQUIRE_GT(statistic[0].node_size, sizeof(ticket));
+        BOOST_REQUIRE_EQUAL(statistic[0].type_id, (uint16_t)ticket::type_id);
+
+        const auto free_memory = db.get_free_memory();
+        const auto nodes = statistic[0].nodes;
+
+        {
+            auto session = db.start_undo_session();
+            for (int i = 0; i < count / 2; ++i)
+                db.remove(db.get<ticket>(i));
+        }
+
+        BOOST_REQUIRE_EQUAL(db.get_index<ticket_index>().indices().size(), (size_t)count);
+        BOOST_REQUIRE_EQUAL(db.get<ticket>(0).owner, std::string(64, 'o').c_str());
+
+        // expired tickets are replaced by new ones in the same nodes
+        const auto pool_free_memory = db.get_pool_free_memory();
+        for (int i = 0; i < count / 2; ++i)
+            db.remove(db.get<ticket>(i));
+
+        // free nodes are counted as free memory
+        const auto node_size = statistic[0].node_size;
+        BOOST_REQUIRE_EQUAL(db.get_pool_free_memory(), pool_free_memory + count / 2 * node_size);
+        BOOST_REQUIRE_GE(db.get_free_memory(), free_memory + count / 2 * node_size);
+
+        for (int i = 0; i < count / 2; ++i)
+            db.create<ticket>([&](ticket& t) { t.expiration = count + i; });
+
+        statistic = db.get_pool_statistic();
+        BOOST_REQUIRE_EQUAL(statistic[0].nodes, nodes);
+        BOOST_REQUIRE_GE(db.get_free_memory(), free_memory);
+
+        db.close();
+
+        moc_database db2;
+        db2.open(temp, chainbase::database::read_write);
+        db2.add_index<ticket_index>();
+
+        BOOST_REQUIRE_EQUAL(db2.get_index<ticket_index>().indices().size(), (size_t)count);
+        db2.create<ticket>([&](ticket& t) { t.expiration = 2 * count; });
+        BOOST_REQUIRE_EQUAL(db2.get_pool_statistic()[0].nodes - db2.get_pool_statistic()[0].free_nodes,
+                            (size_t)count + 2);
+
+        db2.close();
+        boost::filesystem::remove_all(temp);
+    }
+    catch (...)
+    {
+        boost::filesystem::remove_all(temp);
+        throw;
+    }
+}
+
 // BOOST_AUTO_TEST_SUITE_END()
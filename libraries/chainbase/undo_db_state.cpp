@@ -1,37 +1,118 @@
 #include <chainbase/undo_db_state.hpp>
-#include <chainbase/database_index.hpp>
 
 namespace chainbase {
 
-//////////////////////////////////////////////////////////////////////////
-struct session_container : public abstract_undo_session
+abstract_undo_session_ptr undo_db_state::start_undo_session()
 {
-    abstract_undo_session_list _session_list;
+    FC_ASSERT(_undo_revision);
 
-private:
-    friend class undo_db_state;
+    ++_undo_revision->revision;
 
-public:
-    session_container(abstract_undo_session_list&& s)
-        : _session_list(std::move(s))
-    {
-    }
+    return abstract_undo_session_ptr(new session(*this));
+}
+
+void undo_db_state::undo()
+{
+    if (!enabled())
+        return;
+
+    for (auto index : _dirty_indices)
+        index->undo(_undo_revision->revision);
+
+    remove_clean_indices();
+
+    for (auto listener : _revision_listeners)
+        listener->on_undo(_undo_revision->revision);
+
+    --_undo_revision->revision;
+}
+
+void undo_db_state::undo_all()
+{
+    while (enabled())
+        undo();
+}
+
+void undo_db_state::squash()
+{
+    if (!enabled())
+        return;
 
-    virtual void push() override
+    if (_undo_revision->revision - _undo_revision->committed == 1)
     {
-        for (auto& i : _session_list)
-            i->push();
+        commit(_undo_revision->revision);
+        return;
     }
-};
 
-//////////////////////////////////////////////////////////////////////////
-abstract_undo_session_ptr undo_db_state::start_undo_session()
+    for (auto index : _dirty_indices)
+        index->squash(_undo_revision->revision);
+
+    for (auto listener : _revision_listeners)
+        listener->on_squash(_undo_revision->revision);
+
+    --_undo_revision->revision;
+}
+
+void undo_db_state::commit(int64_t revision)
 {
-    abstract_undo_session_list sub_sessions;
-    sub_sessions.reserve(_index_map.size());
+    FC_ASSERT(_undo_revision);
+
+    revision = std::min(revision, _undo_revision->revision);
+    if (revision <= _undo_revision->committed)
+        return;
+
+    for (auto index : _dirty_indices)
+        index->commit(revision);
+
+    remove_clean_indices();
 
-    for_each_index([&](abstract_generic_index_i& item) { sub_sessions.push_back(item.start_undo_session()); });
+    for (auto listener : _revision_listeners)
+        listener->on_commit(revision);
 
-    return abstract_undo_session_ptr(new session_container(std::move(sub_sessions)));
+    _undo_revision->committed = revision;
+}
+
+int64_t undo_db_state::revision() const
+{
+    FC_ASSERT(_undo_revision);
+    return _undo_revision->revision;
+}
+
+void undo_db_state::set_revision(int64_t revision)
+{
+    FC_ASSERT(_undo_revision);
+
+    if (enabled())
+        BOOST_THROW_EXCEPTION(std::logic_error("cannot set revision while there is an existing undo stack"));
+
+    _undo_revision->revision = revision;
+    _undo_revision->committed = revision;
+}
+
+void undo_db_state::add_revision_listener(abstract_revision_listener& listener)
+{
+    _revision_listeners.push_back(&listener);
+}
+
+void undo_db_state::remove_revision_listener(abstract_revision_listener& listener)
+{
+    _revision_listeners.erase(std::remove(_revision_listeners.begin(), _revision_listeners.end(), &listener),
+                              _revision_listeners.end());
+}
+
+void undo_db_state::open_undo_state()
+{
+    _undo_revision = allocate_object<undo_revision>("undo_revision");
+}
+
+void undo_db_state::close_undo_state()
+{
+    _undo_revision = nullptr;
+    _dirty_indices.clear();
+}
+
+bool undo_db_state::enabled() const
+{
+    return _undo_revision && _undo_revision->revision > _undo_revision->committed;
 }
 }
@@ -81,6 +81,13 @@ public:
         std::vector<fc::uint160_t>& contained_transaction_message_ids)
         = 0;
 
+    /**
+     *  @brief Called for sync blocks which are going to be passed to handle_block soon, so the
+     *         delegate can start the checks of the block which don't depend on the chain state.
+     *         It must not wait for the checks.
+     */
+    virtual void prevalidate_block(const graphene::net::block_message& blk_msg) = 0;
+
     /**
      *  @brief Called when a new transaction comes in from the network
      *
@@ -302,6 +302,7 @@ private:
 #define NODE_DELEGATE_METHOD_NAMES (has_item) \
                                    (handle_message) \
                                    (handle_block) \
+                                   (prevalidate_block) \
                                    (handle_transaction) \
                                    (get_block_ids) \
                                    (get_item) \
@@ -404,6 +405,7 @@ public:
     bool handle_block(const graphene::net::block_message& block_message,
                       bool sync_mode,
                       std::vector<fc::uint160_t>& contained_transaction_message_ids) override;
+    void prevalidate_block(const graphene::net::block_message& block_message) override;
     void handle_transaction(const graphene::net::trx_message& transaction_message) override;
     std::vector<item_hash_t> get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                            uint32_t& remaining_item_count,
@@ -619,6 +621,10 @@ public:
     unsigned _maximum_number_of_blocks_to_handle_at_one_time;
     unsigned _maximum_number_of_sync_blocks_to_prefetch;
     unsigned _maximum_blocks_per_peer_during_syncing;
+    unsigned _maximum_number_of_sync_blocks_to_prevalidate;
+
+    boost::circular_buffer<item_hash_t>
+        _recently_prevalidated_sync_blocks; /// sync blocks passed to prevalidate_block, so they aren't passed again
 
     std::list<fc::future<void>> _handle_message_calls_in_progress;
     std::set<message_hash_type> _message_ids_currently_being_processed;
@@ -729,6 +735,7 @@ public:
     void send_sync_block_to_node_delegate(const graphene::net::block_message& block_message_to_send);
     void process_backlog_of_sync_blocks();
     void trigger_process_backlog_of_sync_blocks();
+    void prevalidate_next_sync_blocks();
     void process_block_during_sync(peer_connection* originating_peer,
                                    const graphene::net::block_message& block_message,
                                    const message_hash_type& message_hash);
@@ -849,6 +856,7 @@ void node_impl_deleter::operator()(node_impl* impl_to_delete)
 
 #define MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME 200
 #define MAXIMUM_NUMBER_OF_BLOCKS_TO_PREFETCH (10 * MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME)
+#define MAXIMUM_NUMBER_OF_SYNC_BLOCKS_TO_PREVALIDATE 32
 
 node_impl::node_impl(const std::string& user_agent)
     :
@@ -886,6 +894,8 @@ node_impl::node_impl(const std::string& user_agent)
     , _maximum_number_of_blocks_to_handle_at_one_time(MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME)
     , _maximum_number_of_sync_blocks_to_prefetch(MAXIMUM_NUMBER_OF_BLOCKS_TO_PREFETCH)
     , _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING)
+    , _maximum_number_of_sync_blocks_to_prevalidate(MAXIMUM_NUMBER_OF_SYNC_BLOCKS_TO_PREVALIDATE)
+    , _recently_prevalidated_sync_blocks(2 * MAXIMUM_NUMBER_OF_SYNC_BLOCKS_TO_PREVALIDATE)
 {
     _rate_limiter.set_actual_rate_time_constant(fc::seconds(2));
     fc::rand_pseudo_bytes(&_node_id.data[0], (int)_node_id.size());
@@ -3618,10 +3628,58 @@ void node_impl::process_backlog_of_sync_blocks()
 
     dlog("leaving process_backlog_of_sync_blocks, ${count} processed", ("count", blocks_processed));
 
+    prevalidate_next_sync_blocks();
+
     if (!_suspend_fetching_sync_blocks)
         trigger_fetch_sync_items_loop();
 }
 
+void node_impl::prevalidate_next_sync_blocks()
+{
+    VERIFY_CORRECT_THREAD();
+    if (!_maximum_number_of_sync_blocks_to_prevalidate)
+        return;
+
+    // blocks at the front of the peers' lists are the next ones to be handled, the delegate checks them
+    // while the blocks before them are being applied
+    std::set<item_hash_t> next_block_ids;
+    for (const peer_connection_ptr& peer : _active_connections)
+    {
+        ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
+        const size_t count
+            = std::min<size_t>(peer->ids_of_items_to_get.size(), _maximum_number_of_sync_blocks_to_prevalidate);
+        next_block_ids.insert(peer->ids_of_items_to_get.begin(), peer->ids_of_items_to_get.begin() + count);
+    }
+
+    std::vector<graphene::net::block_message> blocks_to_prevalidate;
+    for (const graphene::net::block_message& received_block : _received_sync_items)
+    {
+        if (next_block_ids.count(received_block.block_id)
+            && std::find(_recently_prevalidated_sync_blocks.begin(), _recently_prevalidated_sync_blocks.end(),
+                         received_block.block_id)
+                == _recently_prevalidated_sync_blocks.end())
+        {
+            _recently_prevalidated_sync_blocks.push_back(received_block.block_id);
+            blocks_to_prevalidate.push_back(received_block);
+        }
+    }
+
+    // the delegate call may yield, so blocks are copied out of _received_sync_items first
+    for (const graphene::net::block_message& block_message_to_prevalidate : blocks_to_prevalidate)
+    {
+        try
+        {
+            _delegate->prevalidate_block(block_message_to_prevalidate);
+        }
+        catch (const fc::exception& e)
+        {
+            // the block is checked again when it's handled
+            wlog("Error when prevalidating sync block ${id}: ${e}",
+                 ("id", block_message_to_prevalidate.block_id)("e", e.to_detail_string()));
+        }
+    }
+}
+
 void node_impl::trigger_process_backlog_of_sync_blocks()
 {
     if (!_node_is_shutting_down
@@ -5346,6 +5404,12 @@ void node_impl::set_advanced_node_parameters(const fc::variant_object& params)
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>();
     if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>();
+    if (params.contains("maximum_number_of_sync_blocks_to_prevalidate"))
+    {
+        _maximum_number_of_sync_blocks_to_prevalidate
+            = params["maximum_number_of_sync_blocks_to_prevalidate"].as<uint32_t>();
+        _recently_prevalidated_sync_blocks.set_capacity(2 * _maximum_number_of_sync_blocks_to_prevalidate);
+    }
 
     _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -5364,6 +5428,7 @@ fc::variant_object node_impl::get_advanced_node_parameters()
     result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
     result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
     result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+    result["maximum_number_of_sync_blocks_to_prevalidate"] = _maximum_number_of_sync_blocks_to_prevalidate;
     return result;
 }
 
@@ -5854,6 +5919,11 @@ bool statistics_gathering_node_delegate_wrapper::handle_block(
     INVOKE_AND_COLLECT_STATISTICS(handle_block, block_message, sync_mode, contained_transaction_message_ids);
 }
 
+void statistics_gathering_node_delegate_wrapper::prevalidate_block(const graphene::net::block_message& block_message)
+{
+    INVOKE_AND_COLLECT_STATISTICS(prevalidate_block, block_message);
+}
+
 void statistics_gathering_node_delegate_wrapper::handle_transaction(
     const graphene::net::trx_message& transaction_message)
 {
@@ -68,7 +68,7 @@ struct by_id_desc;
 
 template <typename history_object_t>
 using account_history_index
-    = shared_multi_index_container<history_object_t,
+    = pooled_multi_index_container<history_object_t,
                                    indexed_by<ordered_unique<tag<by_id>,
                                                              member<history_object_t,
                                                                     typename history_object_t::id_type,
@@ -88,7 +88,7 @@ using account_history_index
 
 template <typename history_object_t>
 using devcommittee_history_index
-    = shared_multi_index_container<history_object_t,
+    = pooled_multi_index_container<history_object_t,
                                    indexed_by<ordered_unique<tag<by_id>,
                                                              member<history_object_t,
                                                                     typename history_object_t::id_type,
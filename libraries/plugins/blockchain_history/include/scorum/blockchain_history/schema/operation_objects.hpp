@@ -39,7 +39,7 @@ public:
 struct by_location;
 struct by_timestamp;
 struct by_transaction_id;
-typedef shared_multi_index_container<operation_object,
+typedef pooled_multi_index_container<operation_object,
                                      indexed_by<ordered_unique<tag<by_id>,
                                                                member<operation_object,
                                                                       operation_object::id_type,
@@ -94,7 +94,7 @@ public:
 
 template <blockchain_history_object_type OperationType>
 using filtered_operation_index
-    = shared_multi_index_container<filtered_operation_object<OperationType>,
+    = pooled_multi_index_container<filtered_operation_object<OperationType>,
                                    indexed_by<ordered_unique<tag<by_id>,
                                                              member<filtered_operation_object<OperationType>,
                                                                     typename filtered_operation_object<OperationType>::
@@ -16,6 +16,7 @@
 #include <scorum/chain/operation_notification.hpp>
 
 #include <chrono>
+#include <map>
 
 namespace scorum {
 namespace blockchain_monitoring {
@@ -58,15 +59,106 @@ public:
     }
 };
 //////////////////////////////////////////////////////////////////////////
+class index_statistic_tracker
+{
+    chain::database& _db;
+
+    // only operation counters are taken on every block, the full statistic walks the undo state
+    std::map<uint16_t, chainbase::index_counters> _last_counters;
+    std::map<uint16_t, chainbase::index_counters> _last_block_counters;
+
+    void collect(const signed_block& b)
+    {
+        _db.for_each_index_counters([&](uint16_t type_id, const chainbase::index_counters& current) {
+            auto& before = _last_counters[type_id];
+
+            auto& counters = _last_block_counters[type_id];
+            counters.created = current.created - before.created;
+            counters.modified = current.modified - before.modified;
+            counters.removed = current.removed - before.removed;
+
+            before = current;
+        });
+
+        if (log_interval && b.block_num() % log_interval == 0)
+            print();
+    }
+
+    void print() const
+    {
+        for (const auto& item : _db.get_index_statistic())
+        {
+            const auto counters = get_last_block_counters(item.type_id);
+
+            ilog("${name}: ${count} objects, ${bytes} bytes, undo ${depth}/${undo_bytes} bytes, "
+                 "last block ${c}/${m}/${r} created/modified/removed",
+                 ("name", item.name)("count", item.count)("bytes", item.bytes)("depth", item.undo_depth)(
+                     "undo_bytes", item.undo_bytes)("c", counters.created)("m", counters.modified)(
+                     "r", counters.removed));
+        }
+    }
+
+public:
+    uint32_t log_interval = 0;
+
+    index_statistic_tracker(chain::database& db)
+        : _db(db)
+    {
+        db.applied_block.connect([&](const signed_block& b) { this->collect(b); });
+    }
+
+    chainbase::index_counters get_last_block_counters(uint16_t type_id) const
+    {
+        auto it = _last_block_counters.find(type_id);
+        return it != _last_block_counters.end() ? it->second : chainbase::index_counters();
+    }
+};
+//////////////////////////////////////////////////////////////////////////
+class lock_statistic_logger
+{
+    chain::database& _db;
+
+    void collect(const signed_block& b)
+    {
+        if (log_interval && b.block_num() % log_interval == 0)
+            print();
+    }
+
+    void print() const
+    {
+        for (const auto& item : _db.get_lock_statistic())
+        {
+            ilog("${lock} lock ${tag} ${site}: ${n} locks, wait ${wait}/${max_wait} us total/max, "
+                 "hold ${hold}/${max_hold} us total/max, ${timeouts} timeouts",
+                 ("lock", item.lock)("tag", item.tag)("site", item.site)("n", item.wait.count)(
+                     "wait", item.wait.total_us)("max_wait", item.wait.max_us)("hold", item.hold.total_us)(
+                     "max_hold", item.hold.max_us)("timeouts", item.timeouts));
+        }
+    }
+
+public:
+    uint32_t log_interval = 0;
+
+    lock_statistic_logger(chain::database& db)
+        : _db(db)
+    {
+        db.applied_block.connect([&](const signed_block& b) { this->collect(b); });
+    }
+};
+//////////////////////////////////////////////////////////////////////////
 class blockchain_monitoring_plugin_impl
     : public common_statistics::common_statistics_plugin_impl<bucket_object, blockchain_monitoring_plugin>
 {
 public:
     perfomance_timer _timer;
+    index_statistic_tracker _index_statistic;
+    lock_statistic_logger _lock_statistic;
 
     blockchain_monitoring_plugin_impl(blockchain_monitoring_plugin& plugin)
         : base_plugin_impl(plugin)
         , _timer(plugin.database())
+        , _index_statistic(plugin.database())
+        , _lock_statistic(plugin.database())
     {
     }
     virtual ~blockchain_monitoring_plugin_impl()
@@ -412,7 +504,13 @@ void blockchain_monitoring_plugin::plugin_set_program_options(boost::program_opt
         "Track blockchain statistics by grouping orders into buckets of equal size measured in seconds specified as a "
         "JSON array of numbers")(
         "chain-stats-history-per-bucket", boost::program_options::value<uint32_t>()->default_value(100),
-        "How far back in time to track history for each bucket size, measured in the number of buckets (default: 100)");
+        "How far back in time to track history for each bucket size, measured in the number of buckets (default: 100)")(
+        "index-statistic-log-interval", boost::program_options::value<uint32_t>()->default_value(0),
+        "Print memory and operation statistic of every index to the log each N blocks, 0 - disabled")(
+        "lock-statistic", boost::program_options::bool_switch()->default_value(false),
+        "Collect wait and hold times of database locks by call site")(
+        "lock-statistic-log-interval", boost::program_options::value<uint32_t>()->default_value(0),
+        "Print lock statistic to the log each N blocks, 0 - disabled. Enables lock-statistic");
     cfg.add(cli);
 }
 
@@ -427,6 +525,13 @@ void blockchain_monitoring_plugin::plugin_initialize(const boost::program_option
         }
         if (options.count("chain-stats-history-per-bucket"))
             _my->_maximum_history_per_bucket_size = options["chain-stats-history-per-bucket"].as<uint32_t>();
+        if (options.count("index-statistic-log-interval"))
+            _my->_index_statistic.log_interval = options["index-statistic-log-interval"].as<uint32_t>();
+        if (options.count("lock-statistic-log-interval"))
+            _my->_lock_statistic.log_interval = options["lock-statistic-log-interval"].as<uint32_t>();
+
+        if (options["lock-statistic"].as<bool>() || _my->_lock_statistic.log_interval)
+            database().set_lock_statistic(true);
 
         ilog("chain-stats-bucket-size: ${b}", ("b", _my->_tracked_buckets));
         ilog("chain-stats-history-per-bucket: ${h}", ("h", _my->_maximum_history_per_bucket_size));
@@ -458,6 +563,11 @@ uint32_t blockchain_monitoring_plugin::get_last_block_duration_microseconds() co
 {
     return std::chrono::duration_cast<std::chrono::microseconds>(_my->_timer.get_last_block_duration()).count();
 }
+
+chainbase::index_counters blockchain_monitoring_plugin::get_last_block_index_counters(uint16_t type_id) const
+{
+    return _my->_index_statistic.get_last_block_counters(type_id);
+}
 }
 } // scorum::blockchain_monitoring
 
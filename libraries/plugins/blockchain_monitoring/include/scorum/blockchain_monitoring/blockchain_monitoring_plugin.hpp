@@ -3,6 +3,8 @@
 
 #include <scorum/blockchain_monitoring/schema/bucket_object.hpp>
 
+#include <chainbase/index_statistic.hpp>
+
 #ifndef BLOCKCHAIN_MONITORING_PLUGIN_NAME
 #define BLOCKCHAIN_MONITORING_PLUGIN_NAME "blockchain_monitoring"
 #endif
@@ -42,6 +44,11 @@ public:
 
     uint32_t get_last_block_duration_microseconds() const;
 
+    /**
+     * Operations with the index made by the last applied block
+     */
+    chainbase::index_counters get_last_block_index_counters(uint16_t type_id) const;
+
 private:
     friend class detail::blockchain_monitoring_plugin_impl;
     std::unique_ptr<detail::blockchain_monitoring_plugin_impl> _my;
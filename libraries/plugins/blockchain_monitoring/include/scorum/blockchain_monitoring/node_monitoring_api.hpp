@@ -2,6 +2,11 @@
 
 #include <fc/api.hpp>
 
+#include <chainbase/index_statistic.hpp>
+#include <chainbase/lock_statistic.hpp>
+#include <chainbase/pool_allocator.hpp>
+#include <chainbase/segment_flusher.hpp>
+
 #ifndef API_NODE_MONITORING
 #define API_NODE_MONITORING "node_monitoring_api"
 #endif
@@ -19,6 +24,20 @@ namespace detail {
 class node_monitoring_api_impl;
 }
 
+struct index_statistic_api_obj : public chainbase::index_statistic
+{
+    index_statistic_api_obj(const chainbase::index_statistic& statistic)
+        : chainbase::index_statistic(statistic)
+    {
+    }
+
+    index_statistic_api_obj()
+    {
+    }
+
+    chainbase::index_counters last_block;
+};
+
 /**
  * @brief Node monitoring API
  *
@@ -47,6 +66,26 @@ public:
     uint32_t get_free_shared_memory_mb() const;
     uint32_t get_total_shared_memory_mb() const;
 
+    /**
+    * @brief Returns memory usage, undo history and operation counters of every index.
+    */
+    std::vector<index_statistic_api_obj> get_index_statistic() const;
+
+    /**
+    * @brief Returns usage of node pools of pooled indices, free nodes are reserved for the same type only.
+    */
+    std::vector<chainbase::pool_statistic> get_pool_statistic() const;
+
+    /**
+    * @brief Returns count, size and duration of background flushes of the shared memory file.
+    */
+    chainbase::flush_statistic get_flush_statistic() const;
+
+    /**
+    * @brief Returns wait and hold times of database locks by caller, it's empty unless lock-statistic is enabled.
+    */
+    std::vector<chainbase::lock_statistic> get_lock_statistic() const;
+
     /// @}
 
 private:
@@ -55,5 +94,9 @@ private:
 } // namespace blockchain_monitoring
 } // namespace scorum
 
+FC_REFLECT_DERIVED(scorum::blockchain_monitoring::index_statistic_api_obj, (chainbase::index_statistic), (last_block))
+
 FC_API(scorum::blockchain_monitoring::node_monitoring_api,
-       (get_last_block_duration_microseconds)(get_free_shared_memory_mb)(get_total_shared_memory_mb))
+       (get_last_block_duration_microseconds)(get_free_shared_memory_mb)(get_total_shared_memory_mb)(
+           get_index_statistic)(get_pool_statistic)(get_flush_statistic)(
+           get_lock_statistic))
@@ -54,5 +54,38 @@ uint32_t node_monitoring_api::get_total_shared_memory_mb() const
         [&]() { return uint32_t(_my->_app.chain_database()->get_size() / (1024 * 1024)); });
 }
 
+std::vector<index_statistic_api_obj> node_monitoring_api::get_index_statistic() const
+{
+    return _my->_app.chain_database()->with_read_lock([&]() {
+        auto plugin = _my->get_plugin();
+
+        std::vector<index_statistic_api_obj> result;
+        for (const auto& item : _my->_app.chain_database()->get_index_statistic())
+        {
+            result.emplace_back(item);
+            result.back().last_block = plugin->get_last_block_index_counters(item.type_id);
+        }
+        return result;
+    });
+}
+
+std::vector<chainbase::pool_statistic> node_monitoring_api::get_pool_statistic() const
+{
+    return _my->_app.chain_database()->with_read_lock(
+        [&]() { return _my->_app.chain_database()->get_pool_statistic(); });
+}
+
+chainbase::flush_statistic node_monitoring_api::get_flush_statistic() const
+{
+    // statistic is synchronized by the flusher
+    return _my->_app.chain_database()->get_flush_statistic();
+}
+
+std::vector<chainbase::lock_statistic> node_monitoring_api::get_lock_statistic() const
+{
+    // taking the lock here would be counted too
+    return _my->_app.chain_database()->get_lock_statistic();
+}
+
 } // namespace blockchain_monitoring
 } // namespace scorum
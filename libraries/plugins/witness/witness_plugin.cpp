@@ -658,6 +658,8 @@ witness_plugin::maybe_produce_block(fc::mutable_variant_object& capture)
         return block_production_condition::lag;
     }
 
+    chainbase::lock_tag_scope lock_tag("witness:generate_block");
+
     int retry = 0;
     do
     {
@@ -11,6 +11,9 @@ struct signed_block : public signed_block_header
 {
     checksum_type calculate_merkle_root() const;
     std::vector<signed_transaction> transactions;
+
+    /// Merkle root of the transactions by their merkle_digest() values
+    static checksum_type calculate_merkle_root(std::vector<digest_type> merkle_digests);
 };
 }
 
@@ -91,6 +91,21 @@ struct signed_transaction : public transaction
     }
 };
 
+/**
+ * Hashes of a signed transaction computed from one serialization, the apply path computes them once
+ * instead of packing the transaction for every id(), sig_digest() and merkle_digest() call.
+ */
+struct signed_transaction_digests
+{
+    signed_transaction_digests() = default;
+    signed_transaction_digests(const signed_transaction& trx, const chain_id_type& chain_id);
+
+    transaction_id_type id;
+    digest_type sig_digest;
+    digest_type merkle_digest;
+    uint32_t packed_size = 0; ///< size of the packed signed transaction
+};
+
 void verify_authority(const std::vector<operation>& ops,
                       const flat_set<public_key_type>& sigs,
                       const authority_getter& get_active,
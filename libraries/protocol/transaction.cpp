@@ -33,6 +33,30 @@ digest_type transaction::sig_digest(const chain_id_type& chain_id) const
     return enc.result();
 }
 
+signed_transaction_digests::signed_transaction_digests(const signed_transaction& trx, const chain_id_type& chain_id)
+{
+    // packed signed transaction is the packed transaction followed by the signatures
+    const auto packed_trx = fc::raw::pack(static_cast<const transaction&>(trx));
+    const auto packed_signatures = fc::raw::pack(trx.signatures);
+
+    digest_type::encoder trx_enc;
+    trx_enc.write(packed_trx.data(), packed_trx.size());
+    const auto digest = trx_enc.result();
+    memcpy(id._hash, digest._hash, std::min(sizeof(id), sizeof(digest)));
+
+    digest_type::encoder sig_enc;
+    fc::raw::pack(sig_enc, chain_id);
+    sig_enc.write(packed_trx.data(), packed_trx.size());
+    sig_digest = sig_enc.result();
+
+    digest_type::encoder merkle_enc;
+    merkle_enc.write(packed_trx.data(), packed_trx.size());
+    merkle_enc.write(packed_signatures.data(), packed_signatures.size());
+    merkle_digest = merkle_enc.result();
+
+    packed_size = packed_trx.size() + packed_signatures.size();
+}
+
 void transaction::validate() const
 {
     FC_ASSERT(operations.size() > 0, "A transaction must have at least one operation", ("trx", *this));
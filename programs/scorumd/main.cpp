@@ -170,9 +170,9 @@ int main(int argc, char** argv)
         ilog("starting plugins");
         node->startup_plugins();
 
-        node->chain_database()->with_read_lock([&]() {
-            ilog("Started node on a chain with ${h} blocks.", ("h", node->chain_database()->head_block_num()));
-        });
+        const uint32_t head_block_num = node->chain_database()->with_read_lock(
+            [&]() { return node->chain_database()->head_block_num(); });
+        ilog("Started node on a chain with ${h} blocks.", ("h", head_block_num));
 
         std::cout << "Scorum network started.\n\n";
 
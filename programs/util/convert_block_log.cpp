@@ -0,0 +1,96 @@
+#include <scorum/chain/block_log.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <string>
+
+// Copies a block log into a new one of the given format, e.g. compresses the raw log of a node:
+//
+//   convert_block_log blockchain/block_log blockchain/block_log.z 100
+//
+// or splits it into segments of a million blocks:
+//
+//   convert_block_log blockchain/block_log blockchain/segmented/block_log 0 1000000
+//
+// The node is stopped while the log is converted, then the new log and its index replace the old files.
+
+namespace {
+
+// size of the log files including the index, tail and segment ones
+uint64_t log_files_size(const fc::path& file)
+{
+    uint64_t result = 0;
+    const fc::path dir = file.parent_path().empty() ? fc::path(".") : file.parent_path();
+    const std::string prefix = file.filename().generic_string();
+    for (boost::filesystem::directory_iterator itr(dir), end; itr != end; ++itr)
+    {
+        if (!itr->path().filename().generic_string().compare(0, prefix.size(), prefix))
+            result += boost::filesystem::file_size(itr->path());
+    }
+    return result;
+}
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        if (argc < 3 || argc > 5)
+        {
+            std::cerr << "convert_block_log <source> <destination> [blocks per chunk] [blocks per segment]\n"
+                         "\n"
+                         "Copies blocks of the source log into the new destination log, it's compressed by chunks\n"
+                         "of the given number of blocks (100 by default), 0 makes a raw log. Destination is split\n"
+                         "into segment files of the given number of blocks, 0 (default) keeps it in one file.\n";
+            return 1;
+        }
+
+        const fc::path source_file(argv[1]);
+        const fc::path destination_file(argv[2]);
+        const uint32_t blocks_per_chunk = argc > 3 ? std::stoul(argv[3]) : 100;
+        const uint32_t blocks_per_segment = argc > 4 ? std::stoul(argv[4]) : 0;
+
+        scorum::chain::block_log source;
+        source.open(source_file);
+        FC_ASSERT(source.head().valid(), "There is no block log ${f}", ("f", source_file.generic_string()));
+
+        scorum::chain::block_log destination;
+        destination.open(destination_file, blocks_per_chunk, blocks_per_segment);
+        FC_ASSERT(!destination.head().valid(), "Destination ${f} exists", ("f", destination_file.generic_string()));
+
+        const uint32_t head_num = source.head()->block_num();
+        const uint32_t log_interval = std::max(head_num / 100u, 1000u);
+
+        auto itr = source.read_block(source.get_block_pos(source.first_block_num()));
+        for (;;)
+        {
+            const uint32_t block_num = itr.first.block_num();
+            destination.append(itr.first);
+
+            if (block_num % log_interval == 0 || block_num == head_num)
+                ilog("${n} of ${h} blocks are copied", ("n", block_num)("h", head_num));
+
+            if (block_num == head_num)
+                break;
+            itr = source.read_block(itr.second);
+        }
+
+        destination.flush();
+
+        const uint64_t source_size = log_files_size(source_file);
+        const uint64_t destination_size = log_files_size(destination_file);
+
+        ilog("Block log is converted, ${s} bytes -> ${d} bytes", ("s", source_size)("d", destination_size));
+    }
+    catch (const fc::exception& e)
+    {
+        edump((e.to_detail_string()));
+        return 1;
+    }
+
+    return 0;
+}
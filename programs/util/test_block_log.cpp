@@ -1,59 +1,201 @@
-#include <scorum/chain/database/database.hpp>
-#include <scorum/protocol/block.hpp>
-#include <fc/io/raw.hpp>
+#include <scorum/chain/block_log.hpp>
 
-int main(int argc, char** argv, char** envp)
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Verifies a block log of a stopped node by all cores:
+//
+//   test_block_log blockchain/block_log
+//
+// Every block is read by its index position, its number, the link to the previous block and the position
+// of the next block are checked. The log is opened read only, so problems which the node repairs on open,
+// e.g. an index which doesn't match the log, are reported as errors and the files are not changed.
+
+namespace {
+
+using scorum::chain::block_log;
+using scorum::protocol::block_id_type;
+
+const uint32_t blocks_per_range = 10000;
+const size_t max_reported_errors = 100;
+
+class verifier
 {
-    try
+public:
+    verifier(const block_log& log, uint32_t first_block_num, uint32_t head_block_num)
+        : _log(log)
+        , _first_block_num(first_block_num)
+        , _head_block_num(head_block_num)
+        , _next_range_begin(first_block_num)
     {
-        // scorum::chain::database db;
-        scorum::chain::block_log log;
+    }
 
-        fc::temp_directory temp_dir(".");
+    void run()
+    {
+        for (;;)
+        {
+            const uint32_t begin = _next_range_begin.fetch_add(blocks_per_range);
+            if (begin > _head_block_num || begin < _first_block_num)
+                return;
 
-        // db.open( temp_dir );
-        log.open(temp_dir.path() / "log");
+            verify_range(begin, std::min(_head_block_num, begin + blocks_per_range - 1));
+        }
+    }
 
-        idump((log.head()));
+    uint32_t verified() const
+    {
+        return _verified;
+    }
 
-        scorum::protocol::signed_block b1;
-        b1.witness = "alice";
-        b1.previous = scorum::protocol::block_id_type();
+    std::vector<std::string> errors() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _errors;
+    }
 
-        log.append(b1);
-        log.flush();
-        idump((b1));
-        idump((log.head()));
-        idump((fc::raw::pack_size(b1)));
+    size_t errors_count() const
+    {
+        return _errors_count;
+    }
 
-        scorum::protocol::signed_block b2;
-        b2.witness = "bob";
-        b2.previous = b1.id();
+private:
+    void verify_range(uint32_t begin, uint32_t end)
+    {
+        // previous block of the first one in the log is not kept, except the genesis one
+        fc::optional<block_id_type> previous_id;
+        if (begin == 1)
+            previous_id = block_id_type();
+        else if (begin > _first_block_num)
+            previous_id = read_id(begin - 1);
 
-        log.append(b2);
-        log.flush();
-        idump((b2));
-        idump((log.head()));
-        idump((fc::raw::pack_size(b2)));
+        for (uint32_t num = begin; num <= end; ++num)
+        {
+            try
+            {
+                const uint64_t pos = _log.get_block_pos(num);
+                FC_ASSERT(pos != block_log::npos, "There is no position in the index");
 
-        auto r1 = log.read_block(0);
-        idump((r1));
-        idump((fc::raw::pack_size(r1.first)));
+                auto block = _log.read_block(pos);
+                FC_ASSERT(block.first.block_num() == num, "Block ${n} is read at the position",
+                          ("n", block.first.block_num()));
+                FC_ASSERT(!previous_id.valid() || block.first.previous == *previous_id,
+                          "Previous block id ${id} doesn't match", ("id", block.first.previous));
 
-        auto r2 = log.read_block(r1.second);
-        idump((r2));
-        idump((fc::raw::pack_size(r2.first)));
+                if (num < _head_block_num)
+                {
+                    FC_ASSERT(block.second == _log.get_block_pos(num + 1),
+                              "Position of the next block ${pos} doesn't match the index", ("pos", block.second));
+                }
 
-        idump((log.read_head()));
-        idump((fc::raw::pack_size(log.read_head())));
+                previous_id = block.first.id();
+                ++_verified;
+            }
+            catch (const fc::exception& e)
+            {
+                report(num, e.to_string());
+                previous_id.reset();
+            }
+        }
+    }
 
-        auto r3 = log.read_block(r2.second);
-        idump((r3));
+    fc::optional<block_id_type> read_id(uint32_t num)
+    {
+        try
+        {
+            auto block = _log.read_block_by_num(num);
+            if (block.valid())
+                return block->id();
+        }
+        catch (const fc::exception&)
+        {
+            // the error is reported by the range of the block
+        }
+        return {};
     }
-    catch (const std::exception& e)
+
+    void report(uint32_t num, const std::string& error)
     {
-        edump((std::string(e.what())));
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (++_errors_count <= max_reported_errors)
+            _errors.push_back("block " + std::to_string(num) + ": " + error);
     }
 
-    return 0;
-}
\ No newline at end of file
+    const block_log& _log;
+    const uint32_t _first_block_num;
+    const uint32_t _head_block_num;
+
+    std::atomic<uint32_t> _next_range_begin;
+    std::atomic<uint32_t> _verified{ 0 };
+
+    mutable std::mutex _mutex;
+    std::vector<std::string> _errors;
+    size_t _errors_count = 0;
+};
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        if (argc < 2 || argc > 3)
+        {
+            std::cerr << "test_block_log <block log> [threads]\n"
+                         "\n"
+                         "Checks block numbers, links to previous blocks and positions of all blocks in the log.\n"
+                         "The log is read by the given number of threads, all cores by default.\n";
+            return 1;
+        }
+
+        const fc::path file(argv[1]);
+        const uint32_t threads_count
+            = argc > 2 ? std::stoul(argv[2]) : std::max(std::thread::hardware_concurrency(), 1u);
+
+        block_log log;
+        log.open_read_only(file);
+
+        const auto problems = log.problems();
+        for (const auto& problem : problems)
+            elog("${p}", ("p", problem));
+
+        FC_ASSERT(log.head().valid(), "There is no block log ${f}", ("f", file.generic_string()));
+
+        const uint32_t first_block_num = log.first_block_num();
+        const uint32_t head_block_num = log.head()->block_num();
+        ilog("Verifying blocks ${f}..${h} by ${t} threads",
+             ("f", first_block_num)("h", head_block_num)("t", threads_count));
+
+        const auto start = fc::time_point::now();
+
+        verifier v(log, first_block_num, head_block_num);
+
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < threads_count; ++i)
+            threads.emplace_back([&]() { v.run(); });
+        for (auto& thread : threads)
+            thread.join();
+
+        for (const auto& error : v.errors())
+            elog("${e}", ("e", error));
+
+        const size_t errors_count = v.errors_count() + problems.size();
+        ilog("${n} blocks are verified, ${e} errors, elapsed time: ${t} sec",
+             ("n", v.verified())("e", errors_count)(
+                 "t", double((fc::time_point::now() - start).count()) / 1000000.0));
+
+        return errors_count ? 1 : 0;
+    }
+    catch (const fc::exception& e)
+    {
+        edump((e.to_detail_string()));
+        return 1;
+    }
+}
@@ -81,6 +81,24 @@ void db_setup_and_open(database& db, const fc::path& path)
     db.open(path, path, TEST_SHARED_MEM_SIZE_10MB, chainbase::database::read_write, genesis);
 }
 
+// pushes a transaction creating the account owned by the init key, the transaction is signed by key
+void push_account_create(database& db, const std::string& name, const fc::ecc::private_key& key)
+{
+    auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string(TEST_INIT_KEY)));
+
+    signed_transaction trx;
+    account_create_operation cop;
+    cop.new_account_name = name;
+    cop.creator = TEST_INIT_DELEGATE_NAME;
+    cop.owner = authority(1, public_key_type(init_account_priv_key.get_public_key()), 1);
+    cop.fee = SUFFICIENT_FEE;
+    cop.active = cop.owner;
+    trx.operations.push_back(cop);
+    trx.set_expiration(db.head_block_time() + SCORUM_MAX_TIME_UNTIL_EXPIRATION);
+    trx.sign(key, db.get_chain_id());
+    PUSH_TX(db, trx, database::skip_transaction_signatures | database::skip_authority_check);
+}
+
 BOOST_AUTO_TEST_CASE(generate_empty_blocks)
 {
     try
@@ -143,6 +161,105 @@ BOOST_AUTO_TEST_CASE(generate_empty_blocks)
     }
 }
 
+BOOST_AUTO_TEST_CASE(compact_shared_file)
+{
+    try
+    {
+        fc::temp_directory data_dir(graphene::utilities::temp_directory_path());
+        auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string(TEST_INIT_KEY)));
+        {
+            database db(database::opt_default);
+            db_setup_and_open(db, data_dir.path());
+            while (db.obtain_service<dbs_dynamic_global_property>().get().last_irreversible_block_num < 50)
+            {
+                db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                  database::skip_nothing);
+            }
+            db.close();
+        }
+
+        database db(database::opt_default);
+        db_setup_and_open(db, data_dir.path());
+
+        const auto head_block_id = db.head_block_id();
+        std::map<uint16_t, uint64_t> counts;
+        db.with_read_lock([&]() {
+            for (const auto& index : db.get_index_statistic())
+                counts[index.type_id] = index.count;
+        });
+
+        auto genesis = database_integration_fixture::create_default_genesis_state();
+        BOOST_REQUIRE_NO_THROW(db.compact_shared_file(data_dir.path(), data_dir.path(), TEST_SHARED_MEM_SIZE_10MB,
+                                                      db.get_reindex_skip_flags(), genesis));
+
+        BOOST_CHECK(db.head_block_id() == head_block_id);
+        BOOST_CHECK(!fc::exists(data_dir.path() / "compaction"));
+
+        db.with_read_lock([&]() {
+            const auto indices = db.get_index_statistic();
+            BOOST_REQUIRE_EQUAL(indices.size(), counts.size());
+            for (const auto& index : indices)
+                BOOST_CHECK_MESSAGE(counts[index.type_id] == index.count, index.name);
+
+            BOOST_CHECK_NO_THROW(db.validate_invariants());
+        });
+
+        db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                          database::skip_nothing);
+        BOOST_CHECK(db.head_block_id() != head_block_id);
+    }
+    catch (fc::exception& e)
+    {
+        edump((e.to_detail_string()));
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(compact_shared_file_with_block_log_write_queue)
+{
+    try
+    {
+        fc::temp_directory data_dir(graphene::utilities::temp_directory_path());
+        auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string(TEST_INIT_KEY)));
+        {
+            // state isn't committed past queued blocks, so the block log can get ahead of the saved state
+            database db(database::opt_default);
+            db.set_block_log_write_queue_size(100);
+            db_setup_and_open(db, data_dir.path());
+            while (db.obtain_service<dbs_dynamic_global_property>().get().last_irreversible_block_num < 50)
+            {
+                db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                  database::skip_nothing);
+            }
+            db.close();
+        }
+
+        database db(database::opt_default);
+        db.set_block_log_write_queue_size(100);
+        db_setup_and_open(db, data_dir.path());
+
+        auto genesis = database_integration_fixture::create_default_genesis_state();
+        BOOST_REQUIRE_NO_THROW(db.compact_shared_file(data_dir.path(), data_dir.path(), TEST_SHARED_MEM_SIZE_10MB,
+                                                      db.get_reindex_skip_flags(), genesis));
+
+        // the block log tail is replayed after compaction
+        BOOST_CHECK(!db.fetch_block_by_number(db.head_block_num() + 1).valid());
+        BOOST_CHECK(!fc::exists(data_dir.path() / "compaction"));
+
+        db.with_read_lock([&]() { BOOST_CHECK_NO_THROW(db.validate_invariants()); });
+
+        const auto head_block_id = db.head_block_id();
+        db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                          database::skip_nothing);
+        BOOST_CHECK(db.head_block_id() != head_block_id);
+    }
+    catch (fc::exception& e)
+    {
+        edump((e.to_detail_string()));
+        throw;
+    }
+}
+
 BOOST_AUTO_TEST_CASE(undo_block)
 {
     try
@@ -396,6 +513,129 @@ BOOST_AUTO_TEST_CASE(duplicate_transactions)
     }
 }
 
+BOOST_AUTO_TEST_CASE(push_block_with_recovered_signatures)
+{
+    try
+    {
+        fc::temp_directory dir1(graphene::utilities::temp_directory_path());
+        fc::temp_directory dir2(graphene::utilities::temp_directory_path());
+
+        database db1(database::opt_default);
+        db_setup_and_open(db1, dir1.path());
+        database db2(database::opt_default);
+        db_setup_and_open(db2, dir2.path());
+        db2.set_signature_recovery_threads(2);
+
+        auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+
+        auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string(TEST_INIT_KEY)));
+        auto wrong_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string("wrong")));
+
+        for (int i = 1; i <= 5; ++i)
+            push_account_create(db1, "alice" + std::to_string(i), init_account_priv_key);
+
+        auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key,
+                                    skip_sigs);
+        BOOST_REQUIRE_EQUAL(b.transactions.size(), 5u);
+
+        PUSH_BLOCK(db2, b);
+        BOOST_CHECK(db2.head_block_id() == b.id());
+
+        // block with a transaction signed by a wrong key is rejected as without recovery
+        push_account_create(db1, "bob", init_account_priv_key);
+        push_account_create(db1, "sam", wrong_priv_key);
+
+        b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, skip_sigs);
+        BOOST_REQUIRE_EQUAL(b.transactions.size(), 2u);
+
+        SCORUM_CHECK_THROW(PUSH_BLOCK(db2, b), fc::exception);
+        BOOST_CHECK_EQUAL(db2.head_block_num(), 1u);
+    }
+    catch (fc::exception& e)
+    {
+        edump((e.to_detail_string()));
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(push_prevalidated_blocks)
+{
+    try
+    {
+        fc::temp_directory dir1(graphene::utilities::temp_directory_path());
+        fc::temp_directory dir2(graphene::utilities::temp_directory_path());
+
+        database db1(database::opt_default);
+        db_setup_and_open(db1, dir1.path());
+        database db2(database::opt_default);
+        db_setup_and_open(db2, dir2.path());
+        db2.set_signature_recovery_threads(2);
+
+        auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+
+        auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string(TEST_INIT_KEY)));
+        auto wrong_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string("wrong")));
+
+        std::vector<signed_block> blocks;
+        for (int i = 1; i <= 3; ++i)
+        {
+            push_account_create(db1, "alice" + std::to_string(i), init_account_priv_key);
+            push_account_create(db1, "bob" + std::to_string(i), init_account_priv_key);
+            blocks.push_back(db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1),
+                                                init_account_priv_key, skip_sigs));
+        }
+
+        // blocks are checked ahead in any order and applied in the chain order
+        for (auto itr = blocks.rbegin(); itr != blocks.rend(); ++itr)
+            db2.prevalidate_block(*itr);
+
+        for (const auto& b : blocks)
+            PUSH_BLOCK(db2, b);
+        BOOST_CHECK(db2.head_block_id() == db1.head_block_id());
+
+        // prevalidated block with a transaction signed by a wrong key is rejected
+        push_account_create(db1, "sam", wrong_priv_key);
+        auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key,
+                                    skip_sigs);
+
+        db2.prevalidate_block(b);
+        SCORUM_CHECK_THROW(PUSH_BLOCK(db2, b), fc::exception);
+        BOOST_CHECK_EQUAL(db2.head_block_num(), 3u);
+
+        // block id covers the header only, data prepared for other transactions isn't used
+        push_account_create(db1, "alice4", init_account_priv_key);
+        push_account_create(db1, "bob4", init_account_priv_key);
+        b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key,
+                               skip_sigs);
+
+        auto other_body = b;
+        other_body.transactions.pop_back();
+        BOOST_REQUIRE(other_body.id() == b.id());
+
+        db2.prevalidate_block(other_body);
+        PUSH_BLOCK(db2, b);
+        BOOST_CHECK(db2.head_block_id() == db1.head_block_id());
+
+        push_account_create(db1, "alice5", init_account_priv_key);
+        push_account_create(db1, "bob5", init_account_priv_key);
+        b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key,
+                               skip_sigs);
+
+        other_body = b;
+        other_body.transactions.pop_back();
+
+        db2.prevalidate_block(b);
+        SCORUM_CHECK_THROW(PUSH_BLOCK(db2, other_body), fc::exception);
+        PUSH_BLOCK(db2, b);
+        BOOST_CHECK(db2.head_block_id() == db1.head_block_id());
+    }
+    catch (fc::exception& e)
+    {
+        edump((e.to_detail_string()));
+        throw;
+    }
+}
+
 BOOST_AUTO_TEST_CASE(tapos)
 {
     try
@@ -615,6 +855,41 @@ BOOST_FIXTURE_TEST_CASE(pop_block_twice, database_default_integration_fixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(tracked_supply_follows_pop_block, database_default_integration_fixture)
+{
+    try
+    {
+        uint32_t skip_flags = (database::skip_witness_signature | database::skip_transaction_signatures
+                               | database::skip_authority_check);
+
+        generate_block(skip_flags);
+
+        account_create("sam", generate_private_key("sam").get_public_key());
+        transfer(TEST_INIT_DELEGATE_NAME, "sam", asset(100000, SCORUM_SYMBOL));
+        generate_block(skip_flags);
+
+        // pending transaction is undone and reapplied on every block
+        transfer("sam", TEST_INIT_DELEGATE_NAME, asset(1000, SCORUM_SYMBOL));
+        BOOST_REQUIRE_NO_THROW(db.validate_tracked_invariants());
+        generate_block(skip_flags);
+
+        account_create("alice", generate_private_key("alice").get_public_key());
+        generate_block(skip_flags);
+
+        // full check compares the tracked totals with the scan
+        validate_database();
+
+        db.pop_block();
+        BOOST_REQUIRE_NO_THROW(db.validate_tracked_invariants());
+        validate_database();
+
+        db.pop_block();
+        BOOST_REQUIRE_NO_THROW(db.validate_tracked_invariants());
+        validate_database();
+    }
+    FC_LOG_AND_RETHROW();
+}
+
 struct rsf_missed_blocks_fixture : public database_default_integration_fixture
 {
     rsf_missed_blocks_fixture()
@@ -0,0 +1,50 @@
+#include <boost/test/unit_test.hpp>
+
+#include <scorum/chain/services/dynamic_global_property.hpp>
+#include <scorum/chain/schema/dynamic_global_property_object.hpp>
+
+#include <atomic>
+#include <thread>
+
+#include "database_default_integration.hpp"
+
+using namespace scorum::chain;
+
+BOOST_FIXTURE_TEST_SUITE(database_read_lock_tests, database_fixture::database_default_integration_fixture)
+
+SCORUM_TEST_CASE(read_through_service_getter_is_retried_after_writer)
+{
+    db.set_writer_priority(true);
+
+    auto& dgp_service = db.dynamic_global_property_service();
+    const uint64_t aslot = dgp_service.get().current_aslot;
+
+    std::atomic<int> attempts{ 0 };
+    std::atomic<bool> written{ false };
+
+    uint64_t read_aslot = 0;
+    std::thread reader([&]() {
+        read_aslot = db.with_read_lock([&]() {
+            ++attempts;
+            // the getter wraps the access by FC_CAPTURE_AND_RETHROW
+            while (!written)
+                dgp_service.get();
+            return dgp_service.get().current_aslot;
+        });
+    });
+
+    while (!attempts)
+        std::this_thread::yield();
+
+    db.with_write_lock([&]() {
+        dgp_service.update([](dynamic_global_property_object& o) { ++o.current_aslot; });
+        written = true;
+    });
+
+    reader.join();
+
+    BOOST_CHECK_EQUAL(attempts, 2);
+    BOOST_CHECK_EQUAL(read_aslot, aslot + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
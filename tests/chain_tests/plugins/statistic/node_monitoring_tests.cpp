@@ -5,8 +5,10 @@
 #include <scorum/blockchain_monitoring/blockchain_monitoring_plugin.hpp>
 #include <scorum/blockchain_monitoring/node_monitoring_api.hpp>
 
+#include <scorum/chain/schema/dynamic_global_property_object.hpp>
 #include <scorum/protocol/block.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
@@ -84,4 +86,58 @@ SCORUM_TEST_CASE(check_free_shared_memory)
     BOOST_REQUIRE_GT(_api_call.get_free_shared_memory_mb(), 0u);
 }
 
+SCORUM_TEST_CASE(check_index_statistic)
+{
+    generate_block();
+
+    const auto statistic = _api_call.get_index_statistic();
+    BOOST_REQUIRE(!statistic.empty());
+
+    auto it = std::find_if(statistic.begin(), statistic.end(), [](const auto& item) {
+        return item.type_id == chain::dynamic_global_property_object::type_id;
+    });
+    BOOST_REQUIRE(it != statistic.end());
+
+    BOOST_CHECK_EQUAL(it->count, 1u);
+    BOOST_CHECK_GT(it->bytes, 0u);
+    BOOST_CHECK_GE(it->created, 1u);
+    BOOST_CHECK_GE(it->modified, it->last_block.modified);
+    BOOST_CHECK_GT(it->last_block.modified, 0u); // head block is updated by every block
+}
+
+SCORUM_TEST_CASE(check_pool_statistic)
+{
+    generate_block();
+
+    for (const auto& pool : _api_call.get_pool_statistic())
+    {
+        BOOST_CHECK(!pool.name.empty());
+        BOOST_CHECK_GT(pool.node_size, 0u);
+        BOOST_CHECK_LE(pool.free_nodes, pool.nodes);
+    }
+}
+
+SCORUM_TEST_CASE(check_lock_statistic)
+{
+    BOOST_CHECK(_api_call.get_lock_statistic().empty());
+
+    db.set_lock_statistic(true);
+    {
+        chainbase::lock_tag_scope tag("test");
+        generate_block();
+    }
+
+    const auto statistic = _api_call.get_lock_statistic();
+
+    auto it = std::find_if(statistic.begin(), statistic.end(),
+                           [](const auto& item) { return item.tag == "test" && item.lock == "write"; });
+    BOOST_REQUIRE(it != statistic.end());
+
+    BOOST_CHECK(!it->site.empty());
+    BOOST_CHECK_GE(it->hold.count, 1u);
+    BOOST_CHECK_EQUAL(it->hold.buckets.size(), chainbase::lock_statistic_collector::buckets_count);
+
+    db.set_lock_statistic(false);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
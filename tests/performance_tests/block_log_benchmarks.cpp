@@ -0,0 +1,121 @@
+#include <boost/test/unit_test.hpp>
+
+#include "defines.hpp"
+
+#include <scorum/chain/block_log.hpp>
+#include <scorum/protocol/scorum_operations.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <random>
+#include <sstream>
+
+#include "performance_common.hpp"
+
+// Read throughput of the raw and the compressed block log formats, e.g.
+//
+//   PERFORMANCE_RESULTS=results.json performance_tests --run_test=block_log_benchmarks --log_level=message
+
+namespace block_log_benchmarks {
+
+using namespace scorum::chain;
+using namespace scorum::protocol;
+
+using performance_common::cpu_profiler;
+using performance_common::report;
+
+const uint32_t blocks_count = 20000;
+const uint32_t transactions_per_block = 10;
+
+signed_block make_block(uint32_t num, const block_id_type& previous)
+{
+    signed_block b;
+    b.previous = previous;
+    b.timestamp = fc::time_point_sec(num * SCORUM_BLOCK_INTERVAL);
+    b.witness = "witness" + std::to_string(num % 21);
+
+    for (uint32_t i = 0; i < transactions_per_block; ++i)
+    {
+        transfer_operation op;
+        op.from = "alice" + std::to_string(i);
+        op.to = "bob" + std::to_string(num % 100);
+        op.amount = asset(num + i, SCORUM_SYMBOL);
+        op.memo = "payment for the block " + std::to_string(num);
+
+        signed_transaction trx;
+        trx.ref_block_num = num & 0xffff;
+        trx.set_expiration(b.timestamp + SCORUM_MAX_TIME_UNTIL_EXPIRATION);
+        trx.operations.push_back(op);
+        trx.signatures.resize(1);
+        b.transactions.push_back(trx);
+    }
+
+    return b;
+}
+
+uint64_t files_size(const fc::path& file)
+{
+    uint64_t size = fc::file_size(file);
+    if (fc::exists(block_log::block_log_tail_path(file)))
+        size += fc::file_size(block_log::block_log_tail_path(file));
+    return size;
+}
+
+void measure_reads(uint32_t blocks_per_chunk)
+{
+    fc::temp_directory dir(graphene::utilities::temp_directory_path());
+    const fc::path file = dir.path() / "block_log";
+
+    block_log log;
+    log.open(file, blocks_per_chunk);
+
+    block_id_type previous;
+    for (uint32_t num = 1; num <= blocks_count; ++num)
+    {
+        auto b = make_block(num, previous);
+        previous = b.id();
+        log.append(b);
+    }
+    log.flush();
+
+    std::stringstream params;
+    params << "blocks_per_chunk=" << blocks_per_chunk << " size=" << files_size(file);
+
+    {
+        // the way replay walks the log
+        cpu_profiler prof;
+        auto itr = log.read_block(0);
+        for (uint32_t num = 1; num < blocks_count; ++num)
+            itr = log.read_block(itr.second);
+        report("sequential_read", params.str(), blocks_count, prof.elapsed_microseconds());
+
+        BOOST_CHECK_EQUAL(itr.first.block_num(), blocks_count);
+    }
+    {
+        std::mt19937 rand(1);
+        std::uniform_int_distribution<uint32_t> nums(1, blocks_count);
+
+        cpu_profiler prof;
+        for (uint32_t i = 0; i < blocks_count; ++i)
+            log.read_block_by_num(nums(rand));
+        report("random_read", params.str(), blocks_count, prof.elapsed_microseconds());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(block_log_benchmarks)
+
+SCORUM_TEST_CASE(raw_log_reads)
+{
+    measure_reads(0);
+}
+
+SCORUM_TEST_CASE(compressed_log_reads)
+{
+    measure_reads(10);
+    measure_reads(100);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
@@ -0,0 +1,291 @@
+#include <boost/test/unit_test.hpp>
+
+#include "defines.hpp"
+
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <scorum/chain/schema/account_objects.hpp>
+
+#include <db_mock.hpp>
+
+#include <random>
+#include <sstream>
+#include <type_traits>
+
+#include "performance_common.hpp"
+
+// Baseline of chainbase operations cost. Results are printed with --log_level=message and appended
+// as JSON lines to the file from PERFORMANCE_RESULTS environment variable, e.g.
+//
+//   PERFORMANCE_RESULTS=results.json performance_tests --run_test=chainbase_benchmarks --log_level=message
+
+namespace chainbase_benchmarks {
+
+using namespace boost::multi_index;
+
+using performance_common::cpu_profiler;
+using performance_common::report;
+
+struct by_id;
+struct by_key;
+struct by_value;
+struct by_value_key;
+
+template <size_t PayloadSize, size_t IndicesCount>
+struct bench_object : public chainbase::object<0, bench_object<PayloadSize, IndicesCount>>
+{
+    CHAINBASE_DEFAULT_CONSTRUCTOR(bench_object)
+
+    typename bench_object::id_type id;
+
+    uint64_t key = 0;
+    uint64_t value = 0;
+
+    char payload[PayloadSize] = {};
+};
+
+template <typename Object, size_t IndicesCount> struct bench_indices;
+
+template <typename Object> struct bench_indices<Object, 1>
+{
+    using type = indexed_by<ordered_unique<tag<by_id>, member<Object, typename Object::id_type, &Object::id>>>;
+};
+
+template <typename Object> struct bench_indices<Object, 2>
+{
+    using type = indexed_by<ordered_unique<tag<by_id>, member<Object, typename Object::id_type, &Object::id>>,
+                            ordered_unique<tag<by_key>, member<Object, uint64_t, &Object::key>>>;
+};
+
+template <typename Object> struct bench_indices<Object, 4>
+{
+    using type = indexed_by<ordered_unique<tag<by_id>, member<Object, typename Object::id_type, &Object::id>>,
+                            ordered_unique<tag<by_key>, member<Object, uint64_t, &Object::key>>,
+                            ordered_non_unique<tag<by_value>, member<Object, uint64_t, &Object::value>>,
+                            ordered_unique<tag<by_value_key>,
+                                           composite_key<Object,
+                                                         member<Object, uint64_t, &Object::value>,
+                                                         member<Object, uint64_t, &Object::key>>>>;
+};
+
+template <size_t PayloadSize, size_t IndicesCount>
+using bench_index
+    = fc::shared_multi_index_container<bench_object<PayloadSize, IndicesCount>,
+                                       typename bench_indices<bench_object<PayloadSize, IndicesCount>, IndicesCount>::type>;
+}
+
+namespace chainbase {
+template <size_t PayloadSize, size_t IndicesCount>
+struct get_index_type<chainbase_benchmarks::bench_object<PayloadSize, IndicesCount>>
+{
+    typedef chainbase_benchmarks::bench_index<PayloadSize, IndicesCount> type;
+};
+}
+
+namespace chainbase_benchmarks {
+
+const size_t objects_count = 20'000;
+
+template <size_t PayloadSize, size_t IndicesCount> struct bench_database
+{
+    using object_type = bench_object<PayloadSize, IndicesCount>;
+    using index_type = bench_index<PayloadSize, IndicesCount>;
+
+    db_mock db{ 1024 * 1024 * 512 };
+
+    bench_database()
+    {
+        db.add_index<index_type>();
+    }
+
+    static std::string params()
+    {
+        std::stringstream s;
+        s << "payload=" << PayloadSize << " indices=" << IndicesCount << " objects=" << objects_count;
+        return s.str();
+    }
+
+    void create_all()
+    {
+        for (size_t i = 0; i < objects_count; ++i)
+        {
+            db.template create<object_type>([&](object_type& o) {
+                o.key = i;
+                o.value = i % 100;
+            });
+        }
+    }
+
+    // moves objects in every index, so the trees are rebalanced
+    void modify_all()
+    {
+        for (const auto& o : db.template get_index<index_type>().indices())
+        {
+            db.modify(o, [&](object_type& m) {
+                m.key += objects_count;
+                m.value++;
+            });
+        }
+    }
+
+    void remove_all()
+    {
+        const auto& objects = db.template get_index<index_type>().indices();
+        while (!objects.empty())
+            db.remove(*objects.begin());
+    }
+};
+
+template <size_t PayloadSize, size_t IndicesCount> void measure_create_modify_remove()
+{
+    bench_database<PayloadSize, IndicesCount> bench;
+    const auto params = bench.params();
+
+    {
+        cpu_profiler prof;
+        bench.create_all();
+        report("create", params, objects_count, prof.elapsed_microseconds());
+    }
+    {
+        cpu_profiler prof;
+        bench.modify_all();
+        report("modify", params, objects_count, prof.elapsed_microseconds());
+    }
+    {
+        cpu_profiler prof;
+        bench.remove_all();
+        report("remove", params, objects_count, prof.elapsed_microseconds());
+    }
+
+    BOOST_CHECK(bench.db.template get_index<typename decltype(bench)::index_type>().indices().empty());
+}
+
+template <size_t PayloadSize, size_t IndicesCount> void measure_undo_session()
+{
+    bench_database<PayloadSize, IndicesCount> bench;
+    const auto params = bench.params();
+
+    bench.create_all();
+
+    const size_t sessions = 100;
+
+    // every operation is made under the session, the cost is the session overhead and copying of the pre-images
+    {
+        cpu_profiler prof;
+        for (size_t i = 0; i < sessions; ++i)
+        {
+            auto session = bench.db.start_undo_session();
+            bench.modify_all();
+        }
+        report("modify_undo", params, sessions * objects_count, prof.elapsed_microseconds());
+    }
+    {
+        cpu_profiler prof;
+        for (size_t i = 0; i < sessions; ++i)
+        {
+            // transaction is merged into the block the same way database::_push_transaction does
+            auto block = bench.db.start_undo_session();
+            {
+                auto trx = bench.db.start_undo_session();
+                bench.modify_all();
+                bench.db.squash();
+                trx->push();
+            }
+        }
+        report("modify_squash_undo", params, sessions * objects_count, prof.elapsed_microseconds());
+    }
+    {
+        cpu_profiler prof;
+        for (size_t i = 0; i < sessions; ++i)
+        {
+            auto session = bench.db.start_undo_session();
+            bench.modify_all();
+            session->push();
+            bench.db.commit(bench.db.revision());
+        }
+        report("modify_commit", params, sessions * objects_count, prof.elapsed_microseconds());
+    }
+    {
+        // the session itself when nothing is changed
+        cpu_profiler prof;
+        for (size_t i = 0; i < sessions * objects_count; ++i)
+        {
+            auto session = bench.db.start_undo_session();
+        }
+        report("empty_session", params, sessions * objects_count, prof.elapsed_microseconds());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(chainbase_benchmarks)
+
+SCORUM_TEST_CASE(create_modify_remove)
+{
+    measure_create_modify_remove<16, 1>();
+    measure_create_modify_remove<16, 2>();
+    measure_create_modify_remove<16, 4>();
+    measure_create_modify_remove<256, 2>();
+    measure_create_modify_remove<1024, 2>();
+}
+
+SCORUM_TEST_CASE(undo_session)
+{
+    measure_undo_session<16, 1>();
+    measure_undo_session<16, 2>();
+    measure_undo_session<16, 4>();
+    measure_undo_session<256, 2>();
+    measure_undo_session<1024, 2>();
+}
+
+SCORUM_TEST_CASE(lookup_by_name)
+{
+    using namespace scorum::chain;
+
+    db_mock db{ 1024 * 1024 * 256 };
+    db.add_index<account_index>();
+
+    std::vector<account_name_type> names;
+    std::vector<account_name_type> missing_names;
+    for (size_t i = 0; i < objects_count; ++i)
+    {
+        names.emplace_back("account" + std::to_string(i));
+        missing_names.emplace_back("missing" + std::to_string(i));
+        db.create<account_object>([&](account_object& a) { a.name = names.back(); });
+    }
+
+    std::mt19937 rng(objects_count);
+    std::shuffle(names.begin(), names.end(), rng);
+
+    const auto& accounts = db.get_index<account_index, by_name>();
+    const size_t cycles = 10;
+
+    size_t found = 0;
+    {
+        cpu_profiler prof;
+        for (size_t ci = 0; ci < cycles; ++ci)
+        {
+            for (const auto& name : names)
+                found += accounts.find(name) != accounts.end();
+        }
+        report("find_by_name", "objects=" + std::to_string(objects_count), cycles * objects_count,
+               prof.elapsed_microseconds());
+    }
+    BOOST_REQUIRE_EQUAL(found, cycles * objects_count);
+
+    size_t missed = 0;
+    {
+        cpu_profiler prof;
+        for (size_t ci = 0; ci < cycles; ++ci)
+        {
+            for (const auto& name : missing_names)
+                missed += accounts.find(name) == accounts.end();
+        }
+        report("find_by_name_missing", "objects=" + std::to_string(objects_count), cycles * objects_count,
+               prof.elapsed_microseconds());
+    }
+    BOOST_REQUIRE_EQUAL(missed, cycles * objects_count);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
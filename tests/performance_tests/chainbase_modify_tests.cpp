@@ -0,0 +1,115 @@
+#include <boost/test/unit_test.hpp>
+
+#include "defines.hpp"
+
+#include <scorum/chain/schema/account_objects.hpp>
+#include <scorum/chain/schema/comment_objects.hpp>
+
+#include <db_mock.hpp>
+
+#include "performance_common.hpp"
+
+namespace chainbase_modify_tests {
+
+using namespace scorum::chain;
+using namespace scorum::protocol;
+
+using performance_common::cpu_profiler;
+
+struct chainbase_modify_fixture
+{
+    const size_t objects_count = 10'000;
+
+    db_mock db{ 1024 * 1024 * 256 };
+
+    chainbase_modify_fixture()
+    {
+        db.add_index<account_index>();
+        db.add_index<comment_index>();
+
+        for (size_t i = 0; i < objects_count; ++i)
+        {
+            const std::string name = "account" + std::to_string(i);
+
+            db.create<account_object>([&](account_object& a) {
+                a.name = name;
+                fc::from_string(a.json_metadata, std::string(512, 'm'));
+            });
+            db.create<comment_object>([&](comment_object& c) {
+                c.author = name;
+                fc::from_string(c.permlink, name);
+                fc::from_string(c.title, std::string(128, 't'));
+                fc::from_string(c.body, std::string(4096, 'b'));
+            });
+        }
+    }
+
+    // modifies each object 'cycles' times, returns elapsed milliseconds
+    size_t modify_all(size_t cycles)
+    {
+        cpu_profiler prof;
+
+        for (size_t ci = 0; ci < cycles; ++ci)
+        {
+            for (const auto& account : db.get_index<account_index, by_id>())
+            {
+                db.modify(account, [&](account_object& a) { a.witnesses_voted_for++; });
+            }
+            for (const auto& comment : db.get_index<comment_index, by_id>())
+            {
+                db.modify(comment, [&](comment_object& c) { c.children++; });
+            }
+        }
+
+        return prof.elapsed();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(chainbase_modify_tests, chainbase_modify_fixture)
+
+SCORUM_TEST_CASE(modify_without_undo_session)
+{
+    const size_t cycles = 10;
+
+    const auto free_memory = db.get_free_memory();
+
+    auto ms = modify_all(cycles);
+
+    BOOST_TEST_MESSAGE("modify without undo session: " << ms << "ms");
+
+    // reindex path, pre-image must not be copied to the segment at all
+    BOOST_CHECK_EQUAL(free_memory, db.get_free_memory());
+}
+
+SCORUM_TEST_CASE(repeated_modify_in_undo_session)
+{
+    const size_t cycles = 10;
+
+    size_t single_modify_memory = 0u;
+    {
+        auto session = db.start_undo_session();
+
+        const auto free_memory = db.get_free_memory();
+        auto ms = modify_all(1);
+        single_modify_memory = free_memory - db.get_free_memory();
+
+        BOOST_TEST_MESSAGE("single modify in undo session: " << ms << "ms, " << single_modify_memory << " bytes");
+    }
+
+    size_t repeated_modify_memory = 0u;
+    {
+        auto session = db.start_undo_session();
+
+        const auto free_memory = db.get_free_memory();
+        auto ms = modify_all(cycles);
+        repeated_modify_memory = free_memory - db.get_free_memory();
+
+        BOOST_TEST_MESSAGE("repeated modify in undo session: " << ms << "ms, " << repeated_modify_memory << " bytes");
+    }
+
+    // undo state keeps a single pre-image per object and revision
+    BOOST_CHECK_EQUAL(repeated_modify_memory, single_modify_memory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
@@ -1,5 +1,13 @@
 #include "performance_common.hpp"
 
+#include <boost/test/unit_test.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/reflect/variant.hpp>
+
+#include <cstdlib>
+#include <fstream>
+
 namespace performance_common {
 cpu_profiler::cpu_profiler()
 {
@@ -11,4 +19,31 @@ size_t cpu_profiler::elapsed() const
     auto now = std::chrono::steady_clock::now();
     return (size_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - _start).count();
 }
+
+size_t cpu_profiler::elapsed_microseconds() const
+{
+    auto now = std::chrono::steady_clock::now();
+    return (size_t)std::chrono::duration_cast<std::chrono::microseconds>(now - _start).count();
+}
+
+void report(const std::string& name, const std::string& params, uint64_t operations, uint64_t elapsed_us)
+{
+    benchmark_result result;
+    result.name = name;
+    result.params = params;
+    result.operations = operations;
+    result.elapsed_us = elapsed_us;
+    result.ns_per_operation = operations ? elapsed_us * 1000 / operations : 0;
+    result.operations_per_second = elapsed_us ? operations * 1000000 / elapsed_us : 0;
+
+    BOOST_TEST_MESSAGE(name << " " << params << ": " << result.ns_per_operation << " ns/op, "
+                            << result.operations_per_second << " op/s");
+
+    const char* file = std::getenv("PERFORMANCE_RESULTS");
+    if (file && *file)
+    {
+        std::ofstream out(file, std::ios::app);
+        out << fc::json::to_string(fc::variant(result)) << std::endl;
+    }
+}
 }
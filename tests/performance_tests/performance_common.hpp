@@ -1,5 +1,10 @@
+#pragma once
+
 #include <chrono>
 #include <algorithm>
+#include <string>
+
+#include <fc/reflect/reflect.hpp>
 
 namespace performance_common {
 class cpu_profiler
@@ -10,7 +15,25 @@ public:
     // milliseconds
     size_t elapsed() const;
 
+    size_t elapsed_microseconds() const;
+
 private:
     std::chrono::time_point<std::chrono::steady_clock> _start;
 };
+
+struct benchmark_result
+{
+    std::string name;
+    std::string params;
+    uint64_t operations = 0;
+    uint64_t elapsed_us = 0;
+    uint64_t ns_per_operation = 0;
+    uint64_t operations_per_second = 0;
+};
+
+// prints the result and appends it as a JSON line to the file from PERFORMANCE_RESULTS environment variable
+void report(const std::string& name, const std::string& params, uint64_t operations, uint64_t elapsed_us);
 }
+
+FC_REFLECT(performance_common::benchmark_result,
+           (name)(params)(operations)(elapsed_us)(ns_per_operation)(operations_per_second))
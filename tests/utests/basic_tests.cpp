@@ -406,6 +406,34 @@ BOOST_AUTO_TEST_CASE(merkle_root)
     BOOST_CHECK(block.calculate_merkle_root() == c(dO));
 }
 
+BOOST_AUTO_TEST_CASE(signed_transaction_digests_match)
+{
+    signed_transaction tx;
+    tx.ref_block_num = 1;
+    tx.ref_block_prefix = 2;
+    tx.expiration = fc::time_point_sec(100);
+
+    transfer_operation op;
+    op.from = "alice";
+    op.to = "bob";
+    op.amount = asset(1, SCORUM_SYMBOL);
+    tx.operations.push_back(op);
+
+    const auto chain_id = chain_id_type::hash(std::string("test"));
+    tx.sign(fc::ecc::private_key::regenerate(fc::sha256::hash(std::string("alice"))), chain_id);
+
+    signed_transaction_digests digests(tx, chain_id);
+
+    BOOST_CHECK(digests.id == tx.id());
+    BOOST_CHECK(digests.sig_digest == tx.sig_digest(chain_id));
+    BOOST_CHECK(digests.merkle_digest == tx.merkle_digest());
+    BOOST_CHECK_EQUAL(digests.packed_size, fc::raw::pack_size(tx));
+
+    signed_block block;
+    block.transactions.push_back(tx);
+    BOOST_CHECK(signed_block::calculate_merkle_root({ digests.merkle_digest }) == block.calculate_merkle_root());
+}
+
 BOOST_AUTO_TEST_CASE(format_string)
 {
     const fc::string etalon("'ABC' [101 = 101, 102 = 102]");
@@ -0,0 +1,427 @@
+#include <boost/test/unit_test.hpp>
+
+#include <scorum/chain/block_log.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+#include "defines.hpp"
+
+namespace block_log_tests {
+
+using namespace scorum::chain;
+using namespace scorum::protocol;
+
+struct fixture
+{
+    fixture()
+        : dir(graphene::utilities::temp_directory_path())
+    {
+    }
+
+    signed_block make_block(uint32_t num)
+    {
+        signed_block b;
+        b.previous = num > 1 ? blocks.back().id() : block_id_type();
+        b.timestamp = fc::time_point_sec(num * SCORUM_BLOCK_INTERVAL);
+        b.witness = "alice";
+        blocks.push_back(b);
+        return b;
+    }
+
+    fc::path log_path() const
+    {
+        return dir.path() / "block_log";
+    }
+
+    /// Appends count blocks while they are read by other threads, returns number of wrong reads
+    uint32_t append_while_read(block_log& log, uint32_t count)
+    {
+        for (uint32_t num = 1; num <= count; ++num)
+            make_block(num);
+
+        log.append(blocks[0]);
+        log.flush();
+
+        std::atomic<bool> done(false);
+        std::atomic<uint32_t> errors(0);
+
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 4; ++i)
+        {
+            readers.emplace_back([&]() {
+                while (!done)
+                {
+                    for (uint32_t num = 1; num <= count; num += 7)
+                    {
+                        try
+                        {
+                            auto b = log.read_block_by_num(num);
+                            if (b.valid() && b->id() != blocks[num - 1].id())
+                                ++errors;
+                        }
+                        catch (...)
+                        {
+                            ++errors;
+                        }
+                    }
+                }
+            });
+        }
+
+        for (uint32_t num = 2; num <= count; ++num)
+        {
+            log.append(blocks[num - 1]);
+            if (num % 10 == 0)
+                log.flush();
+        }
+        log.flush();
+
+        done = true;
+        for (auto& reader : readers)
+            reader.join();
+
+        return errors.load();
+    }
+
+    fc::temp_directory dir;
+    std::vector<signed_block> blocks;
+};
+
+BOOST_FIXTURE_TEST_SUITE(block_log_tests, fixture)
+
+SCORUM_TEST_CASE(appended_blocks_are_read_back)
+{
+    block_log log;
+    log.open(log_path());
+
+    for (uint32_t num = 1; num <= 10; ++num)
+        log.append(make_block(num));
+
+    // not flushed blocks are read as well
+    for (uint32_t num = 1; num <= 10; ++num)
+        BOOST_CHECK(log.read_block_by_num(num)->id() == blocks[num - 1].id());
+
+    BOOST_CHECK(!log.read_block_by_num(11).valid());
+    BOOST_CHECK(log.read_head().id() == blocks.back().id());
+
+    auto itr = log.read_block(log.get_block_pos(1));
+    BOOST_CHECK(itr.first.id() == blocks[0].id());
+    BOOST_CHECK_EQUAL(itr.second, log.get_block_pos(2));
+}
+
+SCORUM_TEST_CASE(index_is_reconstructed_on_open)
+{
+    {
+        block_log log;
+        log.open(log_path());
+
+        for (uint32_t num = 1; num <= 10; ++num)
+            log.append(make_block(num));
+        log.flush();
+    }
+
+    fc::remove_all(block_log::block_log_index_path(log_path()));
+
+    block_log log;
+    log.open(log_path());
+
+    BOOST_REQUIRE(log.head().valid());
+    BOOST_CHECK(log.head()->id() == blocks.back().id());
+
+    for (uint32_t num = 1; num <= 10; ++num)
+        BOOST_CHECK(log.read_block_by_num(num)->id() == blocks[num - 1].id());
+}
+
+SCORUM_TEST_CASE(compressed_log_keeps_positions_of_raw_log)
+{
+    block_log raw;
+    raw.open(dir.path() / "raw_log");
+
+    block_log log;
+    log.open(log_path(), 3);
+    BOOST_CHECK_EQUAL(log.blocks_per_chunk(), 3u);
+
+    for (uint32_t num = 1; num <= 10; ++num)
+    {
+        auto b = make_block(num);
+        BOOST_CHECK_EQUAL(log.append(b), raw.append(b));
+    }
+
+    for (uint32_t num = 1; num <= 10; ++num)
+    {
+        BOOST_CHECK(log.read_block_by_num(num)->id() == blocks[num - 1].id());
+        BOOST_CHECK_EQUAL(log.get_block_pos(num), raw.get_block_pos(num));
+    }
+
+    auto itr = log.read_block(0);
+    for (uint32_t num = 2; num <= 10; ++num)
+    {
+        itr = log.read_block(itr.second);
+        BOOST_CHECK(itr.first.id() == blocks[num - 1].id());
+    }
+}
+
+SCORUM_TEST_CASE(compressed_log_is_reopened)
+{
+    {
+        block_log log;
+        log.open(log_path(), 4);
+
+        for (uint32_t num = 1; num <= 10; ++num)
+            log.append(make_block(num));
+    }
+
+    fc::remove_all(block_log::block_log_index_path(log_path()));
+
+    block_log log;
+    // format of the existing log is kept
+    log.open(log_path());
+    BOOST_CHECK_EQUAL(log.blocks_per_chunk(), 4u);
+
+    BOOST_REQUIRE(log.head().valid());
+    BOOST_CHECK(log.head()->id() == blocks.back().id());
+
+    for (uint32_t num = 11; num <= 20; ++num)
+        log.append(make_block(num));
+
+    for (uint32_t num = 1; num <= 20; ++num)
+        BOOST_CHECK(log.read_block_by_num(num)->id() == blocks[num - 1].id());
+}
+
+SCORUM_TEST_CASE(segmented_log_spans_segments)
+{
+    {
+        block_log log;
+        log.open(log_path(), 3, 4);
+        BOOST_CHECK_EQUAL(log.blocks_per_segment(), 4u);
+
+        for (uint32_t num = 1; num <= 10; ++num)
+            log.append(make_block(num));
+    }
+
+    BOOST_CHECK(!fc::exists(log_path()));
+    BOOST_CHECK(fc::exists(dir.path() / "block_log.0000000001-0000000004"));
+    BOOST_CHECK(fc::exists(dir.path() / "block_log.0000000005-0000000008"));
+    BOOST_CHECK(fc::exists(block_log::block_log_index_path(dir.path() / "block_log.0000000009-0000000012")));
+
+    block_log log;
+    // layout of the existing log is kept
+    log.open(log_path());
+    BOOST_CHECK_EQUAL(log.blocks_per_segment(), 4u);
+    BOOST_CHECK_EQUAL(log.blocks_per_chunk(), 3u);
+    BOOST_CHECK_EQUAL(log.first_block_num(), 1u);
+
+    BOOST_REQUIRE(log.head().valid());
+    BOOST_CHECK(log.head()->id() == blocks.back().id());
+    BOOST_CHECK(log.read_head().id() == blocks.back().id());
+
+    for (uint32_t num = 1; num <= 10; ++num)
+        BOOST_CHECK(log.read_block_by_num(num)->id() == blocks[num - 1].id());
+    BOOST_CHECK(!log.read_block_by_num(11).valid());
+
+    // positions lead to the next segment
+    auto itr = log.read_block(log.get_block_pos(1));
+    for (uint32_t num = 2; num <= 10; ++num)
+    {
+        BOOST_CHECK_EQUAL(itr.second, log.get_block_pos(num));
+        itr = log.read_block(itr.second);
+        BOOST_CHECK(itr.first.id() == blocks[num - 1].id());
+    }
+}
+
+SCORUM_TEST_CASE(old_segments_are_removed)
+{
+    block_log log;
+    log.open(log_path(), 0, 4);
+
+    for (uint32_t num = 1; num <= 10; ++num)
+        log.append(make_block(num));
+
+    BOOST_CHECK_EQUAL(log.remove_segments(4), 0u);
+    BOOST_CHECK_EQUAL(log.remove_segments(9), 2u);
+    // the head segment is kept
+    BOOST_CHECK_EQUAL(log.remove_segments(100), 0u);
+
+    BOOST_CHECK(!fc::exists(dir.path() / "block_log.0000000001-0000000004"));
+    BOOST_CHECK(!fc::exists(block_log::block_log_index_path(dir.path() / "block_log.0000000005-0000000008")));
+
+    BOOST_CHECK_EQUAL(log.first_block_num(), 9u);
+    BOOST_CHECK(!log.read_block_by_num(8).valid());
+    BOOST_CHECK_EQUAL(log.get_block_pos(1), block_log::npos);
+    BOOST_CHECK(log.read_block_by_num(9)->id() == blocks[8].id());
+
+    log.close();
+    log.open(log_path());
+    BOOST_CHECK_EQUAL(log.first_block_num(), 9u);
+
+    for (uint32_t num = 11; num <= 14; ++num)
+        log.append(make_block(num));
+
+    for (uint32_t num = 9; num <= 14; ++num)
+        BOOST_CHECK(log.read_block_by_num(num)->id() == blocks[num - 1].id());
+
+    block_log::wipe(log_path());
+    BOOST_CHECK(!fc::exists(dir.path() / "block_log.0000000009-0000000012"));
+    BOOST_CHECK(!fc::exists(dir.path() / "block_log.0000000013-0000000016"));
+}
+
+SCORUM_TEST_CASE(queued_blocks_are_written_in_order)
+{
+    {
+        block_log log;
+        log.open(log_path(), 0, 16);
+        log.start_writer(4);
+
+        for (uint32_t num = 1; num <= 100; ++num)
+        {
+            log.append_async(make_block(num));
+            BOOST_CHECK_EQUAL(log.head()->block_num(), num);
+
+            // block is read from the queue or from the files
+            auto b = log.read_block_by_num(num);
+            BOOST_REQUIRE(b.valid());
+            BOOST_CHECK(b->id() == blocks.back().id());
+        }
+
+        BOOST_CHECK_THROW(log.append_async(blocks.front()), fc::exception);
+
+        log.flush();
+        BOOST_CHECK_EQUAL(log.written_block_num(), 100u);
+        for (uint32_t num = 1; num <= 100; ++num)
+            BOOST_CHECK(log.read_block(log.get_block_pos(num)).first.id() == blocks[num - 1].id());
+
+        for (uint32_t num = 101; num <= 110; ++num)
+            log.append_async(make_block(num));
+    }
+
+    // queue is written on close
+    block_log log;
+    log.open(log_path());
+
+    BOOST_REQUIRE(log.head().valid());
+    BOOST_CHECK(log.head()->id() == blocks.back().id());
+    for (uint32_t num = 1; num <= 110; ++num)
+        BOOST_CHECK(log.read_block_by_num(num)->id() == blocks[num - 1].id());
+}
+
+SCORUM_TEST_CASE(writer_error_is_kept_until_close)
+{
+    block_log log;
+    log.open(log_path(), 0, 4);
+    log.start_writer(100);
+
+    for (uint32_t num = 1; num <= 3; ++num)
+        log.append_async(make_block(num));
+    log.flush();
+    BOOST_CHECK_EQUAL(log.written_block_num(), 3u);
+
+    // next segment can't be created
+    fc::remove_all(dir.path());
+
+    for (uint32_t num = 4; num <= 10; ++num)
+        log.append_async(make_block(num));
+
+    BOOST_CHECK_THROW(log.flush(), std::exception);
+    BOOST_CHECK_THROW(log.flush(), std::exception);
+    BOOST_CHECK_EQUAL(log.written_block_num(), 4u);
+
+    // blocks which aren't written stay in the queue
+    for (uint32_t num = 5; num <= 10; ++num)
+    {
+        auto b = log.read_block_by_num(num);
+        BOOST_REQUIRE(b.valid());
+        BOOST_CHECK(b->id() == blocks[num - 1].id());
+    }
+
+    BOOST_CHECK_THROW(log.close(), std::exception);
+    BOOST_CHECK_NO_THROW(log.close());
+}
+
+SCORUM_TEST_CASE(index_is_reconstructed_from_position_links)
+{
+    std::vector<uint64_t> positions;
+    {
+        block_log log;
+        log.open(log_path(), 7, 50);
+
+        for (uint32_t num = 1; num <= 120; ++num)
+            positions.push_back(log.append(make_block(num)));
+    }
+
+    for (const char* segment : { "block_log.0000000001-0000000050", "block_log.0000000051-0000000100",
+                                 "block_log.0000000101-0000000150" })
+        fc::remove_all(block_log::block_log_index_path(dir.path() / segment));
+
+    block_log log;
+    log.open(log_path());
+
+    for (uint32_t num = 1; num <= 120; ++num)
+    {
+        BOOST_CHECK_EQUAL(log.get_block_pos(num), positions[num - 1]);
+        BOOST_CHECK(log.read_block_by_num(num)->id() == blocks[num - 1].id());
+    }
+}
+
+SCORUM_TEST_CASE(blocks_are_read_while_appended)
+{
+    block_log log;
+    log.open(log_path());
+
+    BOOST_CHECK_EQUAL(append_while_read(log, 1000), 0u);
+    BOOST_CHECK(log.read_block_by_num(1000)->id() == blocks.back().id());
+}
+
+SCORUM_TEST_CASE(compressed_blocks_are_read_while_appended)
+{
+    block_log log;
+    // the tail is sealed and replaced every 3 blocks
+    log.open(log_path(), 3);
+
+    BOOST_CHECK_EQUAL(append_while_read(log, 1000), 0u);
+    BOOST_CHECK(log.read_block_by_num(1000)->id() == blocks.back().id());
+}
+
+SCORUM_TEST_CASE(read_only_log_is_not_repaired)
+{
+    {
+        block_log log;
+        log.open(log_path(), 3);
+
+        for (uint32_t num = 1; num <= 10; ++num)
+            log.append(make_block(num));
+    }
+
+    // the last block is not in the index and the log ends with a part of a chunk
+    const fc::path index_file = block_log::block_log_index_path(log_path());
+    const uint64_t index_size = fc::file_size(index_file) - sizeof(uint64_t);
+    boost::filesystem::resize_file(index_file, index_size);
+    {
+        std::ofstream file(log_path().generic_string().c_str(), std::ios::app | std::ios::binary);
+        file << "chunk";
+    }
+    const uint64_t log_size = fc::file_size(log_path());
+
+    block_log log;
+    log.open_read_only(log_path());
+    BOOST_CHECK_EQUAL(log.problems().size(), 2u);
+
+    BOOST_REQUIRE(log.head().valid());
+    BOOST_CHECK(log.head()->id() == blocks.back().id());
+    BOOST_CHECK(log.read_block_by_num(9)->id() == blocks[8].id());
+    BOOST_CHECK_THROW(log.read_block_by_num(10), fc::exception);
+    BOOST_CHECK_THROW(log.append(make_block(11)), fc::exception);
+
+    BOOST_CHECK_EQUAL(fc::file_size(log_path()), log_size);
+    BOOST_CHECK_EQUAL(fc::file_size(index_file), index_size);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
@@ -0,0 +1,141 @@
+#include <boost/test/unit_test.hpp>
+
+#include <scorum/chain/database/signature_recovery.hpp>
+#include <scorum/protocol/exceptions.hpp>
+#include <scorum/protocol/scorum_operations.hpp>
+
+#include "defines.hpp"
+
+namespace recovered_keys_cache_tests {
+
+using namespace scorum::chain;
+using namespace scorum::protocol;
+
+struct fixture
+{
+    fixture()
+    {
+        transfer_operation op;
+        op.from = "alice";
+        op.to = "bob";
+        op.amount = asset(1, SCORUM_SYMBOL);
+
+        trx.operations.push_back(op);
+        trx.set_expiration(fc::time_point_sec(1000));
+    }
+
+    signed_transaction sign(const signed_transaction& src, const std::vector<fc::ecc::private_key>& keys)
+    {
+        signed_transaction result = src;
+        for (const auto& key : keys)
+            result.sign(key, chain_id);
+        return result;
+    }
+
+    chain_id_type chain_id = chain_id_type::hash(std::string("test"));
+
+    fc::ecc::private_key alice = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string("alice")));
+    fc::ecc::private_key bob = fc::ecc::private_key::regenerate(fc::sha256::hash(std::string("bob")));
+
+    signed_transaction trx;
+};
+
+BOOST_FIXTURE_TEST_SUITE(recovered_keys_cache_tests, fixture)
+
+SCORUM_TEST_CASE(keys_are_recovered_once)
+{
+    recovered_keys_cache cache(10);
+
+    const auto signed_trx = sign(trx, { alice, bob });
+
+    BOOST_CHECK(cache.get_signature_keys(signed_trx, chain_id) == signed_trx.get_signature_keys(chain_id));
+    BOOST_CHECK_EQUAL(cache.size(), 2u);
+
+    BOOST_CHECK(cache.get_signature_keys(signed_trx, chain_id) == signed_trx.get_signature_keys(chain_id));
+    BOOST_CHECK_EQUAL(cache.size(), 2u);
+}
+
+SCORUM_TEST_CASE(other_digest_is_not_taken_from_cache)
+{
+    recovered_keys_cache cache(10);
+
+    auto signed_trx = sign(trx, { alice });
+    cache.get_signature_keys(signed_trx, chain_id);
+
+    // same signature over the changed transaction recovers another key
+    signed_trx.set_expiration(fc::time_point_sec(2000));
+
+    BOOST_CHECK(cache.get_signature_keys(signed_trx, chain_id) == signed_trx.get_signature_keys(chain_id));
+    BOOST_CHECK_EQUAL(cache.size(), 2u);
+}
+
+SCORUM_TEST_CASE(duplicate_signature_is_rejected)
+{
+    recovered_keys_cache cache(10);
+
+    auto signed_trx = sign(trx, { alice });
+    cache.get_signature_keys(signed_trx, chain_id);
+
+    signed_trx.signatures.push_back(signed_trx.signatures.front());
+
+    BOOST_CHECK_THROW(cache.get_signature_keys(signed_trx, chain_id), tx_duplicate_sig);
+}
+
+SCORUM_TEST_CASE(expired_and_excess_entries_are_dropped)
+{
+    recovered_keys_cache cache(2);
+
+    auto first = sign(trx, { alice });
+
+    auto second = trx;
+    second.set_expiration(fc::time_point_sec(2000));
+    second = sign(second, { alice });
+
+    auto third = trx;
+    third.set_expiration(fc::time_point_sec(3000));
+    third = sign(third, { alice });
+
+    cache.get_signature_keys(first, chain_id);
+    cache.get_signature_keys(second, chain_id);
+    cache.get_signature_keys(third, chain_id);
+
+    // entry which expires first is dropped
+    BOOST_CHECK_EQUAL(cache.size(), 2u);
+
+    cache.remove_expired(fc::time_point_sec(2500));
+    BOOST_CHECK_EQUAL(cache.size(), 1u);
+
+    cache.set_max_size(0);
+    BOOST_CHECK_EQUAL(cache.size(), 0u);
+
+    cache.get_signature_keys(first, chain_id);
+    BOOST_CHECK_EQUAL(cache.size(), 0u);
+}
+
+SCORUM_TEST_CASE(witness_key_is_recovered_without_transaction_keys)
+{
+    recovered_keys_cache cache(10);
+    signature_recovery_pool pool(2);
+
+    signed_block block;
+    block.timestamp = fc::time_point_sec(SCORUM_BLOCK_INTERVAL);
+    block.witness = "alice";
+    block.transactions.push_back(sign(trx, { bob }));
+    block.transaction_merkle_root = block.calculate_merkle_root();
+    block.sign(alice);
+
+    auto prepared = pool.prepare(block, chain_id, cache, true, false);
+    BOOST_REQUIRE(prepared.signee.valid());
+    BOOST_CHECK(*prepared.signee == public_key_type(alice.get_public_key()));
+    BOOST_CHECK(!prepared.keys[0].valid());
+    BOOST_CHECK(prepared.merkle_root.valid());
+    BOOST_CHECK_EQUAL(cache.size(), 0u);
+
+    prepared = pool.prepare(block, chain_id, cache, false, true);
+    BOOST_CHECK(!prepared.signee.valid());
+    BOOST_REQUIRE(prepared.keys[0].valid());
+    BOOST_CHECK(prepared.keys[0]->count(public_key_type(bob.get_public_key())));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}